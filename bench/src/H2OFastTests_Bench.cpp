@@ -0,0 +1,285 @@
+/*
+*
+*  (C) Copyright 2016 Michaël Roynard
+*
+*  Distributed under the MIT License, Version 1.0. (See accompanying
+*  file LICENSE or copy at https://opensource.org/licenses/MIT)
+*
+*  See https://github.com/dutiona/H2OFastTests for documentation.
+*/
+
+#include "H2OFastTests.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Every allocation of the process, counted in H2OFastTests_Bench_Allocations.cpp
+extern std::atomic<size_t> allocation_count;
+
+using namespace H2OFastTests::Asserter;
+
+static const size_t iterations = 1000000;
+static bool passing_assert_allocated = false;
+
+// Runs body iterations times and prints its cost per call
+// Passing asserts are expected to never allocate
+template<class Body>
+void bench_assert(const char* name, bool passing, Body body) {
+    const auto allocations = allocation_count.load();
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        body();
+    }
+    const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+    const auto allocated = allocation_count.load() - allocations;
+    std::printf("%-60s %10.2f ns %10.3f allocations\n", name, elapsed.count() / iterations, static_cast<double>(allocated) / iterations);
+    if (passing && allocated != 0) {
+        passing_assert_allocated = true;
+    }
+}
+
+// Runs body once over count items and prints its cost per item
+template<class Body>
+void bench_items(const char* name, size_t count, Body body) {
+    const auto allocations = allocation_count.load();
+    const auto start = std::chrono::steady_clock::now();
+    body();
+    const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+    const auto allocated = allocation_count.load() - allocations;
+    std::printf("%-60s %10.2f ns %10.3f allocations %12.0f /s\n", name, elapsed.count() / count, static_cast<double>(allocated) / count,
+        count / (elapsed.count() * 1e-9));
+}
+
+// Registry of the synthetic scenarios, its tests are dropped between the scenarios
+struct H2OFastTests_Bench : H2OFastTests::RegistryManager<H2OFastTests_Bench> {
+    H2OFastTests_Bench() : RegistryManager<H2OFastTests_Bench>{ []() {} } {}
+};
+
+void clear_bench_tests() {
+    H2OFastTests::detail::get_registry().getTests(H2OFastTests::detail::type_helper<H2OFastTests_Bench>::type_index()) = H2OFastTests::detail::TestList{};
+}
+
+// Counts what it is notified of, to measure the notifications alone
+class CountingObserver : public H2OFastTests::IRegistryObserver {
+public:
+    virtual void update(H2OFastTests::TestInfo /*infos*/) const override {
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+    mutable std::atomic<size_t> count{ 0 };
+};
+
+std::string scenario_name(const char* what, size_t count) {
+    return std::string{ what } + " (" + std::to_string(count) + " tests)";
+}
+
+// Registration, dispatch, notification and reporting costs for count synthetic tests
+void bench_scenario(size_t count) {
+    static const size_t observer_count = 8;
+    const std::string label = "Bench::Empty test";
+    const auto workers = std::max<size_t>(std::thread::hardware_concurrency(), 2);
+
+    std::printf("\nScenario of %zu tests\n", count);
+    {
+        H2OFastTests_Bench registry;
+        bench_items(scenario_name("add_test", count).c_str(), count, [&]() {
+            for (size_t i = 0; i < count; ++i) {
+                registry.add_test(label, []() {});
+            }
+        });
+        bench_items(scenario_name("run_tests() sequential, passing", count).c_str(), count, [&]() {
+            registry.run_tests();
+        });
+        bench_items(scenario_name(("run_tests() parallel(" + std::to_string(workers) + "), passing").c_str(), count).c_str(), count, [&]() {
+            registry.run_tests(H2OFastTests::ExecutionPolicy::parallel(workers));
+        });
+
+        // Same run with observers, the difference is the cost of their notifications
+        std::vector<std::shared_ptr<CountingObserver>> observers;
+        for (size_t i = 0; i < observer_count; ++i) {
+            observers.push_back(std::make_shared<CountingObserver>());
+            registry.addObserver(observers.back());
+        }
+        bench_items(scenario_name(("run_tests() sequential, " + std::to_string(observer_count) + " observers").c_str(), count).c_str(), count, [&]() {
+            registry.run_tests();
+        });
+        for (const auto& observer : observers) {
+            registry.removeObserver(observer);
+            if (observer->count.load() != count) {
+                std::printf("FAILED: an observer missed notifications\n");
+                std::exit(EXIT_FAILURE);
+            }
+        }
+
+        // Reporters are handed every result of the last run, as the registry would notify them
+        const auto report = [&registry, count](const char* name, const H2OFastTests::IRegistryObserver& reporter) {
+            bench_items(scenario_name(name, count).c_str(), count, [&]() {
+                registry.visit([&reporter](const H2OFastTests::Test& test) { reporter.update(std::cref(test)); });
+                reporter.flush();
+            });
+        };
+        report("JsonLinesReporter::update", H2OFastTests::JsonLinesReporter{ "H2OFastTestsBench.jsonl.tmp", "Bench" });
+        report("JUnitReporter::update", H2OFastTests::JUnitReporter{ "H2OFastTestsBench.xml.tmp", "Bench" });
+        report("BinaryResultLog::update", H2OFastTests::BinaryResultLog{ "H2OFastTestsBench.log.tmp" });
+        std::remove("H2OFastTestsBench.jsonl.tmp");
+        std::remove("H2OFastTestsBench.xml.tmp");
+        std::remove("H2OFastTestsBench.log.tmp");
+        std::remove("H2OFastTestsBench.log.tmp.strings");
+    }
+    clear_bench_tests();
+
+    {
+        H2OFastTests_Bench registry;
+        for (size_t i = 0; i < count; ++i) {
+            registry.add_test(label, []() { AssertThat(false).isTrue("Expect to fail"); });
+        }
+        bench_items(scenario_name("run_tests() sequential, failing", count).c_str(), count, [&]() {
+            registry.run_tests();
+        });
+    }
+    clear_bench_tests();
+}
+
+// Builds the asserts of a kind
+struct HardAsserts {
+    static constexpr const char* name = "AssertThat";
+    template<class T>
+    static auto that(T&& value) { return AssertThat(std::forward<T>(value)); }
+};
+
+struct SoftAsserts {
+    static constexpr const char* name = "ExpectThat";
+    template<class T>
+    static auto that(T&& value) { return ExpectThat(std::forward<T>(value)); }
+};
+
+// Thrown by the bodies checked with expectException, without allocating
+struct BenchException {};
+
+// Operands of the asserts, chosen so that they all pass or all fail
+// Volatile values keep the compiler from deciding the asserts at compile time
+struct Operands {
+    explicit Operands(bool passing)
+        : int_value(42), double_value(1.0), float_value(1.0f), bool_value(passing), null_pointer(passing ? nullptr : &object),
+        expected_int(passing ? 42 : 43), expected_double(passing ? 1.0 : 2.0), expected_float(passing ? 1.0f : 2.0f),
+        c_string("H2OFastTests"), expected_c_string(passing ? "h2ofasttests" : "h2ofasttest?"),
+        string("H2OFastTests long enough to be on the heap"), other_string(passing ? "H2OFastTests long enough to be ON THE HEAP" : "H2OFastTests long enough to be ON THE HEAP?"),
+        values(1000, 1), expected_values(1000, 1), doubles(1000, 1.0), expected_doubles(1000, 1.0), object(0), other_object(0), passing(passing)
+    {
+        if (!passing) {
+            // The mismatch is found after a full scan
+            expected_values.back() = 2;
+            expected_doubles.back() = 2.0;
+        }
+    }
+
+    volatile int int_value;
+    volatile double double_value;
+    volatile float float_value;
+    volatile bool bool_value;
+    int* volatile null_pointer;
+    int expected_int;
+    double expected_double;
+    float expected_float;
+    const char* c_string;
+    const char* expected_c_string;
+    std::string string;
+    std::string other_string;
+    std::vector<int> values;
+    std::vector<int> expected_values;
+    std::vector<double> doubles;
+    std::vector<double> expected_doubles;
+    int object;
+    int other_object;
+    bool passing;
+};
+
+// Cost of each overload, in the scope of a running test: failing expectations are recorded,
+// failing asserts throw, and the cost of the exception is part of theirs
+template<class Asserts>
+void bench_overloads(bool passing) {
+    Operands o{ passing };
+    const auto bench = [passing](const char* overload, auto check) {
+        const auto name = std::string{ Asserts::name } + "." + overload;
+        bench_assert(name.c_str(), passing, [&check]() {
+            H2OFastTests::detail::ExpectationScope scope;
+            try {
+                check();
+            }
+            catch (const H2OFastTests::detail::GenericTestFailure&) {}
+        });
+    };
+    const auto that = [](auto&& value) { return Asserts::that(std::forward<decltype(value)>(value)); };
+
+    bench("isTrue", [&]() { that(static_cast<bool>(o.bool_value)).isTrue("Expect true"); });
+    bench("isFalse", [&]() { that(!o.bool_value).isFalse("Expect false"); });
+    bench("isEqualTo(int)", [&]() { that(static_cast<int>(o.int_value)).isEqualTo(o.expected_int, "Expect 42"); });
+    bench("isNotEqualTo(int)", [&]() { that(static_cast<int>(o.int_value) + 1).isNotEqualTo(o.expected_int, "Expect not 42"); });
+    bench("isEqualTo(double, tolerance)", [&]() { that(static_cast<double>(o.double_value)).isEqualTo(o.expected_double, 1e-5, "Expect 1.0"); });
+    bench("isNotEqualTo(double, tolerance)", [&]() { that(static_cast<double>(o.double_value) + 1.0).isNotEqualTo(o.expected_double, 1e-5, "Expect not 1.0"); });
+    bench("isEqualTo(float, tolerance)", [&]() { that(static_cast<float>(o.float_value)).isEqualTo(o.expected_float, 1e-5f, "Expect 1.0f"); });
+    // This overload takes the actual value again as its second argument
+    bench("isNotEqualTo(float, float, tolerance)", [&]() {
+        that(static_cast<float>(o.float_value)).isNotEqualTo(o.expected_float, static_cast<float>(o.float_value) + 1.0f, 1e-5f, "Expect not 1.0f");
+    });
+    bench("isEqualTo(char*, ignoreCase = true)", [&]() { that(o.c_string).isEqualTo(o.expected_c_string, true, "Expect equal strings"); });
+    bench("isNotEqualTo(char*, ignoreCase = false)", [&]() { that(o.c_string).isNotEqualTo(o.passing ? o.expected_c_string : o.c_string, false, "Expect different strings"); });
+    bench("isEqualTo(std::string, ignoreCase = true)", [&]() { that(o.string).isEqualTo(o.other_string, true, "Expect equal strings"); });
+    bench("isNotEqualTo(std::string, ignoreCase = false)", [&]() { that(o.string).isNotEqualTo(o.passing ? o.other_string : o.string, false, "Expect different strings"); });
+    bench("isSameAs", [&]() { that(o.object).isSameAs(o.passing ? o.object : o.other_object, "Expect the same object"); });
+    bench("isNotSameAs", [&]() { that(o.object).isNotSameAs(o.passing ? o.other_object : o.object, "Expect another object"); });
+    bench("isNull(line_info)", [&]() { that(static_cast<int*>(o.null_pointer)).isNull("Expect null", line_info()); });
+    bench("isNotNull(line_info)", [&]() { that(o.passing ? &o.object : static_cast<int*>(nullptr)).isNotNull("Expect not null", line_info()); });
+    bench("isElementwiseEqualTo(1000 ints)", [&]() { that(o.values).isElementwiseEqualTo(o.expected_values, "Expect equal ranges"); });
+    bench("isElementwiseNear(1000 doubles)", [&]() { that(o.doubles).isElementwiseNear(o.expected_doubles, 1e-5, "Expect near ranges"); });
+    bench("expectException", [&]() {
+        that([&o]() {
+            if (o.passing) {
+                throw BenchException{};
+            }
+        }).template expectException<BenchException>("Expect an exception");
+    });
+    if (!passing) {
+        bench("fail", [&]() { that(nullptr).fail("Expect to fail"); });
+    }
+}
+
+// H2OFastTestsBench [test counts...], runs the scenarios of 1k, 100k and 1M tests by default
+int main(int argc, char** argv) {
+    {
+        // The failure buffer of the thread is allocated on first use
+        H2OFastTests::detail::ExpectationScope scope;
+    }
+
+    std::printf("Cost per passing assert (%zu iterations each)\n", iterations);
+    bench_overloads<HardAsserts>(true);
+    bench_overloads<SoftAsserts>(true);
+
+    std::printf("\nCost per failing assert, what() of the asserts not called, expectations recorded (%zu iterations each)\n", iterations);
+    bench_overloads<HardAsserts>(false);
+    bench_overloads<SoftAsserts>(false);
+
+    if (passing_assert_allocated) {
+        std::printf("FAILED: a passing assert allocated memory\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<size_t> counts;
+    for (int i = 1; i < argc; ++i) {
+        counts.push_back(std::strtoull(argv[i], nullptr, 10));
+    }
+    if (counts.empty()) {
+        counts = { 1000, 100000, 1000000 };
+    }
+    for (auto count : counts) {
+        if (count > 0) {
+            bench_scenario(count);
+        }
+    }
+    return EXIT_SUCCESS;
+}
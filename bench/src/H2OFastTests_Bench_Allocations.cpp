@@ -0,0 +1,48 @@
+/*
+*
+*  (C) Copyright 2016 Michaël Roynard
+*
+*  Distributed under the MIT License, Version 1.0. (See accompanying
+*  file LICENSE or copy at https://opensource.org/licenses/MIT)
+*
+*  See https://github.com/dutiona/H2OFastTests for documentation.
+*/
+
+// Replaces the global operator new and delete to count every allocation of the process.
+// They live in their own translation unit: inlined next to the code they serve, the frees
+// of blocks from this operator new are mistaken for mismatched ones by the compiler.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+std::atomic<size_t> allocation_count{ 0 };
+
+void* operator new(size_t size) {
+    ++allocation_count;
+    if (auto p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
@@ -14,23 +14,51 @@
 #define H2OFASTTESTS_H
 
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstddef>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
 #include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <set>
+#include <shared_mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
 #include <vector>
 #include <typeinfo>
 #include <typeindex>
+#include <type_traits>
 
 #include "H2OFastTests_config.hpp"
 
+#if defined(_MSC_VER)
+#   include <intrin.h> // _ReadWriteBarrier
+#endif
+
 namespace H2OFastTests {
+    template<class ScenarioName>
+    class RegistryTraversal_ConsoleIO;
+
     // Implementation details
     namespace detail {
 
@@ -46,10 +74,11 @@ namespace H2OFastTests {
 
         // Line info struct
         // Holds line number, file name and function name if relevant
+        // file and func are expected to be literals (__FILE__, __FUNCTION__): they are not copied
         class LineInfo {
         public:
             LineInfo()
-                : init_(false)
+                : file_(""), func_(""), line_(0), init_(false)
             {
             }
 
@@ -73,8 +102,8 @@ namespace H2OFastTests {
 
         private:
 
-            std::string file_;
-            std::string func_;
+            const char* file_;
+            const char* func_;
             int line_;
             bool init_;
         };
@@ -99,137 +128,495 @@ namespace H2OFastTests {
             exception
         };
 
-        template<bool Streamable, bool Exception>
-        struct additionalInfos {
-            template<class ValueTypeL, class ValueTypeR>
-            static std::string get(FailureType failure_type, ValueTypeL reached, ValueTypeR expected, const std::string& exception_name);
+        // Printed form of an assert operand, only built once the assert failed
+        struct FailureValue {
+            std::string text;
+            bool printable;
         };
 
-        template<>
-        struct additionalInfos<true, false> {
-            template<class ValueTypeL, class ValueTypeR>
-            static std::string get(FailureType failure_type, ValueTypeL reached, ValueTypeR expected, const std::string&) noexcept {
-                std::ostringstream oss;
-                oss << "\t\t\t[REACHED] " << reached << std::endl;
-                switch (failure_type) {
-                case FailureType::equal: {
-                    oss << "\t\t\t[EXPECTED EQUAL TO] " << expected << std::endl;
-                    break;
+        // Out of line formatting of the usual operands, see describe
+#if H2OFT_DEFINE_FUNCTIONS_
+        H2OFT_INLINE FailureValue describe_value(bool value) {
+            return{ value ? "1" : "0", true };
+        }
+
+        H2OFT_INLINE FailureValue describe_value(char value) {
+            return{ std::string(1, value), true };
+        }
+
+        H2OFT_INLINE FailureValue describe_value(long long value) {
+            char text[32];
+            std::snprintf(text, sizeof(text), "%lld", value);
+            return{ text, true };
+        }
+
+        H2OFT_INLINE FailureValue describe_value(unsigned long long value) {
+            char text[32];
+            std::snprintf(text, sizeof(text), "%llu", value);
+            return{ text, true };
+        }
+
+        H2OFT_INLINE FailureValue describe_value(double value) {
+            char text[32];
+            std::snprintf(text, sizeof(text), "%g", value);
+            return{ text, true };
+        }
+
+        H2OFT_INLINE FailureValue describe_value(std::string_view value) {
+            return{ std::string{ value }, true };
+        }
+
+        H2OFT_INLINE FailureValue describe_value(const void* value) {
+            char text[32];
+            std::snprintf(text, sizeof(text), "%p", value);
+            return{ text, true };
+        }
+
+        H2OFT_INLINE FailureValue describe_value(std::nullptr_t) {
+            return{ "nullptr", true };
+        }
+#else
+        FailureValue describe_value(bool value);
+        FailureValue describe_value(char value);
+        FailureValue describe_value(long long value);
+        FailureValue describe_value(unsigned long long value);
+        FailureValue describe_value(double value);
+        FailureValue describe_value(std::string_view value);
+        FailureValue describe_value(const void* value);
+        FailureValue describe_value(std::nullptr_t);
+#endif
+
+        template<class T>
+        FailureValue describe_streamed(const T& value) {
+            std::ostringstream oss;
+            oss << value;
+            return{ oss.str(), true };
+        }
+
+        // Picks the formatting of an operand at compile time: the usual types share the
+        // routines above, only the other printable types instantiate a stream
+        template<class T>
+        FailureValue describe(const T& value) {
+            using U = std::decay_t<T>;
+            if constexpr (std::is_same_v<U, bool>) {
+                return describe_value(value);
+            }
+            else if constexpr (std::is_same_v<U, char> || std::is_same_v<U, signed char> || std::is_same_v<U, unsigned char>) {
+                return describe_value(static_cast<char>(value));
+            }
+            else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+                return describe_value(static_cast<long long>(value));
+            }
+            else if constexpr (std::is_integral_v<U>) {
+                return describe_value(static_cast<unsigned long long>(value));
+            }
+            else if constexpr (std::is_same_v<U, float> || std::is_same_v<U, double>) {
+                return describe_value(static_cast<double>(value));
+            }
+            else if constexpr (std::is_same_v<U, const char*> || std::is_same_v<U, char*>) {
+                return value ? describe_value(std::string_view{ value }) : describe_value(nullptr);
+            }
+            else if constexpr (std::is_same_v<U, std::string> || std::is_same_v<U, std::string_view>) {
+                return describe_value(std::string_view{ value });
+            }
+            else if constexpr (std::is_same_v<U, std::nullptr_t>) {
+                return describe_value(nullptr);
+            }
+            else if constexpr (std::is_pointer_v<U> && std::is_object_v<std::remove_pointer_t<U>>) {
+                return describe_value(static_cast<const void*>(value));
+            }
+            else if constexpr (is_streamable<std::ostream, const U&>::value) {
+                return describe_streamed(value);
+            }
+            else {
+                return{ {}, false };
+            }
+        }
+
+        class GenericTestFailure : public std::exception {};
+
+        // Raised when an assert fails. It is not a template: its operands are already printed,
+        // and the message is only built when what() is first called
+        class TestFailure : public GenericTestFailure {
+        public:
+
+            TestFailure(std::string_view message, const LineInfo& lineInfo, FailureValue&& reached, FailureValue&& expected, FailureType failure_type, const char* exception_name)
+                : message_(message), lineInfo_(lineInfo), reached_(std::move(reached)), expected_(std::move(expected)),
+                failure_type_(failure_type), exception_name_(exception_name), formatted_(false)
+            {}
+
+            virtual const char * what() const noexcept override {
+                if (!formatted_) {
+                    formatted_ = true;
+                    std::ostringstream oss;
+                    oss << message_;
+                    if (lineInfo_.isInit()) {
+                        oss << "\t(" << lineInfo_ << ")";
+                    }
+                    oss << '\n';
+                    additional_infos(oss);
+                    message_ = oss.str();
                 }
-                case FailureType::different: {
-                    oss << "\t\t\t[EXPECTED DIFFERENT FROM] " << expected << std::endl;
-                    break;
+                return message_.c_str();
+            }
+
+            TestFailure& operator=(const TestFailure&) = delete;
+
+        private:
+
+            void additional_infos(std::ostream& oss) const {
+                if (exception_name_) {
+                    if (failure_type_ == FailureType::exception) {
+                        oss << "\t\t[EXPECTED Exception] " << exception_name_ << std::endl;
+                    }
+                    else {
+                        oss << "\t\t\t[ERROR] " << std::endl;
+                    }
                 }
-                case FailureType::exception:
-                default: {
-                    oss << "\t\t\t[ERROR] " << std::endl;
-                    break;
+                else if (reached_.printable && expected_.printable) {
+                    oss << "\t\t\t[REACHED] " << reached_.text << std::endl;
+                    switch (failure_type_) {
+                    case FailureType::equal:
+                        oss << "\t\t\t[EXPECTED EQUAL TO] " << expected_.text << std::endl;
+                        break;
+                    case FailureType::different:
+                        oss << "\t\t\t[EXPECTED DIFFERENT FROM] " << expected_.text << std::endl;
+                        break;
+                    case FailureType::exception:
+                    default:
+                        oss << "\t\t\t[ERROR] " << std::endl;
+                        break;
+                    }
                 }
+                else {
+                    switch (failure_type_) {
+                    case FailureType::equal:
+                        oss << "\t\t\t[REACHED] is different from [EXPECTED]. Expected [EQUAL TO]" << std::endl;
+                        break;
+                    case FailureType::different:
+                        oss << "\t\t\t[REACHED] is equal to [EXPECTED]. Expected [DIFFERENT FROM]" << std::endl;
+                        break;
+                    case FailureType::exception:
+                    default:
+                        oss << "\t\t\t[ERROR] " << std::endl;
+                        break;
+                    }
                 }
-                return oss.str();
             }
+
+            mutable std::string message_;
+            const LineInfo lineInfo_;
+            const FailureValue reached_;
+            const FailureValue expected_;
+            const FailureType failure_type_;
+            const char* exception_name_; // null unless an exception was expected
+            mutable bool formatted_;
+
         };
 
-        template<>
-        struct additionalInfos<false, false> {
-            template<class ValueTypeL, class ValueTypeR>
-            static std::string get(FailureType failure_type, ValueTypeL, ValueTypeR, const std::string&) noexcept {
-                std::ostringstream oss;
-                switch (failure_type) {
-                case FailureType::equal: {
-                    oss << "\t\t\t[REACHED] is different from [EXPECTED]. Expected [EQUAL TO]" << std::endl;
-                    break;
+#if H2OFT_DEFINE_FUNCTIONS_
+        [[noreturn]] H2OFT_INLINE void raise_failure(std::string_view message, const LineInfo& lineInfo, FailureValue&& reached, FailureValue&& expected, FailureType failure_type, const char* exception_name) {
+            throw TestFailure{ message, lineInfo, std::move(reached), std::move(expected), failure_type, exception_name };
+        }
+#else
+        [[noreturn]] void raise_failure(std::string_view message, const LineInfo& lineInfo, FailureValue&& reached, FailureValue&& expected, FailureType failure_type, const char* exception_name);
+#endif
+
+        // Failures of the expectations of the tests running on a thread, see ExpectThat.
+        // Each thread has one, allocated once and reused by every test it runs: the messages
+        // are kept in place, and the failures past its capacity are only counted.
+        class FailureBuffer {
+        public:
+
+            static constexpr size_t capacity = 32;
+
+            // Null when no test is running on this thread
+            static FailureBuffer* current() {
+                auto& buffer = of_thread();
+                return buffer.depth_ > 0 ? &buffer : nullptr;
+            }
+
+            bool full() const { return count_ >= capacity; }
+
+            void record(const char* what) {
+                if (count_ < records_.size()) {
+                    records_[count_] = what;
                 }
-                case FailureType::different: {
-                    oss << "\t\t\t[REACHED] is equal to [EXPECTED]. Expected [DIFFERENT FROM]" << std::endl;
-                    break;
+                else if (count_ < capacity) {
+                    records_.emplace_back(what);
                 }
-                case FailureType::exception:
-                default: {
-                    oss << "\t\t\t[ERROR] " << std::endl;
-                    break;
+                ++count_;
+            }
+
+            // Counts a failure without recording it
+            void drop() { ++count_; }
+
+        private:
+
+            FailureBuffer()
+                : count_(0), depth_(0)
+            {
+                records_.reserve(capacity);
+            }
+
+            static FailureBuffer& of_thread() {
+                thread_local FailureBuffer buffer;
+                return buffer;
+            }
+
+            std::vector<std::string> records_;
+            size_t count_;
+            size_t depth_; // number of ExpectationScope on this thread
+
+            friend class ExpectationScope;
+        };
+
+        // Collects the failures of the expectations run while it exists, on its thread.
+        // Scopes nest: the failures of an inner scope are removed from the buffer when it ends.
+        class ExpectationScope {
+        public:
+
+            ExpectationScope()
+                : buffer_(FailureBuffer::of_thread()), mark_(buffer_.count_)
+            {
+                ++buffer_.depth_;
+            }
+
+            ~ExpectationScope() {
+                buffer_.count_ = mark_;
+                --buffer_.depth_;
+            }
+
+            ExpectationScope(const ExpectationScope&) = delete;
+            ExpectationScope& operator=(const ExpectationScope&) = delete;
+
+            size_t failures() const { return buffer_.count_ - mark_; }
+
+            // Messages of the failures that were recorded, in order
+            std::vector<std::string> records() const {
+                const auto end = std::min(buffer_.count_, FailureBuffer::capacity);
+                return mark_ < end ? std::vector<std::string>(buffer_.records_.begin() + mark_, buffer_.records_.begin() + end) : std::vector<std::string>{};
+            }
+
+            const char* first() const {
+                return mark_ < std::min(buffer_.count_, FailureBuffer::capacity) ? buffer_.records_[mark_].c_str() : "Failed expectation not recorded, the buffer of its thread was full\n";
+            }
+
+        private:
+
+            FailureBuffer& buffer_;
+            const size_t mark_;
+        };
+
+#if H2OFT_DEFINE_FUNCTIONS_
+        H2OFT_INLINE void record_failure(FailureBuffer& buffer, std::string_view message, const LineInfo& lineInfo, FailureValue&& reached, FailureValue&& expected, FailureType failure_type, const char* exception_name) {
+            buffer.record(TestFailure{ message, lineInfo, std::move(reached), std::move(expected), failure_type, exception_name }.what());
+        }
+#else
+        void record_failure(FailureBuffer& buffer, std::string_view message, const LineInfo& lineInfo, FailureValue&& reached, FailureValue&& expected, FailureType failure_type, const char* exception_name);
+#endif
+
+        // Internal impl for processing an assert and raise the TestFailure Exception
+        // The operands are only printed when the condition is false
+        // Soft asserts record the failure in the buffer of the running test instead, and throw
+        // only when no test is running
+        template<bool Soft, class ValueTypeL, class ValueTypeR, class ExceptionType = void,
+            typename = std::enable_if_t<
+            std::is_convertible_v<std::decay_t<ValueTypeL>, std::decay_t<ValueTypeR>> ||
+            std::is_convertible_v<std::decay_t<ValueTypeR>, std::decay_t<ValueTypeL>>>>
+            void FailureTest(bool condition, const ValueTypeL& reached, const ValueTypeR& expected, FailureType failure_type, std::string_view message, const LineInfo& lineInfo) {
+            if (!condition) {
+                const char* exception_name = nullptr;
+                if constexpr (!std::is_void_v<ExceptionType>) {
+                    exception_name = type_helper<ExceptionType>::name();
                 }
+                if constexpr (Soft) {
+                    if (auto buffer = FailureBuffer::current()) {
+                        if (buffer->full()) {
+                            buffer->drop();
+                        }
+                        else {
+                            record_failure(*buffer, message, lineInfo, describe(reached), describe(expected), failure_type, exception_name);
+                        }
+                        return;
+                    }
                 }
-                return oss.str();
+                raise_failure(message, lineInfo, describe(reached), describe(expected), failure_type, exception_name);
             }
-        };
+        }
+
+        // Compare two strings without copying them
+        inline bool equal_strings(std::string_view lhs, std::string_view rhs, bool ignoreCase) {
+            return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(), [ignoreCase](char l, char r) {
+                return ignoreCase ? ::tolower(static_cast<unsigned char>(l)) == ::tolower(static_cast<unsigned char>(r)) : l == r;
+            });
+        }
 
-        template<bool Streamable>
-        struct additionalInfos<Streamable, true> {
-            template<class ValueTypeL, class ValueTypeR>
-            static std::string get(FailureType failure_type, ValueTypeL, ValueTypeR, const std::string& exception_name) noexcept {
-                std::ostringstream oss;
-                switch (failure_type) {
-                case FailureType::exception: {
-                    oss << "\t\t[EXPECTED Exception] " << exception_name << std::endl;
-                    break;
+        // Elements are compared by blocks: a whole block is checked without branching,
+        // which compilers vectorize, and only a block holding a mismatch is searched
+        const size_t elementwise_block = 256;
+
+        // Index of the first element of lhs different from the one of rhs, count if there is none
+        // Types compared by their bytes are compared with memcmp
+        template<class T>
+        size_t first_mismatch(const T* lhs, const T* rhs, size_t count) {
+            for (size_t begin = 0; begin < count; begin += elementwise_block) {
+                const auto end = std::min(count, begin + elementwise_block);
+                bool differ = false;
+                if constexpr (std::has_unique_object_representations_v<T>) {
+                    differ = std::memcmp(lhs + begin, rhs + begin, (end - begin) * sizeof(T)) != 0;
                 }
-                case FailureType::equal:
-                case FailureType::different:
-                default: {
-                    oss << "\t\t\t[ERROR] " << std::endl;
-                    break;
+                else {
+                    for (auto i = begin; i < end; ++i) {
+                        differ |= !(lhs[i] == rhs[i]);
+                    }
                 }
+                if (differ) {
+                    for (auto i = begin; i < end; ++i) {
+                        if (!(lhs[i] == rhs[i])) {
+                            return i;
+                        }
+                    }
                 }
-                return oss.str();
             }
-        };
+            return count;
+        }
 
-        class GenericTestFailure : public std::exception {};
+        // Index of the first element of lhs further than tolerance from the one of rhs, count if there is none
+        // NaN is never near anything
+        template<class T>
+        size_t first_far(const T* lhs, const T* rhs, size_t count, T tolerance) {
+            static_assert(std::is_floating_point<T>::value, "Elementwise tolerances are for floating point elements");
+            tolerance = std::abs(tolerance);
+            for (size_t begin = 0; begin < count; begin += elementwise_block) {
+                const auto end = std::min(count, begin + elementwise_block);
+                bool far = false;
+                for (auto i = begin; i < end; ++i) {
+                    far |= !(std::abs(lhs[i] - rhs[i]) <= tolerance);
+                }
+                if (far) {
+                    for (auto i = begin; i < end; ++i) {
+                        if (!(std::abs(lhs[i] - rhs[i]) <= tolerance)) {
+                            return i;
+                        }
+                    }
+                }
+            }
+            return count;
+        }
 
-        template<class ValueTypeL, class ValueTypeR, class ExceptionType>
-        class TestFailure : public GenericTestFailure {
+        // Raised by the elementwise asserts: only the values around the first mismatch are
+        // copied, and the message is built when what() is first called
+        template<class T>
+        class ElementwiseFailure : public GenericTestFailure {
         public:
 
-            TestFailure(const std::string& message, ValueTypeL reached, ValueTypeR expected, FailureType failure_type)
-                : message_(message), reached_(reached), expected_(expected), failure_type_(failure_type)
-            {}
+            static const size_t window_before = 4;
+            static const size_t window_after = 4;
 
-            virtual const char * what() const noexcept override {
-                message_ += '\n' + additionalInfos<
-                    is_streamable<std::stringstream, ValueTypeL>::value &&
-                    is_streamable<std::stringstream, ValueTypeR>::value
-                    , !std::is_same_v<void, ExceptionType>
-                >::get(failure_type_, reached_, expected_, type_helper<ExceptionType>::name());
+            ElementwiseFailure(std::string_view message, const LineInfo& lineInfo, const T* reached, size_t reached_size,
+                const T* expected, size_t expected_size, size_t index, double tolerance)
+                : message_(message), lineInfo_(lineInfo), reached_size_(reached_size), expected_size_(expected_size),
+                index_(index), first_(index > window_before ? index - window_before : 0), tolerance_(tolerance), formatted_(false)
+            {
+                copy_window(reached, reached_size, reached_);
+                copy_window(expected, expected_size, expected_);
+            }
+
+            virtual const char* what() const noexcept override {
+                if (!formatted_) {
+                    formatted_ = true;
+                    std::ostringstream oss;
+                    oss << message_;
+                    if (lineInfo_.isInit()) {
+                        oss << "\t(" << lineInfo_ << ")";
+                    }
+                    oss << '\n';
+                    if (reached_size_ != expected_size_) {
+                        oss << "\t\t\t[REACHED SIZE] " << reached_size_ << " [EXPECTED SIZE] " << expected_size_ << std::endl;
+                    }
+                    if (index_ < std::min(reached_size_, expected_size_)) {
+                        oss << "\t\t\t[FIRST MISMATCH AT] " << index_ << std::endl;
+                        if (tolerance_ >= 0) {
+                            oss << "\t\t\t[TOLERANCE] " << tolerance_ << std::endl;
+                        }
+                        print_window(oss, "\t\t\t[REACHED] ", reached_);
+                        print_window(oss, "\t\t\t[EXPECTED] ", expected_);
+                    }
+                    message_ = oss.str();
+                }
                 return message_.c_str();
             }
 
-            TestFailure& operator=(const TestFailure&) = delete;
+            ElementwiseFailure& operator=(const ElementwiseFailure&) = delete;
 
         private:
 
-            mutable std::string message_;
-            const ValueTypeL reached_;
-            const ValueTypeR expected_;
-            const FailureType failure_type_;
+            void copy_window(const T* values, size_t size, std::vector<T>& window) const {
+                const auto end = std::min(size, index_ + window_after + 1);
+                if (first_ < end) {
+                    window.assign(values + first_, values + end);
+                }
+            }
+
+            // The mismatch is between brackets, nothing is printed for types without operator<<
+            void print_window(std::ostream& os, const char* title, const std::vector<T>& window) const {
+                std::string values;
+                for (size_t i = 0; i < window.size(); ++i) {
+                    const auto value = describe(window[i]);
+                    if (!value.printable) {
+                        return;
+                    }
+                    values += first_ + i == index_ ? " [" + value.text + "]" : ' ' + value.text;
+                }
+                os << title << "from " << first_ << ":" << values << std::endl;
+            }
 
+            mutable std::string message_;
+            const LineInfo lineInfo_;
+            const size_t reached_size_;
+            const size_t expected_size_;
+            const size_t index_;
+            const size_t first_; // index of the first value of the windows
+            std::vector<T> reached_;
+            std::vector<T> expected_;
+            const double tolerance_; // negative when compared with ==
+            mutable bool formatted_;
         };
 
-        // Internal impl for processing an assert and raise the TestFailure Exception
-        template<class ValueTypeL, class ValueTypeR, class ExceptionType = void,
-            typename = std::enable_if_t<
-            std::is_convertible_v<ValueTypeL, ValueTypeR> ||
-            std::is_convertible_v<ValueTypeR, ValueTypeL>>>
-            void FailureTest(bool condition, ValueTypeL reached, ValueTypeR expected, FailureType failure_type, const std::string& message, const LineInfo& lineInfo) {
-            std::ostringstream oss;
-            if (!condition) {
-                if (lineInfo.isInit()) {
-                    oss << message << "\t(" << lineInfo << ")";
-                }
-                else {
-                    oss << message;
+        // Element type of a contiguous range: vector, array, string, C array...
+        template<class Range>
+        using element_t = std::remove_cv_t<std::remove_pointer_t<decltype(std::data(std::declval<const Range&>()))>>;
+
+        // Compares the sizes, then the elements with compare(lhs, rhs, count) returning the first mismatch
+        template<bool Soft, class T, class Compare>
+        void ElementwiseTest(const T* reached, size_t reached_size, const T* expected, size_t expected_size, Compare&& compare,
+            double tolerance, std::string_view message, const LineInfo& lineInfo) {
+            const auto common = std::min(reached_size, expected_size);
+            const auto index = compare(reached, expected, common);
+            if (index < common || reached_size != expected_size) {
+                if constexpr (Soft) {
+                    if (auto buffer = FailureBuffer::current()) {
+                        if (buffer->full()) {
+                            buffer->drop();
+                        }
+                        else {
+                            buffer->record(ElementwiseFailure<T>(message, lineInfo, reached, reached_size, expected, expected_size, index, tolerance).what());
+                        }
+                        return;
+                    }
                 }
-
-                throw TestFailure<ValueTypeL, ValueTypeR, ExceptionType>(oss.str(), reached, expected, failure_type);
+                throw ElementwiseFailure<T>(message, lineInfo, reached, reached_size, expected, expected_size, index, tolerance);
             }
         }
 
         // Assert test class to help verbosing test logic into lambda's impl
-        template<class Expr>
+        // Soft expressions record their failures and let the test go on, see ExpectThat
+        template<class Expr, bool Soft = false>
         class AsserterExpression {
         public:
 
-            using EmptyExpression = AsserterExpression<std::nullptr_t>;
+            using EmptyExpression = AsserterExpression<std::nullptr_t, Soft>;
 
             AsserterExpression()
                 : expr_(nullptr)
@@ -245,59 +632,59 @@ namespace H2OFastTests {
             }
 
             template<class NewExpr>
-            AsserterExpression<NewExpr> andThat(NewExpr&& expr) {
+            AsserterExpression<NewExpr, Soft> andThat(NewExpr&& expr) {
                 return{ std::forward<NewExpr>(expr) };
             }
 
             // True condition
-            EmptyExpression isTrue(const std::string& message = {}, const LineInfo& lineInfo = {}) {
-                FailureTest(expr_, expr_, true, FailureType::equal, message, lineInfo);
+            EmptyExpression isTrue(std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                FailureTest<Soft>(expr_, expr_, true, FailureType::equal, message, lineInfo);
                 return{};
             }
 
             // False condition
-            EmptyExpression isFalse(const std::string& message = {}, const LineInfo& lineInfo = {}) {
-                FailureTest(!expr_, !expr_, false, FailureType::equal, message, lineInfo);
+            EmptyExpression isFalse(std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                FailureTest<Soft>(!expr_, !expr_, false, FailureType::equal, message, lineInfo);
                 return{};
             }
 
             // Verify that two references refer to the same object instance (identity):
             template<class T>
             EmptyExpression isSameAs(const T& actual,
-                const std::string& message = {}, const LineInfo& lineInfo = {}) {
-                FailureTest(&expr_ == &actual, &expr_, &actual, FailureType::equal, message, lineInfo);
+                std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                FailureTest<Soft>(&expr_ == &actual, &expr_, &actual, FailureType::equal, message, lineInfo);
                 return{};
             }
 
             // Verify that two references do not refer to the same object instance (identity):
             template<class T>
             EmptyExpression isNotSameAs(const T& actual,
-                const std::string& message = {}, const LineInfo& lineInfo = {}) {
-                FailureTest(!(&expr_ == &actual), &expr_, &actual, FailureType::different, message, lineInfo);
+                std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                FailureTest<Soft>(!(&expr_ == &actual), &expr_, &actual, FailureType::different, message, lineInfo);
                 return{};
             }
 
             // Verify that a pointer is nullptr:
-            EmptyExpression isNull(const std::string& message = {}, const LineInfo& lineInfo = {}) {
-                FailureTest(expr_ == nullptr, expr_, nullptr, FailureType::equal, message, lineInfo);
+            EmptyExpression isNull(std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                FailureTest<Soft>(expr_ == nullptr, expr_, nullptr, FailureType::equal, message, lineInfo);
                 return{};
             }
 
             // Verify that a pointer is not nullptr:
-            EmptyExpression isNotNull(const std::string& message = {}, const LineInfo& lineInfo = {}) {
-                FailureTest(expr_ != nullptr, expr_, nullptr, FailureType::different, message, lineInfo);
+            EmptyExpression isNotNull(std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                FailureTest<Soft>(expr_ != nullptr, expr_, nullptr, FailureType::different, message, lineInfo);
                 return{};
             }
 
             // Force the test case result to be fail:
-            EmptyExpression fail(const std::string& message = {}, const LineInfo& lineInfo = {}) {
-                FailureTest(false, false, false, FailureType::equal, message, lineInfo);
+            EmptyExpression fail(std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                FailureTest<Soft>(false, false, false, FailureType::equal, message, lineInfo);
                 return{};
             }
 
             // Verify that a function raises an exception:
             template<class ExpectedException>
-            EmptyExpression expectException(const std::string& message = {}, const LineInfo& lineInfo = {}) {
+            EmptyExpression expectException(std::string_view message = {}, const LineInfo& lineInfo = {}) {
                 try {
                     expr_();
                 }
@@ -312,112 +699,112 @@ namespace H2OFastTests {
             // Invoque operator == on T
             template<class T>
             EmptyExpression isEqualTo(const T& expected,
-                const std::string& message = {}, const LineInfo& lineInfo = {}) {
-                FailureTest(expr_ == expected, expr_, expected, FailureType::equal, message, lineInfo);
+                std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                FailureTest<Soft>(expr_ == expected, expr_, expected, FailureType::equal, message, lineInfo);
                 return{};
             }
 
             // Check if 2 doubles are almost equals (tolerance given)
             EmptyExpression isEqualTo(double expected, double tolerance,
-                const std::string& message = {}, const LineInfo& lineInfo = {}) {
+                std::string_view message = {}, const LineInfo& lineInfo = {}) {
                 double diff = expected - expr_;
-                FailureTest(std::abs(diff) <= std::abs(tolerance), expr_, expected, FailureType::equal, message, lineInfo);
+                FailureTest<Soft>(std::abs(diff) <= std::abs(tolerance), expr_, expected, FailureType::equal, message, lineInfo);
                 return{};
             }
 
             // Check if 2 floats are almost equals (tolerance given)
             EmptyExpression isEqualTo(float expected, float tolerance,
-                const std::string& message = {}, const LineInfo& lineInfo = {}) {
+                std::string_view message = {}, const LineInfo& lineInfo = {}) {
                 float diff = expected - expr_;
-                FailureTest(std::abs(diff) <= std::abs(tolerance), expr_, expected, FailureType::equal, message, lineInfo);
+                FailureTest<Soft>(std::abs(diff) <= std::abs(tolerance), expr_, expected, FailureType::equal, message, lineInfo);
                 return{};
             }
 
             // Check if 2 char* are equals, considering the case by default
             EmptyExpression isEqualTo(const char* expected, bool ignoreCase,
-                const std::string& message = {}, const LineInfo& lineInfo = {}) {
-                auto expected_str = std::string{ expected };
-                auto expr_str = std::string{ expr_ };
-                if (ignoreCase) {
-                    tolower_internal(expected_str);
-                    tolower_internal(expr_str);
-                }
-                FailureTest(expected_str == expr_str, expr_str, expected_str, FailureType::equal, message, lineInfo);
+                std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                const auto expr_str = std::string_view{ expr_ };
+                FailureTest<Soft>(equal_strings(expr_str, expected, ignoreCase), expr_str, std::string_view{ expected }, FailureType::equal, message, lineInfo);
                 return{};
             }
 
             // Check if 2 strings are equals, considering the case by default
-            EmptyExpression isEqualTo(std::string expected, bool ignoreCase,
-                const std::string& message = {}, const LineInfo& lineInfo = {}) {
-                if (ignoreCase) {
-                    tolower_internal(expected);
-                    tolower_internal(expr_);
-                }
-                FailureTest(expected == expr_, expr_, expected, FailureType::equal, message, lineInfo);
+            EmptyExpression isEqualTo(const std::string& expected, bool ignoreCase,
+                std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                FailureTest<Soft>(equal_strings(expr_, expected, ignoreCase), expr_, expected, FailureType::equal, message, lineInfo);
+                return{};
+            }
+
+            // Compare two contiguous ranges of the same element type, element by element
+            // Only the first mismatch is reported, with the values around it
+            template<class Range>
+            EmptyExpression isElementwiseEqualTo(const Range& expected,
+                std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                using T = element_t<Range>;
+                static_assert(std::is_same<T, element_t<std::decay_t<Expr>>>::value, "Elementwise asserts compare ranges of the same element type");
+                ElementwiseTest<Soft, T>(std::data(expr_), std::size(expr_), std::data(expected), std::size(expected), [](const T* lhs, const T* rhs, size_t count) {
+                    return first_mismatch(lhs, rhs, count);
+                }, -1, message, lineInfo);
+                return{};
+            }
+
+            // Same for floats or doubles, each element within tolerance of the expected one
+            template<class Range>
+            EmptyExpression isElementwiseNear(const Range& expected, element_t<Range> tolerance,
+                std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                using T = element_t<Range>;
+                static_assert(std::is_same<T, element_t<std::decay_t<Expr>>>::value, "Elementwise asserts compare ranges of the same element type");
+                ElementwiseTest<Soft, T>(std::data(expr_), std::size(expr_), std::data(expected), std::size(expected), [tolerance](const T* lhs, const T* rhs, size_t count) {
+                    return first_far(lhs, rhs, count, tolerance);
+                }, std::abs(tolerance), message, lineInfo);
                 return{};
             }
 
             // Invoque !operator == on T
             template<class T>
             EmptyExpression isNotEqualTo(const T& notExpected,
-                const std::string& message = {}, const LineInfo& lineInfo = {}) {
-                FailureTest(!(notExpected == expr_), expr_, notExpected, FailureType::different, message, lineInfo);
+                std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                FailureTest<Soft>(!(notExpected == expr_), expr_, notExpected, FailureType::different, message, lineInfo);
                 return{};
             }
 
             // Check if 2 doubles are not almost equals (tolerance given)
             EmptyExpression isNotEqualTo(double notExpected, double tolerance,
-                const std::string& message = {}, const LineInfo& lineInfo = {}) {
+                std::string_view message = {}, const LineInfo& lineInfo = {}) {
                 double diff = notExpected - expr_;
-                FailureTest(std::abs(diff) > std::abs(tolerance), expr_, notExpected, FailureType::different, message, lineInfo);
+                FailureTest<Soft>(std::abs(diff) > std::abs(tolerance), expr_, notExpected, FailureType::different, message, lineInfo);
                 return{};
             }
 
             // Check if 2 floats are not almost equals (tolerance given)
             EmptyExpression isNotEqualTo(float notExpected, float expr_, float tolerance,
-                const std::string& message = {}, const LineInfo& lineInfo = {}) {
+                std::string_view message = {}, const LineInfo& lineInfo = {}) {
                 float diff = notExpected - expr_;
-                FailureTest(std::abs(diff) > std::abs(tolerance), expr_, notExpected, FailureType::different, message, lineInfo);
+                FailureTest<Soft>(std::abs(diff) > std::abs(tolerance), expr_, notExpected, FailureType::different, message, lineInfo);
                 return{};
             }
 
             // Check if 2 char* are not equals, considering the case by default
             EmptyExpression isNotEqualTo(const char* notExpected, bool ignoreCase,
-                const std::string& message = {}, const LineInfo& lineInfo = {}) {
-                auto notExpected_str = std::string{ notExpected };
-                auto expr_str = std::string{ expr_ };
-                if (ignoreCase) {
-                    tolower_internal(notExpected_str);
-                    tolower_internal(expr_str);
-                }
-                FailureTest(notExpected_str != expr_str, expr_str, notExpected_str, FailureType::different, message, lineInfo);
+                std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                const auto expr_str = std::string_view{ expr_ };
+                FailureTest<Soft>(!equal_strings(expr_str, notExpected, ignoreCase), expr_str, std::string_view{ notExpected }, FailureType::different, message, lineInfo);
                 return{};
             }
 
             // Check if 2 strings are not equals, considering the case by default
-            EmptyExpression isNotEqualTo(std::string notExpected, bool ignoreCase,
-                const std::string& message = {}, const LineInfo& lineInfo = {}) {
-                if (ignoreCase) {
-                    tolower_internal(notExpected);
-                    tolower_internal(expr_);
-                }
-                FailureTest(notExpected != expr_, expr_, notExpected, FailureType::different, message, lineInfo);
+            EmptyExpression isNotEqualTo(const std::string& notExpected, bool ignoreCase,
+                std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                FailureTest<Soft>(!equal_strings(expr_, notExpected, ignoreCase), expr_, notExpected, FailureType::different, message, lineInfo);
                 return{};
             }
 
         private:
 
-            // Lower case function
-            void tolower_internal(std::string& s) {
-                std::transform(s.begin(), s.end(), s.begin(), [](char c) {
-                    return static_cast<char>(::tolower(static_cast<int>(c)));
-                });
-            }
-
             // Force the test case result to be fail:
             template<class ExpectedException>
-            EmptyExpression fail_exception(const std::string& message = {}, const LineInfo& lineInfo = {}) {
-                FailureTest<bool, bool, ExpectedException>(false, false, false, FailureType::exception, message, lineInfo);
+            EmptyExpression fail_exception(std::string_view message = {}, const LineInfo& lineInfo = {}) {
+                FailureTest<Soft, bool, bool, ExpectedException>(false, false, false, FailureType::exception, message, lineInfo);
                 return{};
             }
 
@@ -430,93 +817,605 @@ namespace H2OFastTests {
             return{ std::forward<Expr>(expr) };
         }
 
-        using TestFunctor = std::function<void(void)>;
-        using SetUpFunctor = std::function<void(void)>;
-        using TearDownFunctor = std::function<void(void)>;
-        using Duration = std::chrono::duration<double, std::milli>; // ms
+        // Same as AssertThat, but a failure does not stop the test: it is recorded, and the test
+        // fails once its body returned, reporting every failure
+        template<class Expr>
+        AsserterExpression<Expr, true> ExpectThat(Expr&& expr) {
+            return{ std::forward<Expr>(expr) };
+        }
 
-        // Standard class discribing a test
-        class Test {
+        // Move only void() callable. Callables up to buffer_size bytes are stored inline,
+        // bigger ones (or ones that may throw when moved) on the heap.
+        class SmallFunction {
         public:
 
-            // States of the test
-            enum class Status {
-                PASSED,    // test successfuly passed
-                FAILED,    // test failed to pass (an assert failed)
-                ERROR,    // an error occured during the test :
-                // any exception was catched like bad_alloc
-                SKIPPED,// test was skipped and not run
-                NONE    // the run_scenario function wasn't run yet
-                // for the scenario holding the test
-            };
+            static const size_t buffer_size = 6 * sizeof(void*);
 
-            // All available constructors
-            Test()
-                : Test({}, []() {}) {}
-            Test(const TestFunctor&& test)
-                : Test("", std::move(test)) {}
-            Test(const std::string& label)
-                : Test(label, []() {}) {}
-            Test(const std::string& label, const TestFunctor&& test)
-                : test_holder_(std::make_unique<TestFunctor>(std::move(test))), label_(label), status_(Status::NONE)
+            SmallFunction() noexcept
+                : operations_(nullptr)
             {}
 
-            // Copy forbidden
-            Test(const Test&) = delete;
-            Test& operator=(const Test&) = delete;
+            template<class Function, typename = std::enable_if_t<!std::is_same<std::decay_t<Function>, SmallFunction>::value && std::is_invocable<std::decay_t<Function>&>::value>>
+            SmallFunction(Function&& function)
+                : operations_(nullptr)
+            {
+                using Stored = std::decay_t<Function>;
+                using Inline = std::integral_constant<bool, sizeof(Stored) <= buffer_size &&
+                    alignof(Stored) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<Stored>::value>;
+                store<Stored>(std::forward<Function>(function), Inline{});
+            }
 
-            // Default move impl (for VC2013)
-            Test(Test&& test)
-                : exec_time_ms_(test.exec_time_ms_),
-                test_holder_(std::move(test.test_holder_)), label_(test.label_),
-                failure_reason_(test.failure_reason_), skipped_reason_(test.skipped_reason_),
-                error_(test.error_), status_(test.status_)
-            {}
-            Test&& operator=(Test&& test) {
-                test_holder_ = std::move(test.test_holder_);
-                label_ = test.label_;
-                status_ = test.status_;
-                exec_time_ms_ = test.exec_time_ms_;
-                failure_reason_ = test.failure_reason_;
-                skipped_reason_ = test.skipped_reason_;
-                error_ = test.error_;
-                return std::move(*this);
+            SmallFunction(const SmallFunction&) = delete;
+            SmallFunction& operator=(const SmallFunction&) = delete;
+
+            SmallFunction(SmallFunction&& function) noexcept
+                : operations_(function.operations_)
+            {
+                if (operations_) {
+                    operations_->move(function.buffer_, buffer_);
+                    function.operations_ = nullptr;
+                }
             }
 
-            Test(std::reference_wrapper<Test> test)
-                : Test(std::move(test.get()))
-            {}
+            SmallFunction& operator=(SmallFunction&& function) noexcept {
+                if (this != &function) {
+                    reset();
+                    if (function.operations_) {
+                        function.operations_->move(function.buffer_, buffer_);
+                        operations_ = function.operations_;
+                        function.operations_ = nullptr;
+                    }
+                }
+                return *this;
+            }
 
-            // Virtual destructor impl
-            virtual ~Test() {}
+            ~SmallFunction() { reset(); }
 
-            // Information getters
-            const std::string& getLabel(bool verbose) const { return getLabel_private(verbose); }
-            const std::string& getFailureReason() const { return getFailureReason_private(); }
-            const std::string& getSkippedReason() const { return getSkippedReason_private(); }
-            const std::string& getError() const { return getError_private(); }
-            Duration getExecTimeMs() const { return getExecTimeMs_private(); }
-            Status getStatus() const { return getStatus_private(); }
+            void operator()() const {
+                if (!operations_) {
+                    throw std::bad_function_call{};
+                }
+                operations_->invoke(buffer_);
+            }
 
-        protected:
+            explicit operator bool() const noexcept { return operations_ != nullptr; }
 
-            // Called by RegistryManager
-            void run(const SetUpFunctor& setup, const TearDownFunctor& teardown) {
-                setup();
-                run_private();
-                teardown();
+        private:
+
+            struct Operations {
+                void(*invoke)(void* buffer);
+                void(*move)(void* from, void* to) noexcept; // move constructs into to, then destroys from
+                void(*destroy)(void* buffer) noexcept;
+            };
+
+            template<class Stored>
+            struct InlineOperations {
+                static void invoke(void* buffer) { (*static_cast<Stored*>(buffer))(); }
+                static void move(void* from, void* to) noexcept {
+                    new (to) Stored(std::move(*static_cast<Stored*>(from)));
+                    static_cast<Stored*>(from)->~Stored();
+                }
+                static void destroy(void* buffer) noexcept { static_cast<Stored*>(buffer)->~Stored(); }
+                static constexpr Operations table{ &invoke, &move, &destroy };
+            };
+
+            template<class Stored>
+            struct HeapOperations {
+                static Stored*& pointer(void* buffer) { return *static_cast<Stored**>(buffer); }
+                static void invoke(void* buffer) { (*pointer(buffer))(); }
+                static void move(void* from, void* to) noexcept { new (to) Stored*(pointer(from)); }
+                static void destroy(void* buffer) noexcept { delete pointer(buffer); }
+                static constexpr Operations table{ &invoke, &move, &destroy };
+            };
+
+            template<class Stored, class Function>
+            void store(Function&& function, std::true_type /*inline*/) {
+                new (buffer_) Stored(std::forward<Function>(function));
+                operations_ = &InlineOperations<Stored>::table;
             }
 
-            // Run the test and capture and set the state
-            virtual void run_private() {
-                auto start = std::chrono::high_resolution_clock::now();
-                try {
-                    (*test_holder_)(); /* /!\ Here is the test call /!\ */
-                    status_ = Status::PASSED;
+            template<class Stored, class Function>
+            void store(Function&& function, std::false_type /*inline*/) {
+                new (buffer_) Stored*(new Stored(std::forward<Function>(function)));
+                operations_ = &HeapOperations<Stored>::table;
+            }
+
+            void reset() noexcept {
+                if (operations_) {
+                    operations_->destroy(buffer_);
+                    operations_ = nullptr;
                 }
-                catch (const GenericTestFailure& failure) {
+            }
+
+            const Operations* operations_;
+            alignas(std::max_align_t) mutable unsigned char buffer_[buffer_size];
+        };
+
+        using TestFunctor = SmallFunction;
+        using SetUpFunctor = std::function<void(void)>;
+        using TearDownFunctor = std::function<void(void)>;
+        using Duration = std::chrono::duration<double, std::milli>; // ms
+
+#if H2OFT_HAS_TSC_
+        // Reads the time stamp counter, converted with its frequency measured once against
+        // steady_clock. Cheaper to read, but only steady on processors with an invariant counter.
+        struct TscClock {
+            using rep = long long;
+            using period = std::nano;
+            using duration = std::chrono::nanoseconds;
+            using time_point = std::chrono::time_point<TscClock>;
+            static constexpr bool is_steady = true;
+
+            static time_point now() {
+                static const auto calibration = calibrate();
+                return time_point{ duration{ static_cast<rep>((__rdtsc() - calibration.first) * calibration.second) } };
+            }
+
+        private:
+
+            // First read of the counter and ns per tick
+            static std::pair<unsigned long long, double> calibrate() {
+                const auto start = std::chrono::steady_clock::now();
+                const auto first = __rdtsc();
+                while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds{ 10 }) {}
+                const auto ticks = __rdtsc() - first;
+                const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+                return{ first, elapsed.count() / static_cast<double>(ticks ? ticks : 1) };
+            }
+        };
+#endif
+
+        // Clock timing the tests: H2OFT_CLOCK when defined, TscClock with H2OFT_USE_TSC,
+        // steady_clock otherwise (it reads QueryPerformanceCounter with MSVC)
+#if defined(H2OFT_CLOCK)
+        using TestClock = H2OFT_CLOCK;
+#elif H2OFT_HAS_TSC_
+        using TestClock = TscClock;
+#else
+        using TestClock = std::chrono::steady_clock;
+#endif
+        static_assert(TestClock::is_steady, "The clock timing the tests must be steady");
+
+        // Counts of hardware events of the body of a test, see PerfCounters
+        // Instruction counts are far more stable than times from one run to the other
+        struct PerfStats {
+            enum Event { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, TASK_CLOCK, EVENT_COUNT };
+
+            uint64_t values[EVENT_COUNT] = {}; // TASK_CLOCK is in ns of CPU time
+            uint32_t counted = 0;              // bit e is set when the event e was counted
+
+            bool has(Event event) const { return (counted >> event) & 1; }
+
+            static const char* name(Event event) {
+                static const char* const names[EVENT_COUNT] = { "cycles", "instructions", "cache_misses", "branch_misses", "task_clock_ns" };
+                return names[event];
+            }
+        };
+
+        // Statistics of a benchmark, in ms per iteration
+        struct BenchmarkStats {
+            uint64_t samples = 0;
+            uint64_t iterations = 0; // per sample
+            double min = 0;
+            double median = 0;
+            double p99 = 0;
+            double mean = 0;
+            double stddev = 0;
+            PerfStats counters; // over all the samples, with H2OFT_PERF_COUNTERS
+
+            // Mean count of an event per iteration, 0 when it was not counted
+            double per_iteration(PerfStats::Event event) const {
+                return counters.has(event) && samples * iterations > 0 ? static_cast<double>(counters.values[event]) / (samples * iterations) : 0;
+            }
+
+            // samples holds the ms per iteration of each sample
+            static BenchmarkStats from_samples(std::vector<double> samples, uint64_t iterations) {
+                BenchmarkStats stats;
+                stats.samples = samples.size();
+                stats.iterations = iterations;
+                if (samples.empty()) {
+                    return stats;
+                }
+                std::sort(samples.begin(), samples.end());
+                const auto count = samples.size();
+                stats.min = samples.front();
+                stats.median = count % 2 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+                stats.p99 = samples[static_cast<size_t>(std::ceil(0.99 * count)) - 1];
+                double sum = 0;
+                for (auto sample : samples) {
+                    sum += sample;
+                }
+                stats.mean = sum / count;
+                if (count > 1) {
+                    double squares = 0;
+                    for (auto sample : samples) {
+                        squares += (sample - stats.mean) * (sample - stats.mean);
+                    }
+                    stats.stddev = std::sqrt(squares / (count - 1));
+                }
+                return stats;
+            }
+        };
+
+        // Allocations made by the body of a test, see AllocationCounter
+        struct AllocationStats {
+            uint64_t allocations = 0;
+            uint64_t deallocations = 0; // of the blocks allocated by the body
+            uint64_t bytes = 0;         // allocated in total
+            uint64_t peak_bytes = 0;    // most bytes allocated by the body at once
+            uint64_t live_bytes = 0;    // allocated by the body and not freed once it returned
+
+            uint64_t leaks() const { return allocations - deallocations; }
+        };
+
+#if H2OFT_HAS_PERF_EVENTS_
+        // perf_event counters of the calling thread, opened on first use and left running:
+        // a measure reads them before and after, so measures nest. The counters of a forked
+        // worker would still count its parent, they are opened again in the child.
+        // Events that cannot be opened (virtual machines often lack the hardware ones,
+        // perf_event_paranoid may forbid them) are left out of the measures.
+        class PerfCounters {
+        public:
+
+            static PerfCounters& of_thread() {
+                thread_local PerfCounters counters;
+                if (counters.pid_ != getpid()) {
+                    counters.close_all();
+                    counters.open();
+                }
+                return counters;
+            }
+
+            struct Reading {
+                uint64_t values[PerfStats::EVENT_COUNT];
+                uint64_t enabled[PerfStats::EVENT_COUNT];
+                uint64_t running[PerfStats::EVENT_COUNT];
+            };
+
+            void read(Reading& reading) const {
+                for (int event = 0; event < PerfStats::EVENT_COUNT; ++event) {
+                    uint64_t data[3] = {}; // value, time enabled, time running
+                    if (fds_[event] >= 0 && ::read(fds_[event], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) {
+                        data[2] = 0;
+                    }
+                    reading.values[event] = data[0];
+                    reading.enabled[event] = data[1];
+                    reading.running[event] = data[2];
+                }
+            }
+
+            // Counts between two readings, scaled when the kernel multiplexed the counters
+            void difference(const Reading& start, const Reading& end, PerfStats& stats) const {
+                stats = PerfStats{};
+                for (int event = 0; event < PerfStats::EVENT_COUNT; ++event) {
+                    const auto running = end.running[event] - start.running[event];
+                    if (fds_[event] < 0 || end.running[event] == 0) {
+                        continue;
+                    }
+                    const auto enabled = end.enabled[event] - start.enabled[event];
+                    const double count = static_cast<double>(end.values[event] - start.values[event]);
+                    stats.values[event] = static_cast<uint64_t>(running > 0 && enabled > running ? count * enabled / running : count);
+                    stats.counted |= 1u << event;
+                }
+            }
+
+            bool any() const {
+                return std::any_of(std::begin(fds_), std::end(fds_), [](int fd) { return fd >= 0; });
+            }
+
+            PerfCounters(const PerfCounters&) = delete;
+            PerfCounters& operator=(const PerfCounters&) = delete;
+
+        private:
+
+            PerfCounters() : pid_(getpid()) {
+                open();
+            }
+
+            ~PerfCounters() {
+                close_all();
+            }
+
+            void open() {
+                pid_ = getpid();
+                const std::pair<uint32_t, uint64_t> events[PerfStats::EVENT_COUNT] = {
+                    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+                    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+                    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+                    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+                    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+                };
+                for (int event = 0; event < PerfStats::EVENT_COUNT; ++event) {
+                    perf_event_attr attr;
+                    std::memset(&attr, 0, sizeof(attr));
+                    attr.size = sizeof(attr);
+                    attr.type = events[event].first;
+                    attr.config = events[event].second;
+                    attr.exclude_kernel = 1;
+                    attr.exclude_hv = 1;
+                    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                    // This thread, on any CPU
+                    fds_[event] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+                }
+            }
+
+            void close_all() {
+                for (auto& fd : fds_) {
+                    if (fd >= 0) {
+                        close(fd);
+                        fd = -1;
+                    }
+                }
+            }
+
+            pid_t pid_;
+            int fds_[PerfStats::EVENT_COUNT];
+        };
+
+        // Measures the events of its thread while it exists
+        class PerfMeasure {
+        public:
+
+            explicit PerfMeasure(PerfStats& stats)
+                : counters_(PerfCounters::of_thread()), stats_(stats)
+            {
+                counters_.read(start_);
+            }
+
+            ~PerfMeasure() {
+                PerfCounters::Reading end;
+                counters_.read(end);
+                counters_.difference(start_, end, stats_);
+            }
+
+            PerfMeasure(const PerfMeasure&) = delete;
+            PerfMeasure& operator=(const PerfMeasure&) = delete;
+
+        private:
+
+            PerfCounters& counters_;
+            PerfStats& stats_;
+            PerfCounters::Reading start_;
+        };
+#endif
+
+        // Limits of the allocations of the body of a test, see RegistryManager::add_test
+        struct AllocationBudget {
+            uint64_t allocations = std::numeric_limits<uint64_t>::max();
+            uint64_t bytes = std::numeric_limits<uint64_t>::max(); // allocated in total
+            bool leaks = true; // whether blocks may be left allocated
+
+            // For code that must not allocate at all
+            static AllocationBudget none() {
+                AllocationBudget budget;
+                budget.allocations = 0;
+                budget.bytes = 0;
+                budget.leaks = false;
+                return budget;
+            }
+
+            static AllocationBudget no_leaks() {
+                AllocationBudget budget;
+                budget.leaks = false;
+                return budget;
+            }
+        };
+
+        // Counts the allocations of its thread while it exists, attributing them to a test
+        // The replacements of the global operator new and delete that feed it are only linked in
+        // with src/H2OFastTests_AllocationHooks.cpp: without them, nothing is counted.
+        // Each block records the counter that allocated it, so that only the blocks of the
+        // body are counted as freed, even when a counter follows another on the same thread.
+        class AllocationCounter {
+        public:
+
+            explicit AllocationCounter(AllocationStats& stats)
+                : stats_(stats), previous_(current()), token_(last_token().fetch_add(1, std::memory_order_relaxed) + 1)
+            {
+                stats_ = AllocationStats{};
+                current() = this;
+            }
+
+            ~AllocationCounter() {
+                current() = previous_;
+            }
+
+            AllocationCounter(const AllocationCounter&) = delete;
+            AllocationCounter& operator=(const AllocationCounter&) = delete;
+
+            // Null when the allocations of this thread are not counted
+            static AllocationCounter*& current() {
+                thread_local AllocationCounter* counter = nullptr;
+                return counter;
+            }
+
+            // Set by the allocation hooks when they are linked in
+            static std::atomic<bool>& installed() {
+                static std::atomic<bool> hooks{ false };
+                return hooks;
+            }
+
+            // Returns the token to record in the block
+            uint64_t allocate(size_t size) {
+                ++stats_.allocations;
+                stats_.bytes += size;
+                stats_.live_bytes += size;
+                stats_.peak_bytes = std::max(stats_.peak_bytes, stats_.live_bytes);
+                return token_;
+            }
+
+            void deallocate(uint64_t token, size_t size) {
+                if (token == token_ && stats_.live_bytes >= size) {
+                    ++stats_.deallocations;
+                    stats_.live_bytes -= size;
+                }
+            }
+
+        private:
+
+            // Process wide: a block freed on another thread than the one which allocated it
+            // must not match the counter of that thread
+            static std::atomic<uint64_t>& last_token() {
+                static std::atomic<uint64_t> token{ 0 };
+                return token;
+            }
+
+            AllocationStats& stats_;
+            AllocationCounter* previous_;
+            const uint64_t token_; // unique in the process
+        };
+
+        struct ScheduledTest;
+        class RunControl;
+
+        // Standard class discribing a test
+        class Test {
+        public:
+
+            // States of the test
+            enum class Status {
+                PASSED,    // test successfuly passed
+                FAILED,    // test failed to pass (an assert failed)
+                ERROR,    // an error occured during the test :
+                // any exception was catched like bad_alloc
+                SKIPPED,// test was skipped and not run
+                SLOW,   // test passed but took longer than its baseline allows
+                TIMEOUT,// test took longer than its timeout, or was killed for it
+                NONE    // the run_scenario function wasn't run yet
+                // for the scenario holding the test
+            };
+
+            // All available constructors
+            Test()
+                : Test({}, []() {}) {}
+            Test(TestFunctor&& test)
+                : Test("", std::move(test)) {}
+            Test(const std::string& label)
+                : Test(label, []() {}) {}
+            Test(const std::string& label, TestFunctor&& test)
+                : exec_time_ms_(0), setup_time_ms_(0), teardown_time_ms_(0), test_holder_(std::move(test)), label_(label), failure_count_(0), status_(Status::NONE), serial_(false), timeout_(0),
+                allocations_counted_(false)
+            {}
+
+            // Copy forbidden
+            Test(const Test&) = delete;
+            Test& operator=(const Test&) = delete;
+
+            // Default move impl (for VC2013)
+            Test(Test&& test)
+                : exec_time_ms_(test.exec_time_ms_), setup_time_ms_(test.setup_time_ms_), teardown_time_ms_(test.teardown_time_ms_),
+                test_holder_(std::move(test.test_holder_)), label_(test.label_),
+                failure_reason_(test.failure_reason_), failures_(test.failures_), failure_count_(test.failure_count_), skipped_reason_(test.skipped_reason_),
+                error_(test.error_), status_(test.status_), serial_(test.serial_), timeout_(test.timeout_),
+                allocation_stats_(test.allocation_stats_), allocation_budget_(test.allocation_budget_), allocations_counted_(test.allocations_counted_),
+                perf_stats_(test.perf_stats_)
+            {}
+            Test&& operator=(Test&& test) {
+                test_holder_ = std::move(test.test_holder_);
+                label_ = test.label_;
+                status_ = test.status_;
+                exec_time_ms_ = test.exec_time_ms_;
+                setup_time_ms_ = test.setup_time_ms_;
+                teardown_time_ms_ = test.teardown_time_ms_;
+                failure_reason_ = test.failure_reason_;
+                failures_ = test.failures_;
+                failure_count_ = test.failure_count_;
+                skipped_reason_ = test.skipped_reason_;
+                error_ = test.error_;
+                serial_ = test.serial_;
+                timeout_ = test.timeout_;
+                allocation_stats_ = test.allocation_stats_;
+                allocation_budget_ = test.allocation_budget_;
+                allocations_counted_ = test.allocations_counted_;
+                perf_stats_ = test.perf_stats_;
+                return std::move(*this);
+            }
+
+            Test(std::reference_wrapper<Test> test)
+                : Test(std::move(test.get()))
+            {}
+
+            // Virtual destructor impl
+            virtual ~Test() {}
+
+            // Information getters
+            const std::string& getLabel(bool verbose) const { return getLabel_private(verbose); }
+            const std::string& getFailureReason() const { return getFailureReason_private(); }
+            // Messages of the failed asserts and expectations of the last run, in order
+            // At most FailureBuffer::capacity of them are kept, getFailureCount() counts them all
+            const std::vector<std::string>& getFailures() const { return failures_; }
+            size_t getFailureCount() const { return failure_count_; }
+            const std::string& getSkippedReason() const { return getSkippedReason_private(); }
+            const std::string& getError() const { return getError_private(); }
+            Duration getExecTimeMs() const { return getExecTimeMs_private(); }
+            // Time of the set up and tear down run around the body, which getExecTimeMs() times alone
+            Duration getSetUpTimeMs() const { return setup_time_ms_; }
+            Duration getTearDownTimeMs() const { return teardown_time_ms_; }
+            Status getStatus() const { return getStatus_private(); }
+            bool isSerial() const { return serial_; }
+            // 0 when the test has no timeout of its own
+            Duration getTimeout() const { return timeout_; }
+            // Null unless the test is a benchmark that was run
+            const BenchmarkStats* getBenchmarkStats() const { return getBenchmarkStats_private(); }
+            // Null unless the body was measured with H2OFT_PERF_COUNTERS and an event could be counted
+            const PerfStats* getPerfStats() const { return perf_stats_.counted ? &perf_stats_ : nullptr; }
+            // Null unless the test was run with the allocation hooks linked in, see AllocationCounter
+            const AllocationStats* getAllocationStats() const { return allocations_counted_ ? &allocation_stats_ : nullptr; }
+            const AllocationBudget& getAllocationBudget() const { return allocation_budget_; }
+
+        protected:
+
+            // Called by RegistryManager
+            void run(const SetUpFunctor& setup, const TearDownFunctor& teardown) {
+                auto start = TestClock::now();
+                setup();
+                setup_time_ms_ = TestClock::now() - start;
+                run_private();
+                start = TestClock::now();
+                teardown();
+                teardown_time_ms_ = TestClock::now() - start;
+            }
+
+            // Called by the parallel runner on the chunks of a test split in several, see ParameterizedTest
+            void run_chunk(const SetUpFunctor& setup, const TearDownFunctor& teardown, size_t chunk) {
+                auto start = TestClock::now();
+                setup();
+                const Duration setup_time = TestClock::now() - start;
+                run_chunk_private(chunk);
+                start = TestClock::now();
+                teardown();
+                set_chunk_phases_private(chunk, setup_time, TestClock::now() - start);
+            }
+
+            // Run the test and capture and set the state
+            virtual void run_private() {
+                run_guarded([this]() {
+                    test_holder_(); /* /!\ Here is the test call /!\ */
+                });
+            }
+
+            // Time body and set the state from its outcome
+            // The failure reason lists every failure: the expectations, then the assert that stopped the body
+            template<class Body>
+            void run_guarded(Body&& body) {
+                auto start = TestClock::now();
+                ExpectationScope expectations;
+                bool stopped = false; // by a failed assert
+                allocations_counted_ = AllocationCounter::installed();
+                perf_stats_ = PerfStats{};
+                try {
+                    AllocationCounter allocations{ allocation_stats_ };
+#if H2OFT_HAS_PERF_EVENTS_
+                    PerfMeasure perf{ perf_stats_ };
+#endif
+                    body();
+                    status_ = Status::PASSED;
+                }
+                catch (const GenericTestFailure& failure) {
                     status_ = Status::FAILED;
-                    failure_reason_ = failure.what();
+                    failures_ = expectations.records();
+                    failures_.emplace_back(failure.what());
+                    stopped = true;
                 }
                 catch (const std::exception& e) {
                     status_ = Status::ERROR;
@@ -526,7 +1425,59 @@ namespace H2OFastTests {
                     status_ = Status::ERROR;
                     error_ = "Unkown error";
                 }
-                exec_time_ms_ = std::chrono::high_resolution_clock::now() - start;
+                exec_time_ms_ = TestClock::now() - start;
+                set_failures(expectations, stopped);
+                if (status_ == Status::PASSED && allocations_counted_) {
+                    check_allocations();
+                }
+            }
+
+            // Fails a test whose body allocated more than its budget allows
+            void check_allocations() {
+                const auto& stats = allocation_stats_;
+                const auto& budget = allocation_budget_;
+                char reason[160];
+                if (stats.allocations > budget.allocations || stats.bytes > budget.bytes) {
+                    std::snprintf(reason, sizeof(reason), "Allocated %llu blocks (%llu bytes), over its budget of %llu blocks (%llu bytes)",
+                        static_cast<unsigned long long>(stats.allocations), static_cast<unsigned long long>(stats.bytes),
+                        static_cast<unsigned long long>(budget.allocations), static_cast<unsigned long long>(budget.bytes));
+                }
+                else if (!budget.leaks && stats.leaks() > 0) {
+                    std::snprintf(reason, sizeof(reason), "Leaked %llu blocks (%llu bytes)",
+                        static_cast<unsigned long long>(stats.leaks()), static_cast<unsigned long long>(stats.live_bytes));
+                }
+                else {
+                    return;
+                }
+                status_ = Status::FAILED;
+                failure_reason_ = reason;
+                failures_.assign(1, failure_reason_);
+                failure_count_ = 1;
+            }
+
+            void set_failures(const ExpectationScope& expectations, bool stopped) {
+                if (!stopped) {
+                    failures_ = expectations.records();
+                }
+                set_failure_reason(expectations.failures() + (stopped ? 1 : 0));
+            }
+
+            // failures_ holds the messages of the failures that were recorded, count counts them all
+            void set_failure_reason(size_t count) {
+                failure_count_ = count;
+                if (failure_count_ == 0) {
+                    return;
+                }
+                if (status_ == Status::PASSED) {
+                    status_ = Status::FAILED;
+                }
+                failure_reason_.clear();
+                for (const auto& failure : failures_) {
+                    failure_reason_ += failure;
+                }
+                if (failure_count_ > failures_.size()) {
+                    failure_reason_ += "\t(" + std::to_string(failure_count_) + " failures, " + std::to_string(failure_count_ - failures_.size()) + " not recorded)\n";
+                }
             }
 
             // Informations getters impl
@@ -536,47 +1487,127 @@ namespace H2OFastTests {
             virtual const std::string& getError_private() const { return error_; }
             virtual Duration getExecTimeMs_private() const { return exec_time_ms_; }
             virtual Status getStatus_private() const { return status_; }
+            virtual const BenchmarkStats* getBenchmarkStats_private() const { return nullptr; }
+            virtual void setBenchmarkStats_private(const BenchmarkStats& /*stats*/) {}
+
+            // A test in several chunks returns their number, at most parts, once ready to run them.
+            // Its chunks can then run concurrently, and the state is set once they are all merged.
+            virtual size_t split_private(size_t /*parts*/) { return 1; }
+            virtual void run_chunk_private(size_t /*chunk*/) {}
+            virtual void set_chunk_phases_private(size_t /*chunk*/, Duration /*setup*/, Duration /*teardown*/) {}
+            virtual void merge_chunks_private() {}
+            // A coroutine test is run by the event loop of the scheduler, see AsyncTest
+            virtual bool is_async_private() const { return false; }
+            // The scheduler hands the coroutine tests of a run to the first of them, so their event
+            // loop is compiled with them, whatever the standard the library was built with
+            virtual void run_coroutines_private(const std::vector<ScheduledTest>& /*tasks*/, const RunControl& /*control*/, size_t /*at_once*/) {}
 
         protected:
 
             Duration exec_time_ms_;
-            std::unique_ptr<TestFunctor> test_holder_;
+            Duration setup_time_ms_;
+            Duration teardown_time_ms_;
+            TestFunctor test_holder_;
             std::string label_;
             std::string failure_reason_;
+            std::vector<std::string> failures_;
+            size_t failure_count_;
             std::string skipped_reason_;
             std::string error_;
             Status status_;
+            bool serial_; // must not run concurrently with any other test
+            Duration timeout_;
+            AllocationStats allocation_stats_;
+            AllocationBudget allocation_budget_;
+            bool allocations_counted_;
+            PerfStats perf_stats_;
+
+        private:
+
+            // Called by the scheduler when the set up of its scenario threw
+            void set_scenario_error(const std::string& error) {
+                status_ = Status::ERROR;
+                error_ = "Set up of the scenario failed: " + error;
+                exec_time_ms_ = Duration{ 0 };
+            }
+
+            // Called by the worker processes when the set up or the tear down of the test threw
+            void set_fixture_error(const std::string& error) {
+                status_ = Status::ERROR;
+                error_ = "Set up or tear down failed: " + error;
+            }
+
+            // Called by the schedulers once the test exceeded its timeout
+            void set_timed_out(Duration timeout, const char* detail = "") {
+                char reason[128];
+                std::snprintf(reason, sizeof(reason), "Exceeded its timeout of %.3f ms%s", timeout.count(), detail);
+                status_ = Status::TIMEOUT;
+                failure_reason_ = reason;
+            }
+
+            // Frees the messages of the last run, see RegistryManager::set_results_retained
+            void release_messages() {
+                std::string{}.swap(failure_reason_);
+                std::vector<std::string>{}.swap(failures_);
+                std::string{}.swap(error_);
+            }
 
             template<class ScenarioName>
             friend class RegistryManager;
+            friend class TestScheduler;
+            friend class ProcessShards;
+            friend class BaselineGate;
+            friend class Watchdog;
+            friend class EventLoop;
         };
 
-        std::ostream& operator<<(std::ostream& os, Test::Status status) {
+#if H2OFT_DEFINE_FUNCTIONS_
+        H2OFT_INLINE const char* status_name(Test::Status status) {
             switch (status) {
             case Test::Status::PASSED:
-                os << "PASSED";
-                break;
+                return "PASSED";
             case Test::Status::FAILED:
-                os << "FAILED";
-                break;
+                return "FAILED";
             case Test::Status::ERROR:
-                os << "ERROR";
-                break;
+                return "ERROR";
             case Test::Status::SKIPPED:
-                os << "SKIPPED";
-                break;
+                return "SKIPPED";
+            case Test::Status::SLOW:
+                return "SLOW";
+            case Test::Status::TIMEOUT:
+                return "TIMEOUT";
             case Test::Status::NONE:
             default:
-                os << "NOT RUN YET";
-                break;
+                return "NOT RUN YET";
+            }
+        }
+#else
+        const char* status_name(Test::Status status);
+#endif
+
+        // Statuses a run stops on, and that are run again first, see ExecutionPolicy
+#if H2OFT_DEFINE_FUNCTIONS_
+        H2OFT_INLINE bool is_failure(Test::Status status) {
+            switch (status) {
+            case Test::Status::FAILED:
+            case Test::Status::ERROR:
+            case Test::Status::SLOW:
+            case Test::Status::TIMEOUT:
+                return true;
+            default:
+                return false;
             }
-            return os;
+        }
+#else
+        bool is_failure(Test::Status status);
+#endif
+
+        inline std::ostream& operator<<(std::ostream& os, Test::Status status) {
+            return os << status_name(status);
         }
 
-        std::string to_string(Test::Status status) {
-            std::ostringstream os;
-            os << status;
-            return os.str();
+        inline std::string to_string(Test::Status status) {
+            return status_name(status);
         }
 
         // This class wrap a test and make it so it's skipped (never run)
@@ -595,264 +1626,4952 @@ namespace H2OFastTests {
 
         protected:
 
-            // Put state to skipped and don't run the test
-            virtual void run_private() override { status_ = Test::Status::SKIPPED; }
-        };
+            // Put state to skipped and don't run the test
+            virtual void run_private() override { status_ = Test::Status::SKIPPED; }
+        };
+
+        // How a benchmark is measured
+        struct BenchmarkOptions {
+            size_t samples = 30;
+            Duration warmup_time{ 10 };       // the body is run for this long before being measured
+            Duration min_sample_time{ 1 };    // the iterations per sample are calibrated to last this long
+            uint64_t max_iterations = 1 << 30;
+        };
+
+        // A test whose body is one iteration of a benchmark
+        // Setup and teardown are run once, around the whole measure
+        // Benchmarks are serial tests so that they do not compete with other tests for the CPU
+        class BenchmarkTest : public Test {
+        public:
+
+            BenchmarkTest(const std::string& label, TestFunctor&& func)
+                : BenchmarkTest{ label, BenchmarkOptions{}, std::move(func) } {}
+            BenchmarkTest(const std::string& label, const BenchmarkOptions& options, TestFunctor&& func)
+                : Test{ label, std::move(func) }, options_(options), measured_(false)
+            {
+                serial_ = true;
+            }
+
+        protected:
+
+            using Clock = TestClock;
+
+            virtual void run_private() override {
+                measured_ = false;
+                run_guarded([this]() {
+                    warmup();
+                    const auto iterations = calibrate();
+                    std::vector<double> samples;
+                    samples.reserve(options_.samples);
+                    PerfStats counters;
+                    {
+#if H2OFT_HAS_PERF_EVENTS_
+                        PerfMeasure perf{ counters };
+#endif
+                        for (size_t i = 0; i < options_.samples; ++i) {
+                            samples.push_back(time_iterations(iterations).count() / iterations);
+                        }
+                    }
+                    stats_ = BenchmarkStats::from_samples(std::move(samples), iterations);
+                    stats_.counters = counters;
+                    measured_ = true;
+                });
+            }
+
+            virtual const BenchmarkStats* getBenchmarkStats_private() const override { return measured_ ? &stats_ : nullptr; }
+            virtual void setBenchmarkStats_private(const BenchmarkStats& stats) override {
+                stats_ = stats;
+                measured_ = true;
+            }
+
+        private:
+
+            void warmup() {
+                const auto end = Clock::now() + std::chrono::duration_cast<Clock::duration>(options_.warmup_time);
+                do {
+                    test_holder_();
+                } while (Clock::now() < end);
+            }
+
+            // Number of iterations for a sample to last at least min_sample_time
+            uint64_t calibrate() {
+                uint64_t iterations = 1;
+                for (;;) {
+                    const auto elapsed = time_iterations(iterations);
+                    if (elapsed >= options_.min_sample_time || iterations >= options_.max_iterations) {
+                        return iterations;
+                    }
+                    // Aim a bit over the target, without trusting too short measures too much
+                    const auto target = iterations * 1.2 * options_.min_sample_time.count() / std::max(elapsed.count(), 1e-9);
+                    iterations = std::min(std::min(iterations * 10, std::max(iterations * 2, static_cast<uint64_t>(target))), options_.max_iterations);
+                }
+            }
+
+            Duration time_iterations(uint64_t iterations) {
+                const auto start = Clock::now();
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    test_holder_();
+                }
+                return Clock::now() - start;
+            }
+
+            BenchmarkOptions options_;
+            BenchmarkStats stats_;
+            bool measured_;
+        };
+
+        // Cases of a parameterized test, produced at run time in chunks of consecutive cases
+        template<class Param>
+        class ParameterSource {
+        public:
+            // Called with the number of a case, from 0, and its parameter
+            using Visitor = std::function<void(size_t, const Param&)>;
+
+            virtual ~ParameterSource() {}
+
+            // Splits the cases in at most parts chunks, at least one, and returns their number
+            // Called before each run, the chunks are then visited concurrently
+            virtual size_t split(size_t parts) = 0;
+            virtual void visit(size_t chunk, const Visitor& visitor) const = 0;
+        };
+
+        template<class Param>
+        using ParameterRange = std::unique_ptr<ParameterSource<Param>>;
+
+        // Chunk bounds of count cases split in parts
+        inline size_t chunk_begin(size_t count, size_t chunk, size_t parts) {
+            return static_cast<size_t>(static_cast<unsigned long long>(count) * chunk / parts);
+        }
+
+        // Parameters computed from the number of their case
+        template<class Param>
+        class GeneratedSource : public ParameterSource<Param> {
+        public:
+            using Generator = std::function<Param(size_t)>;
+
+            GeneratedSource(size_t count, Generator&& generator)
+                : count_(count), generator_(std::move(generator)), chunks_(1) {}
+
+            virtual size_t split(size_t parts) override {
+                chunks_ = std::max<size_t>(1, std::min(parts, count_));
+                return chunks_;
+            }
+
+            virtual void visit(size_t chunk, const typename ParameterSource<Param>::Visitor& visitor) const override {
+                const auto end = chunk_begin(count_, chunk + 1, chunks_);
+                for (auto i = chunk_begin(count_, chunk, chunks_); i < end; ++i) {
+                    visitor(i, generator_(i));
+                }
+            }
+
+        private:
+            size_t count_;
+            Generator generator_;
+            size_t chunks_;
+        };
+
+        // Parameters visited in place
+        template<class Param>
+        class ValuesSource : public ParameterSource<Param> {
+        public:
+            ValuesSource(std::vector<Param>&& values)
+                : values_(std::move(values)), chunks_(1) {}
+
+            virtual size_t split(size_t parts) override {
+                chunks_ = std::max<size_t>(1, std::min(parts, values_.size()));
+                return chunks_;
+            }
+
+            virtual void visit(size_t chunk, const typename ParameterSource<Param>::Visitor& visitor) const override {
+                const auto end = chunk_begin(values_.size(), chunk + 1, chunks_);
+                for (auto i = chunk_begin(values_.size(), chunk, chunks_); i < end; ++i) {
+                    visitor(i, values_[i]);
+                }
+            }
+
+        private:
+            std::vector<Param> values_;
+            size_t chunks_;
+        };
+
+        // Read only view of a whole file, memory mapped where available and read at once elsewhere
+        class MappedFile {
+        public:
+            MappedFile() : data_(nullptr), size_(0), mapped_(false) {}
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            ~MappedFile() { close(); }
+
+            // Throws when the file cannot be read, what names it in the message
+            void open(const std::string& path, const char* what) {
+                close();
+#if H2OFT_HAS_MMAP_
+                const auto file = ::open(path.c_str(), O_RDONLY);
+                struct stat info;
+                if (file < 0 || ::fstat(file, &info) != 0) {
+                    if (file >= 0) {
+                        ::close(file);
+                    }
+                    throw std::runtime_error{ std::string{ "Cannot open the " } + what + " " + path };
+                }
+                size_ = static_cast<size_t>(info.st_size);
+                if (size_ > 0) {
+                    auto data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+                    if (data != MAP_FAILED) {
+                        ::madvise(data, size_, MADV_SEQUENTIAL);
+                        data_ = static_cast<const char*>(data);
+                        mapped_ = true;
+                    }
+                }
+                ::close(file);
+                if (mapped_ || size_ == 0) {
+                    return;
+                }
+#elif H2OFT_OS_WINDOWS_DESKTOP
+                const auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+                LARGE_INTEGER size;
+                if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size)) {
+                    if (file != INVALID_HANDLE_VALUE) {
+                        CloseHandle(file);
+                    }
+                    throw std::runtime_error{ std::string{ "Cannot open the " } + what + " " + path };
+                }
+                size_ = static_cast<size_t>(size.QuadPart);
+                if (size_ > 0) {
+                    const auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                    if (mapping != nullptr) {
+                        data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                        mapped_ = data_ != nullptr;
+                        CloseHandle(mapping); // the view keeps the mapping alive
+                    }
+                }
+                CloseHandle(file);
+                if (mapped_ || size_ == 0) {
+                    return;
+                }
+#endif
+                // No mapping here: read the whole file
+                std::ifstream stream{ path, std::ios::binary };
+                if (!stream) {
+                    throw std::runtime_error{ std::string{ "Cannot open the " } + what + " " + path };
+                }
+                buffer_.assign(std::istreambuf_iterator<char>{ stream }, std::istreambuf_iterator<char>{});
+                data_ = buffer_.data();
+                size_ = buffer_.size();
+            }
+
+            void close() {
+                if (mapped_) {
+#if H2OFT_HAS_MMAP_
+                    ::munmap(const_cast<char*>(data_), size_);
+#elif H2OFT_OS_WINDOWS_DESKTOP
+                    UnmapViewOfFile(data_);
+#endif
+                }
+                mapped_ = false;
+                data_ = nullptr;
+                size_ = 0;
+                buffer_.clear();
+            }
+
+            const char* data() const { return data_; }
+            size_t size() const { return size_; }
+
+        private:
+
+            const char* data_;
+            size_t size_;
+            bool mapped_;
+            std::string buffer_;
+        };
+
+        // File written at any offset through a shared mapping grown by doubling, where available,
+        // and with stdio elsewhere. Once closed, the file is cut down to the bytes written.
+        class AppendFile {
+        public:
+            // Throws when the file cannot be created, what names it in the message
+            AppendFile(const std::string& path, const char* what)
+                : path_(path), what_(what), size_(0) {
+#if H2OFT_HAS_MMAP_
+                data_ = nullptr;
+                capacity_ = 0;
+                file_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+                if (file_ < 0) {
+                    fail();
+                }
+                try {
+                    reserve(64 * 1024);
+                }
+                catch (...) {
+                    ::close(file_);
+                    throw;
+                }
+#else
+                file_ = std::fopen(path.c_str(), "wb+");
+                if (file_ == nullptr) {
+                    fail();
+                }
+#endif
+            }
+
+            AppendFile(const AppendFile&) = delete;
+            AppendFile& operator=(const AppendFile&) = delete;
+
+            ~AppendFile() {
+#if H2OFT_HAS_MMAP_
+                ::munmap(data_, capacity_);
+                // On failure the zeroed tail is left, readers go by the header of the file anyway
+                const auto trimmed = ::ftruncate(file_, static_cast<off_t>(size_));
+                static_cast<void>(trimmed);
+                ::close(file_);
+#else
+                std::fclose(file_);
+#endif
+            }
+
+            void write(uint64_t offset, const void* bytes, size_t count) {
+#if H2OFT_HAS_MMAP_
+                if (offset + count > capacity_) {
+                    auto capacity = capacity_;
+                    while (offset + count > capacity) {
+                        capacity *= 2;
+                    }
+                    reserve(capacity);
+                }
+                std::memcpy(data_ + offset, bytes, count);
+#else
+                if (std::fseek(file_, static_cast<long>(offset), SEEK_SET) != 0 || std::fwrite(bytes, 1, count, file_) != count) {
+                    fail();
+                }
+#endif
+                size_ = std::max<uint64_t>(size_, offset + count);
+            }
+
+            // Pushes what was written to the file, a mapping is synced by the system anyway
+            void flush() {
+#if !H2OFT_HAS_MMAP_
+                std::fflush(file_);
+#endif
+            }
+
+            uint64_t size() const { return size_; }
+
+        private:
+
+            [[noreturn]] void fail() const {
+                throw std::runtime_error{ "Unable to write the " + what_ + " " + path_ };
+            }
+
+#if H2OFT_HAS_MMAP_
+            void reserve(uint64_t capacity) {
+                if (data_ != nullptr) {
+                    ::munmap(data_, capacity_);
+                    data_ = nullptr;
+                }
+                if (::ftruncate(file_, static_cast<off_t>(capacity)) != 0) {
+                    fail();
+                }
+                auto data = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, file_, 0);
+                if (data == MAP_FAILED) {
+                    fail();
+                }
+                data_ = static_cast<char*>(data);
+                capacity_ = capacity;
+            }
+
+            int file_;
+            char* data_;
+            uint64_t capacity_;
+#else
+            std::FILE* file_;
+#endif
+            const std::string path_;
+            const std::string what_;
+            uint64_t size_;
+        };
+
+        // Lines of a text file, without their end of line, mapped in memory when the test runs.
+        // Chunks start on the first line after an even split of the bytes, only the number of
+        // the first line of each chunk is kept.
+        class FileLines : public ParameterSource<std::string_view> {
+        public:
+            FileLines(const std::string& path)
+                : path_(path), data_(nullptr), size_(0) {}
+
+            FileLines(const FileLines&) = delete;
+            FileLines& operator=(const FileLines&) = delete;
+
+            virtual size_t split(size_t parts) override {
+                map();
+                bounds_.assign(1, 0);
+                first_lines_.assign(1, 0);
+                for (size_t part = 1; part < parts; ++part) {
+                    const auto offset = std::max(chunk_begin(size_, part, parts), bounds_.back() + 1);
+                    if (offset >= size_) {
+                        break;
+                    }
+                    auto newline = static_cast<const char*>(std::memchr(data_ + offset - 1, '\n', size_ - offset + 1));
+                    if (newline == nullptr || newline + 1 == data_ + size_) {
+                        break;
+                    }
+                    const auto begin = static_cast<size_t>(newline + 1 - data_);
+                    first_lines_.push_back(first_lines_.back() + std::count(data_ + bounds_.back(), data_ + begin, '\n'));
+                    bounds_.push_back(begin);
+                }
+                bounds_.push_back(size_);
+                return first_lines_.size();
+            }
+
+            virtual void visit(size_t chunk, const Visitor& visitor) const override {
+                auto line = first_lines_[chunk];
+                const auto end = data_ + bounds_[chunk + 1];
+                for (auto begin = data_ + bounds_[chunk]; begin < end; ++line) {
+                    auto newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+                    auto next = newline ? newline + 1 : end;
+                    auto last = newline ? newline : end;
+                    if (last > begin && last[-1] == '\r') {
+                        --last;
+                    }
+                    visitor(line, std::string_view{ begin, static_cast<size_t>(last - begin) });
+                    begin = next;
+                }
+            }
+
+        private:
+
+            void map() {
+                file_.open(path_, "parameter file");
+                data_ = file_.data();
+                size_ = file_.size();
+            }
+
+            std::string path_;
+            MappedFile file_;
+            const char* data_;
+            size_t size_;
+            std::vector<size_t> bounds_;      // first byte of each chunk, then the size
+            std::vector<size_t> first_lines_; // number of the first line of each chunk
+        };
+
+        // Integers from first to last excluded, by step
+        template<class T>
+        ParameterRange<T> range(T first, T last, T step = 1) {
+            static_assert(std::is_integral<T>::value, "range needs integers, see generate for other parameters");
+            if (step <= 0) {
+                throw std::invalid_argument{ "The step of a range must be positive" };
+            }
+            const auto count = first < last ? static_cast<size_t>((last - first + step - 1) / step) : 0;
+            return std::make_unique<GeneratedSource<T>>(count, [first, step](size_t i) { return static_cast<T>(first + static_cast<T>(i) * step); });
+        }
+
+        // Parameters built on demand from the number of their case
+        template<class Generator>
+        auto generate(size_t count, Generator&& generator) -> ParameterRange<typename std::decay<decltype(generator(size_t{}))>::type> {
+            using Param = typename std::decay<decltype(generator(size_t{}))>::type;
+            return std::make_unique<GeneratedSource<Param>>(count, std::forward<Generator>(generator));
+        }
+
+        template<class T>
+        ParameterRange<T> values(std::vector<T> items) {
+            return std::make_unique<ValuesSource<T>>(std::move(items));
+        }
+
+        template<class T>
+        ParameterRange<T> values(std::initializer_list<T> items) {
+            return values(std::vector<T>{ items });
+        }
+
+        inline ParameterRange<std::string_view> lines_of(const std::string& path) {
+            return std::make_unique<FileLines>(path);
+        }
+
+        template<class Param>
+        void print_parameter(std::ostream& os, const Param& param, std::true_type) {
+            std::ostringstream value;
+            value << param;
+            auto text = value.str();
+            if (text.size() > 64) {
+                text.resize(61);
+                text += "...";
+            }
+            os << ": " << text;
+        }
+
+        template<class Param>
+        void print_parameter(std::ostream&, const Param&, std::false_type) {}
+
+        // Label of a case of a parameterized test, followed by the parameter when it can be printed
+        template<class Param>
+        std::string case_label(const std::string& label, size_t number, const Param& param) {
+            std::ostringstream oss;
+            oss << label << " [case " << number;
+            print_parameter(oss, param, std::integral_constant<bool, is_streamable<std::ostream, Param>::value>{});
+            oss << ']';
+            return oss.str();
+        }
+
+        // A single test running its body on every case of a range, expanded at run time, so that
+        // registering it costs the same for any number of cases. The parallel runner spreads its
+        // chunks of cases over its workers, running the set up and tear down around each chunk.
+        // Every case runs: the test takes the state of the first case that did not pass, the
+        // label of which is only built then, and reports how many did not.
+        template<class Param>
+        class ParameterizedTest : public Test {
+        public:
+            using CaseFunctor = std::function<void(const Param&)>;
+            using LabelFunctor = std::function<std::string(size_t, const Param&)>;
+
+            ParameterizedTest(const std::string& label, ParameterRange<Param>&& range, CaseFunctor&& func, LabelFunctor&& labeller = {})
+                : Test{ label }, source_(std::move(range)), func_(std::move(func)), labeller_(std::move(labeller))
+            {}
+
+        protected:
+
+            virtual void run_private() override {
+                run_guarded([this]() {
+                    const auto chunks = split_cases(1);
+                    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                        run_chunk_private(chunk);
+                    }
+                });
+                if (status_ == Status::PASSED) {
+                    const auto time = exec_time_ms_;
+                    const auto setup_time = setup_time_ms_;
+                    merge_chunks_private();
+                    exec_time_ms_ = time;
+                    setup_time_ms_ = setup_time;
+                }
+            }
+
+            // Unsplit when the cases cannot be read: running the test reports why
+            virtual size_t split_private(size_t parts) override {
+                try {
+                    return split_cases(parts);
+                }
+                catch (...) {
+                    return 1;
+                }
+            }
+
+            virtual void run_chunk_private(size_t chunk) override {
+                auto& result = chunks_[chunk];
+                result = ChunkResult{};
+                const auto start = TestClock::now();
+                try {
+                    source_->visit(chunk, [this, &result](size_t number, const Param& param) {
+                        ++result.cases;
+                        ExpectationScope expectations;
+                        try {
+                            func_(param);
+                            if (expectations.failures() > 0) {
+                                fail(result, Status::FAILED, number, param, expectations.first());
+                            }
+                        }
+                        catch (const GenericTestFailure& failure) {
+                            fail(result, Status::FAILED, number, param, expectations.failures() > 0 ? expectations.first() : failure.what());
+                        }
+                        catch (const std::exception& e) {
+                            fail(result, Status::ERROR, number, param, e.what());
+                        }
+                        catch (...) {
+                            fail(result, Status::ERROR, number, param, "Unkown error");
+                        }
+                    });
+                }
+                catch (const std::exception& e) {
+                    result.status = Status::ERROR;
+                    result.reason = e.what();
+                    ++result.failures;
+                }
+                result.time = TestClock::now() - start;
+            }
+
+            virtual void set_chunk_phases_private(size_t chunk, Duration setup, Duration teardown) override {
+                chunks_[chunk].setup_time = setup;
+                chunks_[chunk].teardown_time = teardown;
+            }
+
+            // Chunks hold consecutive cases in order: the first of them that did not pass holds the first case
+            virtual void merge_chunks_private() override {
+                status_ = Status::PASSED;
+                exec_time_ms_ = Duration{ 0 };
+                setup_time_ms_ = Duration{ 0 };
+                teardown_time_ms_ = Duration{ 0 };
+                size_t cases = 0;
+                size_t failures = 0;
+                const ChunkResult* first = nullptr;
+                for (const auto& result : chunks_) {
+                    exec_time_ms_ += result.time;
+                    setup_time_ms_ += result.setup_time;
+                    teardown_time_ms_ += result.teardown_time;
+                    cases += result.cases;
+                    failures += result.failures;
+                    if (first == nullptr && result.failures > 0) {
+                        first = &result;
+                    }
+                }
+                if (first) {
+                    status_ = first->status;
+                    const auto reason = first->reason + "\t(" + std::to_string(failures) + " of " + std::to_string(cases) + " cases did not pass)";
+                    (status_ == Status::FAILED ? failure_reason_ : error_) = reason;
+                    if (status_ == Status::FAILED) {
+                        // A single failure, reported with the first failing case
+                        failures_.assign(1, reason);
+                        failure_count_ = 1;
+                    }
+                }
+            }
+
+        private:
+
+            struct ChunkResult {
+                Duration time{ 0 };
+                Duration setup_time{ 0 }; // when run by the parallel runner
+                Duration teardown_time{ 0 };
+                size_t cases = 0;
+                size_t failures = 0;
+                Status status = Status::PASSED; // of the first case that did not pass
+                std::string reason;
+            };
+
+            size_t split_cases(size_t parts) {
+                failure_reason_.clear();
+                failures_.clear();
+                failure_count_ = 0;
+                error_.clear();
+                chunks_.assign(source_->split(parts), ChunkResult{});
+                return chunks_.size();
+            }
+
+            void fail(ChunkResult& result, Status status, size_t number, const Param& param, const char* what) const {
+                if (result.failures++ == 0) {
+                    result.status = status;
+                    result.reason = (labeller_ ? labeller_(number, param) : case_label(label_, number, param)) + ": " + what;
+                }
+            }
+
+            ParameterRange<Param> source_;
+            CaseFunctor func_;
+            LabelFunctor labeller_;
+            std::vector<ChunkResult> chunks_;
+        };
+
+        // Helper functions to build/skip a test case
+        inline std::unique_ptr<Test> make_test(TestFunctor&& func) { return std::make_unique<Test>(std::move(func)); }
+        inline std::unique_ptr<Test> make_test(const std::string& label, TestFunctor&& func) { return std::make_unique<Test>(label, std::move(func)); }
+        inline std::unique_ptr<Test> make_skipped_test(TestFunctor&& test) { return std::make_unique<SkippedTest>(std::move(test)); }
+        inline std::unique_ptr<Test> make_skipped_test(const std::string& label, TestFunctor&& func) { return std::make_unique<SkippedTest>(label, std::move(func)); }
+        inline std::unique_ptr<Test> make_skipped_test(const std::string& reason, const std::string& label, TestFunctor&& func) { return std::make_unique<SkippedTest>(reason, label, std::move(func)); }
+
+        // Name of a scenario as declared, from the name of its type: "struct X" with MSVC,
+        // "<length>X" with the Itanium ABI for a type declared outside of any namespace
+#if H2OFT_DEFINE_FUNCTIONS_
+        H2OFT_INLINE std::string scenario_name(const char* type_name) {
+            const std::string name{ type_name };
+            for (const std::string prefix : { "struct ", "class " }) {
+                if (name.compare(0, prefix.size(), prefix) == 0) {
+                    return name.substr(prefix.size());
+                }
+            }
+            const auto digits = name.find_first_not_of("0123456789");
+            if (digits > 0 && digits != std::string::npos && std::stoul(name.substr(0, digits)) == name.size() - digits) {
+                return name.substr(digits);
+            }
+            return name;
+        }
+#else
+        std::string scenario_name(const char* type_name);
+#endif
+
+#if H2OFT_HAS_COROUTINES_
+        // Return type of the coroutine tests, and of the coroutines they co_await, see AsyncTest.
+        // A task starts once awaited and resumes its awaiter when it returns, rethrowing to it
+        // what it threw.
+        class Task {
+        public:
+            struct promise_type;
+            using Handle = std::coroutine_handle<promise_type>;
+
+            struct FinalAwaiter {
+                bool await_ready() const noexcept { return false; }
+                std::coroutine_handle<> await_suspend(Handle handle) const noexcept {
+                    const auto continuation = handle.promise().continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+                void await_resume() const noexcept {}
+            };
+
+            struct promise_type {
+                std::coroutine_handle<> continuation;
+                std::exception_ptr exception;
+
+                Task get_return_object() { return Task{ Handle::from_promise(*this) }; }
+                std::suspend_always initial_suspend() const noexcept { return {}; }
+                FinalAwaiter final_suspend() const noexcept { return {}; }
+                void return_void() const noexcept {}
+                void unhandled_exception() { exception = std::current_exception(); }
+            };
+
+            Task() : handle_(nullptr) {}
+            Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+            Task& operator=(Task&& other) noexcept {
+                if (this != &other) {
+                    reset();
+                    handle_ = std::exchange(other.handle_, nullptr);
+                }
+                return *this;
+            }
+            Task(const Task&) = delete;
+            Task& operator=(const Task&) = delete;
+            ~Task() { reset(); }
+
+            bool done() const { return !handle_ || handle_.done(); }
+
+            bool await_ready() const noexcept { return done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) const noexcept {
+                handle_.promise().continuation = awaiting;
+                return handle_;
+            }
+            void await_resume() const {
+                if (handle_ && handle_.promise().exception) {
+                    std::rethrow_exception(handle_.promise().exception);
+                }
+            }
+
+        private:
+            explicit Task(Handle handle) : handle_(handle) {}
+
+            void reset() {
+                if (handle_) {
+                    handle_.destroy(); // with the frames of the tasks it awaits
+                    handle_ = nullptr;
+                }
+            }
+
+            Handle handle_;
+
+            friend class AsyncTest;
+        };
+
+        // Test whose body is a coroutine returning a Task. The asynchronous fixtures of its scenario
+        // run after its set up and before its tear down, see RegistryManager::set_up_async.
+        // The coroutine tests of a run interleave on an event loop of the calling thread once the
+        // other tests are done, see EventLoop: a test runs until it suspends, and its timeout is
+        // enforced by destroying it while it is suspended. Run alone, in a worker process for
+        // instance, a test gets a loop of its own. Their allocations are not counted.
+        class AsyncTest : public Test {
+        public:
+            using Body = std::function<Task()>;
+
+            AsyncTest(const std::string& label, Body&& body, const Body* async_setup = nullptr, const Body* async_teardown = nullptr)
+                : Test(label), body_(std::move(body)), async_setup_(async_setup), async_teardown_(async_teardown), expectation_failures_(0), stopped_(false)
+            {}
+
+        protected:
+
+            virtual void run_private() override;
+            virtual bool is_async_private() const override { return true; }
+            virtual void run_coroutines_private(const std::vector<ScheduledTest>& tasks, const RunControl& control, size_t at_once) override;
+
+        private:
+
+            // Prepares a run, which starts on the first resume; setup and teardown may be null
+            void begin(const SetUpFunctor* setup, const TearDownFunctor* teardown) {
+                root_ = drive(setup, teardown);
+            }
+
+            std::coroutine_handle<> root() const { return root_.handle_; }
+            bool done() const { return root_.done(); }
+
+            // Runs a slice of the test, until it suspends or returns, collecting its expectations
+            void resume(std::coroutine_handle<> handle) {
+                {
+                    ExpectationScope expectations;
+                    handle.resume();
+                    for (auto& record : expectations.records()) {
+                        if (failures_.size() < FailureBuffer::capacity) {
+                            failures_.push_back(std::move(record));
+                        }
+                    }
+                    expectation_failures_ += expectations.failures();
+                }
+                if (done() && !fixture_error_) {
+                    if (stopped_) {
+                        failures_.push_back(stop_reason_);
+                    }
+                    set_failure_reason(expectation_failures_ + (stopped_ ? 1 : 0));
+                }
+            }
+
+            // Destroys the suspended test, leaving it for the loop to set its status
+            void abort() {
+                root_ = Task{};
+                exec_time_ms_ = TestClock::now() - body_start_;
+            }
+
+            Task drive(const SetUpFunctor* setup, const TearDownFunctor* teardown) {
+                failures_.clear();
+                failure_reason_.clear();
+                error_.clear();
+                expectation_failures_ = 0;
+                stopped_ = false;
+                fixture_error_ = nullptr;
+                auto start = TestClock::now();
+                body_start_ = start;
+                try {
+                    if (setup) {
+                        (*setup)();
+                    }
+                    if (async_setup_ && *async_setup_) {
+                        co_await (*async_setup_)();
+                    }
+                }
+                catch (...) {
+                    fixture_error_ = std::current_exception();
+                }
+                setup_time_ms_ = TestClock::now() - start;
+                if (fixture_error_) {
+                    co_return;
+                }
+
+                start = TestClock::now();
+                body_start_ = start;
+                try {
+                    co_await body_();
+                    status_ = Status::PASSED;
+                }
+                catch (const GenericTestFailure& failure) {
+                    status_ = Status::FAILED;
+                    stop_reason_ = failure.what();
+                    stopped_ = true;
+                }
+                catch (const std::exception& e) {
+                    status_ = Status::ERROR;
+                    error_ = e.what();
+                }
+                catch (...) {
+                    status_ = Status::ERROR;
+                    error_ = "Unkown error";
+                }
+                exec_time_ms_ = TestClock::now() - start;
+
+                start = TestClock::now();
+                try {
+                    if (async_teardown_ && *async_teardown_) {
+                        co_await (*async_teardown_)();
+                    }
+                    if (teardown) {
+                        (*teardown)();
+                    }
+                }
+                catch (...) {
+                    fixture_error_ = std::current_exception();
+                }
+                teardown_time_ms_ = TestClock::now() - start;
+            }
+
+            Body body_;
+            const Body* async_setup_;
+            const Body* async_teardown_;
+            Task root_;
+            TestClock::time_point body_start_;
+            size_t expectation_failures_;
+            bool stopped_;                 // by a failed assert
+            std::string stop_reason_;
+            std::exception_ptr fixture_error_; // rethrown by the scheduler, as the synchronous fixtures do
+
+            friend class EventLoop;
+        };
+
+        // Awaited by each coroutine test of a scenario, see RegistryManager::set_up_async
+        struct AsyncFixtures {
+            AsyncTest::Body setup;
+            AsyncTest::Body teardown;
+        };
+
+        // Single threaded event loop running coroutine tests: a test runs until it suspends on a
+        // timer or a file descriptor, and is resumed once it fires, so that hundreds of tests
+        // waiting on I/O interleave on one thread. The loop is current on its thread while it
+        // exists, see Async::sleep_for, Async::readable and Async::writable.
+        class EventLoop {
+        public:
+            using Clock = std::chrono::steady_clock;
+            // Called on each test once it finished, may start others
+            using Finished = std::function<void(AsyncTest&)>;
+
+            EventLoop() : previous_(current_loop()), running_(nullptr) {
+                current_loop() = this;
+            }
+
+            ~EventLoop() {
+                current_loop() = previous_;
+            }
+
+            EventLoop(const EventLoop&) = delete;
+            EventLoop& operator=(const EventLoop&) = delete;
+
+            // Throws when no event loop runs on this thread
+            static EventLoop& current() {
+                if (current_loop() == nullptr) {
+                    throw std::logic_error{ "Awaited outside of a coroutine test" };
+                }
+                return *current_loop();
+            }
+
+            // The test starts on the next call to run, setup and teardown are called around it and may be null
+            void start(AsyncTest& test, const SetUpFunctor* setup, const TearDownFunctor* teardown, Duration timeout) {
+                test.begin(setup, teardown);
+                const auto deadline = timeout.count() > 0 ? Clock::now() + std::chrono::duration_cast<Clock::duration>(timeout) : Clock::time_point::max();
+                tests_.push_back({ &test, deadline, timeout });
+                ready_.push_back({ test.root(), &test });
+            }
+
+            size_t running() const { return tests_.size(); }
+
+            // Runs until every started test finished
+            void run(const Finished& finished) {
+                while (!tests_.empty()) {
+                    const auto now = Clock::now();
+                    while (!timers_.empty() && timers_.begin()->first <= now) {
+                        ready_.push_back(timers_.begin()->second);
+                        timers_.erase(timers_.begin());
+                    }
+                    for (size_t i = 0; i < tests_.size();) {
+                        if (tests_[i].deadline > now) {
+                            ++i;
+                            continue;
+                        }
+                        auto& test = *tests_[i].test;
+                        forget(test);
+                        test.abort();
+                        test.set_timed_out(tests_[i].timeout, ", destroyed while suspended");
+                        end(test, finished);
+                    }
+                    while (!ready_.empty()) {
+                        const auto next = ready_.front();
+                        ready_.pop_front();
+                        running_ = next.test;
+                        next.test->resume(next.handle);
+                        running_ = nullptr;
+                        if (next.test->done()) {
+                            end(*next.test, finished);
+                        }
+                    }
+                    if (!tests_.empty()) {
+                        wait(finished);
+                    }
+                }
+            }
+
+            // Called by the awaitables, the coroutine is resumed on the loop
+            void resume_at(Clock::time_point when, std::coroutine_handle<> handle) {
+                timers_.emplace(when, Resumption{ handle, running_ });
+            }
+
+#if H2OFT_HAS_POLL_
+            void resume_on(int fd, short events, std::coroutine_handle<> handle) {
+                watches_.push_back({ fd, events, { handle, running_ } });
+            }
+#endif
+
+        private:
+
+            struct Resumption {
+                std::coroutine_handle<> handle;
+                AsyncTest* test;
+            };
+
+            struct Running {
+                AsyncTest* test;
+                Clock::time_point deadline; // max without a timeout
+                Duration timeout;
+            };
+
+            struct Watch {
+                int fd;
+                short events;
+                Resumption resumption;
+            };
+
+            static EventLoop*& current_loop() {
+                thread_local EventLoop* loop = nullptr;
+                return loop;
+            }
+
+            void end(AsyncTest& test, const Finished& finished) {
+                tests_.erase(std::find_if(tests_.begin(), tests_.end(), [&test](const Running& running) { return running.test == &test; }));
+                finished(test);
+            }
+
+            // Drops what would resume a test
+            void forget(const AsyncTest& test) {
+                const auto owned = [&test](const Resumption& resumption) { return resumption.test == &test; };
+                ready_.erase(std::remove_if(ready_.begin(), ready_.end(), owned), ready_.end());
+                for (auto it = timers_.begin(); it != timers_.end();) {
+                    it = owned(it->second) ? timers_.erase(it) : std::next(it);
+                }
+                watches_.erase(std::remove_if(watches_.begin(), watches_.end(), [&owned](const Watch& watch) { return owned(watch.resumption); }), watches_.end());
+            }
+
+            // Waits for the next timer, deadline or file descriptor
+            void wait(const Finished& finished) {
+                auto until = timers_.empty() ? Clock::time_point::max() : timers_.begin()->first;
+                for (const auto& running : tests_) {
+                    until = std::min(until, running.deadline);
+                }
+                if (until == Clock::time_point::max() && watches_.empty()) {
+                    // Nothing left to resume the suspended tests
+                    while (!tests_.empty()) {
+                        auto& test = *tests_.front().test;
+                        test.abort();
+                        test.status_ = Test::Status::ERROR;
+                        test.error_ = "Suspended with nothing left to resume it";
+                        end(test, finished);
+                    }
+                    return;
+                }
+#if H2OFT_HAS_POLL_
+                int timeout = -1;
+                if (until != Clock::time_point::max()) {
+                    const auto left = std::chrono::ceil<std::chrono::milliseconds>(until - Clock::now()).count();
+                    timeout = static_cast<int>(std::min<decltype(left)>(std::max<decltype(left)>(left, 0), std::numeric_limits<int>::max()));
+                }
+                std::vector<pollfd> fds;
+                fds.reserve(watches_.size());
+                for (const auto& watch : watches_) {
+                    fds.push_back({ watch.fd, watch.events, 0 });
+                }
+                if (::poll(fds.data(), static_cast<nfds_t>(fds.size()), timeout) <= 0) {
+                    return;
+                }
+                size_t kept = 0;
+                for (size_t i = 0; i < watches_.size(); ++i) {
+                    if (fds[i].revents != 0) {
+                        ready_.push_back(watches_[i].resumption);
+                    }
+                    else {
+                        watches_[kept++] = watches_[i];
+                    }
+                }
+                watches_.resize(kept);
+#else
+                std::this_thread::sleep_until(until);
+#endif
+            }
+
+            EventLoop* previous_;
+            AsyncTest* running_; // whose coroutine is being resumed
+            std::deque<Resumption> ready_;
+            std::multimap<Clock::time_point, Resumption> timers_;
+            std::vector<Watch> watches_;
+            std::vector<Running> tests_;
+        };
+
+        // Inline in every translation unit, like the rest of AsyncTest: the library may be built
+        // without coroutines, see H2OFT_SEPARATE_COMPILATION
+        inline void AsyncTest::run_private() {
+            EventLoop loop;
+            loop.start(*this, nullptr, nullptr, Duration{ 0 });
+            loop.run([](AsyncTest&) {});
+            if (fixture_error_) {
+                std::rethrow_exception(fixture_error_);
+            }
+        }
+
+        // Awaitables of the coroutine tests, resumed by the event loop of their thread
+        struct SleepAwaiter {
+            Duration duration;
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) const {
+                EventLoop::current().resume_at(EventLoop::Clock::now() + std::chrono::duration_cast<EventLoop::Clock::duration>(duration), handle);
+            }
+            void await_resume() const noexcept {}
+        };
+
+        // Resumes the test once duration elapsed, the other tests run meanwhile
+        inline SleepAwaiter sleep_for(Duration duration) { return { duration }; }
+        // Lets the other tests that are ready run first
+        inline SleepAwaiter yield() { return { Duration{ 0 } }; }
+
+#if H2OFT_HAS_POLL_
+        struct PollAwaiter {
+            int fd;
+            short events;
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) const { EventLoop::current().resume_on(fd, events, handle); }
+            void await_resume() const noexcept {}
+        };
+
+        // Resume the test once fd can be read, or written, without blocking
+        inline PollAwaiter readable(int fd) { return { fd, POLLIN }; }
+        inline PollAwaiter writable(int fd) { return { fd, POLLOUT }; }
+#endif
+#endif
+
+        // Glob pattern compiled once: '*' matches any run of characters, '?' any single one.
+        // The pattern is split on its stars: the first and the last pieces are anchored, the
+        // others are searched for from left to right, which never needs backtracking.
+        class GlobPattern {
+        public:
+            GlobPattern(const std::string& pattern)
+                : any_char_(pattern.find('?') != std::string::npos)
+            {
+                size_t begin = 0;
+                for (;;) {
+                    const auto star = pattern.find('*', begin);
+                    pieces_.push_back(pattern.substr(begin, star == std::string::npos ? star : star - begin));
+                    if (star == std::string::npos) {
+                        break;
+                    }
+                    begin = star + 1;
+                }
+            }
+
+            bool matches(std::string_view text) const {
+                const auto& first = pieces_.front();
+                if (pieces_.size() == 1) {
+                    return text.size() == first.size() && equal_at(first, text, 0);
+                }
+                const auto& last = pieces_.back();
+                if (text.size() < first.size() + last.size() || !equal_at(first, text, 0) || !equal_at(last, text, text.size() - last.size())) {
+                    return false;
+                }
+                const auto end = text.size() - last.size();
+                auto position = first.size();
+                for (size_t i = 1; i + 1 < pieces_.size(); ++i) {
+                    position = find(pieces_[i], text, position, end);
+                    if (position == std::string::npos) {
+                        return false;
+                    }
+                    position += pieces_[i].size();
+                }
+                return true;
+            }
+
+        private:
+            bool equal_at(const std::string& piece, std::string_view text, size_t offset) const {
+                if (!any_char_) {
+                    return text.compare(offset, piece.size(), piece) == 0;
+                }
+                for (size_t i = 0; i < piece.size(); ++i) {
+                    if (piece[i] != '?' && piece[i] != text[offset + i]) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // First position of piece in text[from, end), npos if none
+            size_t find(const std::string& piece, std::string_view text, size_t from, size_t end) const {
+                if (!any_char_) {
+                    return text.substr(0, end).find(piece, from);
+                }
+                for (auto position = from; position + piece.size() <= end; ++position) {
+                    if (equal_at(piece, text, position)) {
+                        return position;
+                    }
+                }
+                return std::string::npos;
+            }
+
+            std::vector<std::string> pieces_;
+            bool any_char_;
+        };
+
+        // Selects tests by glob patterns matched against their label, the name of their
+        // scenario and "<scenario>/<label>". A pattern in brackets, like [fast] or [db*],
+        // matches the tags of the test instead: the bracketed words of its label, as in
+        // "Dates are parsed [fast][io]".
+        // A test is selected when it matches one of the included patterns, if there are any,
+        // and none of the excluded ones. Patterns are compiled when they are added.
+        class TestFilter {
+        public:
+
+            // Comma separated patterns
+            void include(const std::string& patterns) { add(patterns, included_); }
+            void exclude(const std::string& patterns) { add(patterns, excluded_); }
+
+            bool empty() const { return included_.empty() && excluded_.empty(); }
+
+            bool matches(std::string_view scenario, std::string_view label) const {
+                std::string qualified;
+                if (qualified_) {
+                    qualified.reserve(scenario.size() + 1 + label.size());
+                    qualified.append(scenario).append(1, '/').append(label);
+                }
+                return (included_.empty() || any_of(included_, scenario, label, qualified)) && !any_of(excluded_, scenario, label, qualified);
+            }
+
+        private:
+
+            struct Pattern {
+                GlobPattern glob;
+                bool tag;       // matched against the tags of the label
+                bool qualified; // contains a '/', matched against "<scenario>/<label>"
+            };
+
+            void add(const std::string& patterns, std::vector<Pattern>& list) {
+                size_t begin = 0;
+                while (begin <= patterns.size()) {
+                    auto end = patterns.find(',', begin);
+                    end = end == std::string::npos ? patterns.size() : end;
+                    auto pattern = patterns.substr(begin, end - begin);
+                    pattern.erase(0, pattern.find_first_not_of(' '));
+                    pattern.erase(pattern.find_last_not_of(' ') + 1);
+                    if (pattern.size() > 2 && pattern.front() == '[' && pattern.back() == ']') {
+                        list.push_back({ GlobPattern{ pattern.substr(1, pattern.size() - 2) }, true, false });
+                    }
+                    else if (!pattern.empty()) {
+                        const auto qualified = pattern.find('/') != std::string::npos;
+                        qualified_ = qualified_ || qualified;
+                        list.push_back({ GlobPattern{ pattern }, false, qualified });
+                    }
+                    begin = end + 1;
+                }
+            }
+
+            static bool any_of(const std::vector<Pattern>& list, std::string_view scenario, std::string_view label, std::string_view qualified) {
+                for (const auto& pattern : list) {
+                    if (pattern.tag) {
+                        for (auto open = label.find('['); open != std::string_view::npos; open = label.find('[', open + 1)) {
+                            const auto close = label.find(']', open);
+                            if (close == std::string_view::npos) {
+                                break;
+                            }
+                            if (pattern.glob.matches(label.substr(open + 1, close - open - 1))) {
+                                return true;
+                            }
+                        }
+                    }
+                    else if (pattern.qualified ? pattern.glob.matches(qualified) : pattern.glob.matches(label) || pattern.glob.matches(scenario)) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            std::vector<Pattern> included_;
+            std::vector<Pattern> excluded_;
+            bool qualified_ = false;
+        };
+
+        // Cooperative cancellation of the runs sharing it: once cancelled, no test is started
+        // anymore, the running ones are waited for (worker processes are killed instead) and
+        // the run returns, leaving the tests it did not run out of the results.
+        // Copies share their state, so a copy can cancel a run from any thread. The failures
+        // counted against ExecutionPolicy::max_failures are shared the same way, so a policy
+        // reused for several runs stops them all once the limit is reached.
+        class CancellationToken {
+        public:
+            CancellationToken() : state_(std::make_shared<State>()) {}
+
+            void cancel() const { state_->cancelled.store(true); }
+            bool isCancelled() const { return state_->cancelled.load(); }
+            size_t getFailureCount() const { return state_->failures.load(); }
+
+            // Makes the token usable for another run
+            void reset() const {
+                state_->cancelled.store(false);
+                state_->failures.store(0);
+            }
+
+        private:
+            friend class RunControl;
+
+            struct State {
+                std::atomic<bool> cancelled{ false };
+                std::atomic<size_t> failures{ 0 };
+            };
+
+            std::shared_ptr<State> state_;
+        };
+
+        // Describes how the tests of a registry are run
+        struct ExecutionPolicy {
+
+            enum class Mode {
+                SEQUENTIAL, // one test after the other on the calling thread
+                PARALLEL,   // tests are dispatched over a pool of worker threads
+                PROCESSES   // tests are dispatched over worker processes, see ProcessShards
+            };
+
+            // Uses the statuses of the last run, see status_file
+            enum class Order {
+                REGISTRATION, // in the order the tests were added
+                FAILED_FIRST, // the tests that did not pass last time first, then the others
+                ONLY_FAILED   // only the tests that did not pass last time, and the new ones
+            };
+
+            static ExecutionPolicy sequential() { return{}; }
+            // Stops the run at the first test that does not pass
+            static ExecutionPolicy fail_fast(ExecutionPolicy policy = sequential()) {
+                policy.max_failures = 1;
+                return policy;
+            }
+            // workers = 0 means one worker per hardware thread
+            static ExecutionPolicy parallel(size_t workers = 0) {
+                ExecutionPolicy policy;
+                policy.mode = Mode::PARALLEL;
+                policy.workers = workers == 0 ? std::max<size_t>(std::thread::hardware_concurrency(), 1) : workers;
+                return policy;
+            }
+            // shards = 0 means one worker process per hardware thread
+            static ExecutionPolicy processes(size_t shards = 0) {
+                auto policy = parallel(shards);
+                policy.mode = Mode::PROCESSES;
+                return policy;
+            }
+
+            Mode mode = Mode::SEQUENTIAL;
+            size_t workers = 1;
+            size_t shard_index = 0;  // partition run by this process, in [0, shard_count)
+            size_t shard_count = 1;  // number of partitions the tests are split into
+            std::string timing_file; // times of the previous runs, updated after the run
+            std::string baseline_file;   // reference times, see BaselineGate
+            double slow_ratio = 1.5;     // a test slower than its baseline by this ratio is SLOW...
+            Duration min_slowdown{ 1 };  // ...if it is also slower by this much, for plain tests
+            bool update_baseline = false; // replace the reference times by the ones of the run
+            Duration timeout{ 0 };       // for the tests without a timeout of their own or of their scenario, 0 for none
+            size_t max_failures = 0;     // cancel once this many tests FAILED, were SLOW, TIMEOUT or in ERROR, 0 for no limit
+            CancellationToken cancellation;
+            TestFilter filter;           // tests to run, all of them when empty
+            std::string status_file;     // statuses of the previous runs, updated after the run
+            Order order = Order::REGISTRATION;
+            size_t async_tests = 256;    // coroutine tests running at once on the event loop, see AsyncTest
+        };
+
+        // Value of an environment variable, empty if not set
+#if H2OFT_DEFINE_FUNCTIONS_
+        H2OFT_INLINE std::string get_environment(const char* name) {
+#if defined(_MSC_VER)
+            char* buffer = nullptr;
+            size_t size = 0;
+            if (_dupenv_s(&buffer, &size, name) != 0 || buffer == nullptr) {
+                return{};
+            }
+            std::string value{ buffer };
+            free(buffer);
+            return value;
+#else
+            const char* value = getenv(name);
+            return value != nullptr ? value : "";
+#endif
+        }
+#else
+        std::string get_environment(const char* name);
+#endif
+
+        // Reads the run options given on the command line, arguments not listed here are ignored,
+        // or added to unknown when given:
+        //     --jobs=N         run on N threads (0: one per hardware thread)
+        //     --processes=N    run in N isolated worker processes (0: one per hardware thread)
+        //     --shard-index=I  only run the I-th of the partitions (default: $H2OFT_SHARD_INDEX)
+        //     --shard-count=N  split the tests into N partitions (default: $H2OFT_SHARD_COUNT)
+        //     --timing-file=F  times of the previous runs, used to balance the partitions
+        //                      and to start the longest tests first
+        //     --baseline=F     reference times, tests too slow compared to them are SLOW
+        //     --slow-ratio=R   slowdown ratio over the baseline making a test SLOW (default: 1.5)
+        //     --min-slowdown=MS  smallest slowdown in ms making a plain test SLOW (default: 1)
+        //     --update-baseline  write the times of this run as the new reference
+        //     --timeout=MS     timeout of the tests that have none (default: none)
+        //     --fail-fast      stop at the first test that does not pass
+        //     --max-failures=N stop once N tests did not pass (default: 0, no limit)
+        //     --filter=P[,P]   only run the tests matching one of the patterns, see TestFilter
+        //     --exclude=P[,P]  do not run the tests matching one of the patterns
+        //     --status-file=F  statuses of the previous runs, updated after the run
+        //     --failed-first   start with the tests that did not pass in the previous run
+        //     --only-failed    only run those, and the tests new since the previous run
+        // Values can also be given as the next argument. Throws std::invalid_argument.
+#if H2OFT_DEFINE_FUNCTIONS_
+        H2OFT_INLINE ExecutionPolicy parse_command_line(int argc, const char* const* argv, ExecutionPolicy policy = ExecutionPolicy::sequential(),
+            std::vector<std::string>* unknown = nullptr) {
+            auto to_size = [](const std::string& option, const std::string& value) {
+                if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+                    throw std::invalid_argument{ "Invalid value for " + option + ": '" + value + "'" };
+                }
+                return static_cast<size_t>(std::stoull(value));
+            };
+            auto to_positive = [](const std::string& option, const std::string& value) {
+                size_t parsed = 0;
+                double number = -1;
+                try {
+                    number = std::stod(value, &parsed);
+                }
+                catch (const std::exception&) {}
+                if (parsed != value.size() || !(number >= 0)) {
+                    throw std::invalid_argument{ "Invalid value for " + option + ": '" + value + "'" };
+                }
+                return number;
+            };
+
+            auto shard_index = get_environment("H2OFT_SHARD_INDEX");
+            auto shard_count = get_environment("H2OFT_SHARD_COUNT");
+            for (int i = 1; i < argc; ++i) {
+                const auto arg = std::string{ argv[i] };
+                const auto equal = arg.find('=');
+                const auto option = arg.substr(0, equal);
+                auto value = [&]() {
+                    if (equal != std::string::npos) {
+                        return arg.substr(equal + 1);
+                    }
+                    if (i + 1 >= argc) {
+                        throw std::invalid_argument{ "Missing value for " + option };
+                    }
+                    return std::string{ argv[++i] };
+                };
+
+                if (option == "--jobs" || option == "--processes") {
+                    const auto workers = to_size(option, value());
+                    const auto mode = option == "--jobs" ? ExecutionPolicy::parallel(workers) : ExecutionPolicy::processes(workers);
+                    policy.mode = mode.mode;
+                    policy.workers = mode.workers;
+                }
+                else if (option == "--shard-index") {
+                    shard_index = value();
+                }
+                else if (option == "--shard-count") {
+                    shard_count = value();
+                }
+                else if (option == "--timing-file") {
+                    policy.timing_file = value();
+                }
+                else if (option == "--baseline") {
+                    policy.baseline_file = value();
+                }
+                else if (option == "--slow-ratio") {
+                    policy.slow_ratio = to_positive(option, value());
+                }
+                else if (option == "--min-slowdown") {
+                    policy.min_slowdown = Duration{ to_positive(option, value()) };
+                }
+                else if (arg == "--update-baseline") {
+                    policy.update_baseline = true;
+                }
+                else if (option == "--timeout") {
+                    policy.timeout = Duration{ to_positive(option, value()) };
+                }
+                else if (arg == "--fail-fast") {
+                    policy.max_failures = 1;
+                }
+                else if (option == "--max-failures") {
+                    policy.max_failures = to_size(option, value());
+                }
+                else if (option == "--filter") {
+                    policy.filter.include(value());
+                }
+                else if (option == "--exclude") {
+                    policy.filter.exclude(value());
+                }
+                else if (option == "--status-file") {
+                    policy.status_file = value();
+                }
+                else if (arg == "--failed-first") {
+                    policy.order = ExecutionPolicy::Order::FAILED_FIRST;
+                }
+                else if (arg == "--only-failed") {
+                    policy.order = ExecutionPolicy::Order::ONLY_FAILED;
+                }
+                else if (unknown) {
+                    unknown->push_back(arg);
+                }
+            }
+
+            if (!shard_count.empty()) {
+                policy.shard_count = to_size("--shard-count", shard_count);
+            }
+            if (!shard_index.empty()) {
+                policy.shard_index = to_size("--shard-index", shard_index);
+            }
+            if (policy.shard_count == 0 || policy.shard_index >= policy.shard_count) {
+                throw std::invalid_argument{ "Shard index " + std::to_string(policy.shard_index) +
+                    " is out of range for a shard count of " + std::to_string(policy.shard_count) };
+            }
+            return policy;
+        }
+#else
+        ExecutionPolicy parse_command_line(int argc, const char* const* argv, ExecutionPolicy policy = ExecutionPolicy::sequential(),
+            std::vector<std::string>* unknown = nullptr);
+#endif
+
+        // Escaping of the fields of the timing and status files
+#if H2OFT_DEFINE_FUNCTIONS_
+        H2OFT_INLINE std::string escape_field(const std::string& value) {
+            std::string escaped;
+            for (auto c : value) {
+                switch (c) {
+                case '\t': escaped += "\\t"; break;
+                case '\n': escaped += "\\n"; break;
+                case '\\': escaped += "\\\\"; break;
+                default: escaped += c; break;
+                }
+            }
+            return escaped;
+        }
+
+        H2OFT_INLINE std::string unescape_field(const std::string& value) {
+            std::string unescaped;
+            for (size_t i = 0; i < value.size(); ++i) {
+                if (value[i] == '\\' && i + 1 < value.size()) {
+                    switch (value[++i]) {
+                    case 't': unescaped += '\t'; break;
+                    case 'n': unescaped += '\n'; break;
+                    default: unescaped += value[i]; break;
+                    }
+                }
+                else {
+                    unescaped += value[i];
+                }
+            }
+            return unescaped;
+        }
+#else
+        std::string escape_field(const std::string& value);
+        std::string unescape_field(const std::string& value);
+#endif
+
+        // Execution times of the tests, keyed by scenario and label, persisted as text:
+        //     <ms>\t<scenario>\t<label>
+        // one line per test, where tabs, new lines and backslashes are escaped.
+        // When a test appears more than once, the last line wins.
+        class TimingStore {
+        public:
+
+            // A missing file is an empty store
+            void load(const std::string& path) {
+                std::ifstream file{ path };
+                std::string line;
+                while (std::getline(file, line)) {
+                    const auto first = line.find('\t');
+                    const auto second = first == std::string::npos ? first : line.find('\t', first + 1);
+                    if (second == std::string::npos) {
+                        continue;
+                    }
+                    try {
+                        times_[unescape_field(line.substr(first + 1, second - first - 1)) + '\t' + unescape_field(line.substr(second + 1))] =
+                            Duration{ std::stod(line.substr(0, first)) };
+                    }
+                    catch (const std::exception&) {} // Skip a corrupted line
+                }
+            }
+
+            void save(const std::string& path) const {
+                std::ofstream file{ path, std::ios::trunc };
+                for (const auto& time : times_) {
+                    const auto tab = time.first.find('\t');
+                    file << time.second.count() << '\t' << escape_field(time.first.substr(0, tab)) << '\t' << escape_field(time.first.substr(tab + 1)) << '\n';
+                }
+                if (!file) {
+                    throw std::runtime_error{ "Unable to write the timing file " + path };
+                }
+            }
+
+            bool find(const std::string& scenario, const std::string& label, Duration& time) const {
+                auto it = times_.find(scenario + '\t' + label);
+                if (it == times_.end()) {
+                    return false;
+                }
+                time = it->second;
+                return true;
+            }
+
+            void set(const std::string& scenario, const std::string& label, Duration time) { times_[scenario + '\t' + label] = time; }
+
+            bool empty() const { return times_.empty(); }
+
+        private:
+
+            std::map<std::string, Duration> times_;
+        };
+
+        // Last status and execution time of the tests, keyed by scenario and label, persisted as text:
+        //     <status>\t<ms>\t<scenario>\t<label>
+        // escaped like the timing file. When a test appears more than once, the last line wins.
+        class StatusCache {
+        public:
+
+            struct Entry {
+                Test::Status status;
+                Duration time;
+            };
+
+            // A missing file is an empty cache
+            void load(const std::string& path) {
+                std::ifstream file{ path };
+                std::string line;
+                while (std::getline(file, line)) {
+                    size_t tabs[3];
+                    auto position = std::string::npos;
+                    for (auto& tab : tabs) {
+                        position = line.find('\t', position + 1);
+                        tab = position;
+                        if (position == std::string::npos) {
+                            break;
+                        }
+                    }
+                    if (tabs[2] == std::string::npos) {
+                        continue;
+                    }
+                    Entry entry{ Test::Status::NONE, Duration{ 0 } };
+                    const auto status = line.substr(0, tabs[0]);
+                    for (auto candidate : { Test::Status::PASSED, Test::Status::FAILED, Test::Status::ERROR, Test::Status::SKIPPED, Test::Status::SLOW, Test::Status::TIMEOUT }) {
+                        if (status == status_name(candidate)) {
+                            entry.status = candidate;
+                        }
+                    }
+                    try {
+                        entry.time = Duration{ std::stod(line.substr(tabs[0] + 1, tabs[1] - tabs[0] - 1)) };
+                    }
+                    catch (const std::exception&) {
+                        continue; // Skip a corrupted line
+                    }
+                    if (entry.status != Test::Status::NONE) {
+                        entries_[unescape_field(line.substr(tabs[1] + 1, tabs[2] - tabs[1] - 1)) + '\t' + unescape_field(line.substr(tabs[2] + 1))] = entry;
+                    }
+                }
+            }
+
+            void save(const std::string& path) const {
+                std::ofstream file{ path, std::ios::trunc };
+                for (const auto& entry : entries_) {
+                    const auto tab = entry.first.find('\t');
+                    file << status_name(entry.second.status) << '\t' << entry.second.time.count() << '\t'
+                        << escape_field(entry.first.substr(0, tab)) << '\t' << escape_field(entry.first.substr(tab + 1)) << '\n';
+                }
+                if (!file) {
+                    throw std::runtime_error{ "Unable to write the status file " + path };
+                }
+            }
+
+            // Null when the test is not in the cache
+            const Entry* find(const std::string& scenario, const std::string& label) const {
+                auto it = entries_.find(scenario + '\t' + label);
+                return it == entries_.end() ? nullptr : &it->second;
+            }
+
+            void set(const std::string& scenario, const std::string& label, const Entry& entry) { entries_[scenario + '\t' + label] = entry; }
+
+            bool empty() const { return entries_.empty(); }
+
+        private:
+
+            std::map<std::string, Entry> entries_;
+        };
+
+        // Greedy bin packing: longest first, each item goes to the least loaded bin.
+        // Returns the bin of each item. Deterministic for the same costs, so that every
+        // node of a distributed run computes the same partition.
+#if H2OFT_DEFINE_FUNCTIONS_
+        H2OFT_INLINE std::vector<size_t> partition_by_cost(const std::vector<Duration>& costs, size_t bins) {
+            std::vector<size_t> order(costs.size());
+            for (size_t i = 0; i < order.size(); ++i) {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [&costs](size_t lhs, size_t rhs) { return costs[lhs] > costs[rhs]; });
+
+            std::vector<Duration> loads(std::max<size_t>(bins, 1), Duration{ 0 });
+            std::vector<size_t> assignment(costs.size(), 0);
+            for (auto item : order) {
+                const auto bin = static_cast<size_t>(std::min_element(loads.begin(), loads.end()) - loads.begin());
+                assignment[item] = bin;
+                loads[bin] += costs[item];
+            }
+            return assignment;
+        }
+#else
+        std::vector<size_t> partition_by_cost(const std::vector<Duration>& costs, size_t bins);
+#endif
+
+        // Type erased access to the results of a RegistryManager
+        // Used by the scheduler to hand back the tests it ran to the scenario they belong to
+        class IRegistryRecorder {
+        public:
+            virtual ~IRegistryRecorder() {}
+            virtual void record_result(const Test& test) = 0;
+            virtual void set_run() = 0;
+            virtual const char* name() const = 0;
+            // Timeout of the tests of the scenario, 0 for none
+            virtual Duration timeout() const = 0;
+            // Called by the watchdog thread while the test is still running
+            virtual void report_timeout(const Test& test, Duration timeout) = 0;
+            // Prints the summary of the last run to the console
+            virtual void print_results(bool /*verbose*/) const {}
+            // Called once before the first test of a run of the scenario, and after its last one
+            virtual void begin_scenario() {}
+            virtual void end_scenario() {}
+        };
+
+        // Counts the failures of a run against the limit of its policy, and tells the
+        // schedulers when to stop. Failures are counted as they are recorded, in the order
+        // of the list, so a run stops after the same tests whatever its mode.
+        class RunControl {
+        public:
+            RunControl(const ExecutionPolicy& policy)
+                : token_(policy.cancellation), max_failures_(policy.max_failures)
+            {}
+
+            void count(const Test& test) const {
+                if (is_failure(test.getStatus()) && ++token_.state_->failures >= max_failures_ && max_failures_ > 0) {
+                    token_.cancel();
+                }
+            }
+
+            bool stopped() const { return token_.isCancelled(); }
+
+        private:
+            CancellationToken token_;
+            size_t max_failures_;
+        };
+
+        class BaselineGate;
+
+        // A test to run, along with the fixtures and the registry of its scenario
+        struct ScheduledTest {
+            Test* test;
+            const SetUpFunctor* setup;
+            const TearDownFunctor* teardown;
+            IRegistryRecorder* recorder;
+            const BaselineGate* gate = nullptr; // set when the run has a baseline
+            Duration timeout{ 0 };              // of the test, or of its scenario, or of the run
+            const RunControl* control = nullptr;
+            bool failed_last = false;           // did not pass in the last run, see ExecutionPolicy::Order
+        };
+
+        // Compares the tests that passed with their reference time, and turns them SLOW
+        // when they exceed it by the ratio of the policy. Benchmarks compare their median,
+        // and must also be slower by more than 3 standard deviations, plain tests compare
+        // their execution time, and must also be slower by min_slowdown.
+        // The reference times use the timing file format, see TimingStore.
+        class BaselineGate {
+        public:
+
+            BaselineGate(const ExecutionPolicy& policy)
+                : policy_(policy) {
+                baseline_.load(policy.baseline_file);
+            }
+
+            // Time compared with the baseline
+            static Duration measure(const Test& test) {
+                if (auto stats = test.getBenchmarkStats()) {
+                    return Duration{ stats->median };
+                }
+                return test.getExecTimeMs();
+            }
+
+            void check(const ScheduledTest& task) const {
+                auto& test = *task.test;
+                Duration reference;
+                if (test.status_ != Test::Status::PASSED || !baseline_.find(task.recorder->name(), test.getLabel(false), reference)) {
+                    return;
+                }
+                const auto measured = measure(test);
+                const auto stats = test.getBenchmarkStats();
+                const auto noise = stats ? 3 * stats->stddev : policy_.min_slowdown.count();
+                if (measured.count() > reference.count() * policy_.slow_ratio && measured.count() - reference.count() > noise) {
+                    char reason[160];
+                    std::snprintf(reason, sizeof(reason), "Slower than its baseline: %.6f ms against %.6f ms (x%.2f, the limit is x%.2f)",
+                        measured.count(), reference.count(), measured.count() / std::max(reference.count(), 1e-12), policy_.slow_ratio);
+                    test.status_ = Test::Status::SLOW;
+                    test.failure_reason_ = reason;
+                }
+            }
+
+            // New tests are always added to the baseline, known tests only with update_baseline,
+            // so that a slowdown is not accepted silently
+            void save(const std::vector<ScheduledTest>& tasks) const {
+                const auto sharded = policy_.shard_count > 1;
+                auto updated = sharded ? TimingStore{} : baseline_;
+                for (const auto& task : tasks) {
+                    const auto status = task.test->getStatus();
+                    Duration reference;
+                    if ((status == Test::Status::PASSED || status == Test::Status::SLOW) &&
+                        (policy_.update_baseline || !baseline_.find(task.recorder->name(), task.test->getLabel(false), reference))) {
+                        updated.set(task.recorder->name(), task.test->getLabel(false), measure(*task.test));
+                    }
+                }
+                updated.save(sharded ? policy_.baseline_file + '.' + std::to_string(policy_.shard_index) : policy_.baseline_file);
+            }
+
+        private:
+
+            const ExecutionPolicy& policy_;
+            TimingStore baseline_;
+        };
+
+        // Reports the tests running in this process for longer than their timeout, from its own thread.
+        // A thread cannot be stopped safely, so the test keeps running and is only marked TIMEOUT
+        // when it returns: only the process mode can kill a hung test and go on with the others.
+        class Watchdog {
+        public:
+
+            using Clock = std::chrono::steady_clock;
+
+            Watchdog() : stop_(false), next_id_(0) {
+                thread_ = std::thread{ [this]() { watch(); } };
+            }
+
+            Watchdog(const Watchdog&) = delete;
+            Watchdog& operator=(const Watchdog&) = delete;
+
+            ~Watchdog() {
+                {
+                    std::lock_guard<std::mutex> lock{ mutex_ };
+                    stop_ = true;
+                }
+                cv_.notify_all();
+                thread_.join();
+            }
+
+            // Runs a task, and marks it TIMEOUT if it exceeded its timeout
+            void run(const ScheduledTest& task) {
+                if (task.timeout.count() <= 0) {
+                    task.test->run(*task.setup, *task.teardown);
+                    return;
+                }
+                const auto start = Clock::now();
+                size_t id;
+                {
+                    std::lock_guard<std::mutex> lock{ mutex_ };
+                    id = next_id_++;
+                    watched_.emplace(id, Watched{ start + std::chrono::duration_cast<Clock::duration>(task.timeout), &task, false });
+                }
+                cv_.notify_all();
+                try {
+                    task.test->run(*task.setup, *task.teardown);
+                }
+                catch (...) {
+                    release(id);
+                    throw;
+                }
+                release(id);
+                if (Duration{ Clock::now() - start } > task.timeout) {
+                    task.test->set_timed_out(task.timeout);
+                }
+            }
+
+        private:
+
+            struct Watched {
+                Clock::time_point deadline;
+                const ScheduledTest* task;
+                bool reported;
+            };
+
+            void release(size_t id) {
+                std::lock_guard<std::mutex> lock{ mutex_ };
+                watched_.erase(id);
+            }
+
+            void watch() {
+                std::vector<const ScheduledTest*> expired;
+                std::unique_lock<std::mutex> lock{ mutex_ };
+                while (!stop_) {
+                    const auto now = Clock::now();
+                    auto next = Clock::time_point::max();
+                    expired.clear();
+                    for (auto& entry : watched_) {
+                        if (entry.second.reported) {
+                            continue;
+                        }
+                        if (entry.second.deadline <= now) {
+                            entry.second.reported = true;
+                            expired.push_back(entry.second.task);
+                        }
+                        else {
+                            next = std::min(next, entry.second.deadline);
+                        }
+                    }
+                    if (!expired.empty()) {
+                        lock.unlock(); // observers are not called with the lock held
+                        for (auto task : expired) {
+                            task->recorder->report_timeout(*task->test, task->timeout);
+                        }
+                        lock.lock();
+                        continue;
+                    }
+                    if (next == Clock::time_point::max()) {
+                        cv_.wait(lock);
+                    }
+                    else {
+                        cv_.wait_until(lock, next);
+                    }
+                }
+            }
+
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            bool stop_;
+            size_t next_id_;
+            std::map<size_t, Watched> watched_;
+            std::thread thread_;
+        };
+
+        // Hands a test that was run to its scenario
+#if H2OFT_DEFINE_FUNCTIONS_
+        H2OFT_INLINE void record_task(const ScheduledTest& task) {
+            if (task.gate) {
+                task.gate->check(task);
+            }
+            task.recorder->record_result(*task.test);
+            if (task.control) {
+                task.control->count(*task.test);
+            }
+        }
+#else
+        void record_task(const ScheduledTest& task);
+#endif
+
+#if H2OFT_HAS_COROUTINES_
+        // The coroutine tests of a run share one event loop, see TestScheduler::run_coroutines
+        inline void AsyncTest::run_coroutines_private(const std::vector<ScheduledTest>& tasks, const RunControl& control, size_t at_once) {
+            std::map<const Test*, size_t> indices;
+            for (size_t i = 0; i < tasks.size(); ++i) {
+                indices[tasks[i].test] = i;
+            }
+            EventLoop loop;
+            size_t next = 0;
+            std::exception_ptr failure; // set up or tear down may throw
+            const auto start_more = [&]() {
+                while (next < tasks.size() && loop.running() < at_once && !control.stopped() && !failure) {
+                    const auto& task = tasks[next++];
+                    loop.start(static_cast<AsyncTest&>(*task.test), task.setup, task.teardown, task.timeout);
+                }
+            };
+            start_more();
+            loop.run([&](AsyncTest& test) {
+                if (test.fixture_error_) {
+                    failure = failure ? failure : test.fixture_error_;
+                    return;
+                }
+                record_task(tasks[indices[&test]]);
+                start_more();
+            });
+            if (failure) {
+                std::rethrow_exception(failure);
+            }
+        }
+#endif
+
+        // Hands the results back to each recorder in the order of the list
+        // as soon as every test before them in the same scenario is done
+        class OrderedCommitter {
+        public:
+
+            OrderedCommitter(const std::vector<ScheduledTest>& tasks)
+                : tasks_(tasks), done_(tasks.size(), 0)
+            {
+                for (size_t i = 0; i < tasks.size(); ++i) {
+                    pending_[tasks[i].recorder].push_back(i);
+                }
+            }
+
+            void set_done(size_t task) { done_[task] = 1; }
+
+            // Pops every result that can be recorded
+            void collect(std::vector<size_t>& ready) {
+                for (auto& recorder : pending_) {
+                    auto& indices = recorder.second;
+                    while (!indices.empty() && done_[indices.front()]) {
+                        ready.push_back(indices.front());
+                        indices.pop_front();
+                    }
+                }
+            }
+
+            void record(const std::vector<size_t>& ready) const {
+                for (auto task : ready) {
+                    record_task(tasks_[task]);
+                }
+            }
+
+            void commit() {
+                std::vector<size_t> ready;
+                collect(ready);
+                record(ready);
+            }
+
+            // Records what is done once the run stops, leaving out the tests it did not run
+            void commit_stopped() {
+                std::vector<size_t> ready;
+                for (auto& recorder : pending_) {
+                    for (auto task : recorder.second) {
+                        if (done_[task]) {
+                            ready.push_back(task);
+                        }
+                    }
+                    recorder.second.clear();
+                }
+                std::sort(ready.begin(), ready.end());
+                record(ready);
+            }
+
+        private:
+
+            const std::vector<ScheduledTest>& tasks_;
+            std::vector<char> done_;
+            std::map<IRegistryRecorder*, std::deque<size_t>> pending_;
+        };
+
+        // Runs slices of a list of tests in child processes, so that a crashing test only takes
+        // its worker down. Workers stream compact binary records back to the parent over a pipe:
+        //     'B' <u32 task>                                        test started
+        //     'S' <u32 task> <BenchmarkStats>                        benchmark measured
+        //     'P' <u32 task> <PerfStats>                             body counted with perf_event
+        //     'A' <u32 task> <AllocationStats>                       body allocations counted
+        //     'E' <u32 task> <u8 status> <f64 ms> <f64 setup_ms> <f64 teardown_ms>   test ended
+        //         <str failure> <str error>
+        //         <u32 failure_count> <u32 recorded> <str>*recorded       its failures, see ExpectThat
+        // where <str> is a <u32 size> followed by the bytes.
+        // A worker that dies leaves its current test in ERROR and is respawned for the rest of
+        // its slice. A worker whose current test exceeds its timeout is killed, the test is
+        // TIMEOUT and the worker respawned. On POSIX workers are forked, and thus inherit the
+        // registry as is.
+        // On Windows the executable is relaunched with the H2OFT_PROCESS_WORKER variable set,
+        // and the child acts as a worker when it reaches the same run call: code running before
+        // it in main is run again in each worker.
+        class ProcessShards {
+        public:
+
+            ProcessShards(const std::vector<ScheduledTest>& tasks, size_t shards, const RunControl& control)
+                : tasks_(tasks), shards_(std::max<size_t>(std::min(shards, std::max<size_t>(tasks.size(), 1)), 1)),
+                ordinal_(next_ordinal()++), committer_(tasks), control_(control)
+            {}
+
+            void run() {
+#if H2OFT_OS_WINDOWS_DESKTOP
+                const auto spec = get_environment("H2OFT_PROCESS_WORKER");
+                if (!spec.empty()) {
+                    unsigned long long handle = 0;
+                    unsigned ordinal = 0, shard = 0, shards = 0, skip = 0;
+                    const auto parsed = sscanf_s(spec.c_str(), "%llu %u %u %u %u", &handle, &ordinal, &shard, &shards, &skip);
+                    if (parsed == 5 && ordinal == ordinal_) {
+                        const auto pipe = reinterpret_cast<HANDLE>(static_cast<uintptr_t>(handle));
+                        auto code = 0;
+                        try {
+                            run_worker(slice(shard, shards), skip, [pipe](const std::string& bytes) {
+                                DWORD written = 0;
+                                return WriteFile(pipe, bytes.data(), static_cast<DWORD>(bytes.size()), &written, nullptr) && written == bytes.size();
+                            });
+                        }
+                        catch (...) {
+                            code = 1; // the parent blames the current test
+                        }
+                        std::cout.flush();
+                        fflush(nullptr);
+                        _exit(code);
+                    }
+                    return; // Another run call of this executable is the one being sharded
+                }
+                run_supervisor();
+#elif H2OFT_HAS_FORK_
+                run_supervisor();
+#else
+                // No way to spawn workers here: run in process
+                for (const auto& task : tasks_) {
+                    if (control_.stopped()) {
+                        break;
+                    }
+                    task.test->run(*task.setup, *task.teardown);
+                    record_task(task);
+                }
+#endif
+            }
+
+        private:
+
+            static unsigned& next_ordinal() {
+                static unsigned ordinal = 0;
+                return ordinal;
+            }
+
+            // Serial tests are run last by an extra worker, alone
+            size_t slice_count() const {
+                return shards_ + 1;
+            }
+
+            std::vector<size_t> slice(size_t shard, size_t shards) const {
+                std::vector<size_t> indices;
+                size_t position = 0;
+                for (size_t i = 0; i < tasks_.size(); ++i) {
+                    if (tasks_[i].test->isSerial()) {
+                        if (shard == shards) {
+                            indices.push_back(i);
+                        }
+                    }
+                    else if (position++ % shards == shard && shard != shards) {
+                        indices.push_back(i);
+                    }
+                }
+                return indices;
+            }
+
+            // Wire format helpers
+            template<class T>
+            static void put(std::string& bytes, T value) {
+                bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+            }
+
+            static void put(std::string& bytes, const std::string& value) {
+                put(bytes, static_cast<uint32_t>(value.size()));
+                bytes.append(value);
+            }
+
+            template<class T>
+            static bool get(const std::string& bytes, size_t& offset, T& value) {
+                if (bytes.size() < offset + sizeof(value)) {
+                    return false;
+                }
+                std::memcpy(&value, bytes.data() + offset, sizeof(value));
+                offset += sizeof(value);
+                return true;
+            }
+
+            static bool get(const std::string& bytes, size_t& offset, std::string& value) {
+                uint32_t size = 0;
+                if (!get(bytes, offset, size) || bytes.size() < offset + size) {
+                    return false;
+                }
+                value.assign(bytes.data() + offset, size);
+                offset += size;
+                return true;
+            }
+
+            template<class Writer>
+            void run_worker(const std::vector<size_t>& indices, size_t skip, const Writer& write) const {
+                std::string bytes;
+                for (auto i = skip; i < indices.size(); ++i) {
+                    const auto& task = tasks_[indices[i]];
+                    bytes.clear();
+                    put(bytes, 'B');
+                    put(bytes, static_cast<uint32_t>(indices[i]));
+                    if (!write(bytes)) {
+                        return;
+                    }
+                    const auto start = std::chrono::steady_clock::now();
+                    // Rethrown in process, here it would unwind the worker into the code of the parent
+                    try {
+                        task.test->run(*task.setup, *task.teardown);
+                    }
+                    catch (const std::exception& e) {
+                        task.test->set_fixture_error(e.what());
+                    }
+                    catch (...) {
+                        task.test->set_fixture_error("Unkown error");
+                    }
+                    if (task.timeout.count() > 0 && Duration{ std::chrono::steady_clock::now() - start } > task.timeout) {
+                        task.test->set_timed_out(task.timeout);
+                    }
+                    bytes.clear();
+                    if (auto stats = task.test->getBenchmarkStats()) {
+                        put(bytes, 'S');
+                        put(bytes, static_cast<uint32_t>(indices[i]));
+                        put(bytes, *stats);
+                    }
+                    if (auto stats = task.test->getPerfStats()) {
+                        put(bytes, 'P');
+                        put(bytes, static_cast<uint32_t>(indices[i]));
+                        put(bytes, *stats);
+                    }
+                    if (auto stats = task.test->getAllocationStats()) {
+                        put(bytes, 'A');
+                        put(bytes, static_cast<uint32_t>(indices[i]));
+                        put(bytes, *stats);
+                    }
+                    put(bytes, 'E');
+                    put(bytes, static_cast<uint32_t>(indices[i]));
+                    put(bytes, static_cast<uint8_t>(task.test->status_));
+                    put(bytes, task.test->exec_time_ms_.count());
+                    put(bytes, task.test->setup_time_ms_.count());
+                    put(bytes, task.test->teardown_time_ms_.count());
+                    put(bytes, task.test->failure_reason_);
+                    put(bytes, task.test->error_);
+                    put(bytes, static_cast<uint32_t>(task.test->failure_count_));
+                    put(bytes, static_cast<uint32_t>(task.test->failures_.size()));
+                    for (const auto& failure : task.test->failures_) {
+                        put(bytes, failure);
+                    }
+                    if (!write(bytes)) {
+                        return;
+                    }
+                }
+            }
+
+            // Parent side state of a worker
+            struct Worker {
+                std::vector<size_t> indices; // slice of the tasks
+                size_t started = 0;          // number of tests of the slice started so far
+                bool running = false;        // the last started test has not ended yet
+                std::string buffer;          // bytes received and not parsed yet
+                std::chrono::steady_clock::time_point started_at; // of the last started test
+                bool timed_out = false;      // killed by the supervisor for a timeout
+#if H2OFT_OS_WINDOWS_DESKTOP
+                HANDLE process = nullptr;
+                HANDLE pipe = nullptr;
+#else
+                pid_t pid = -1;
+                int fd = -1;
+#endif
+                bool finished() const { return started == indices.size() && !running; }
+            };
+
+            // Parses every complete record received, returns false on a malformed stream
+            bool consume(Worker& worker) {
+                size_t offset = 0;
+                for (;;) {
+                    auto record = offset;
+                    char kind = 0;
+                    uint32_t task = 0;
+                    if (!get(worker.buffer, record, kind) || !get(worker.buffer, record, task)) {
+                        break;
+                    }
+                    if (task >= tasks_.size()) {
+                        return false;
+                    }
+                    if (kind == 'B') {
+                        ++worker.started;
+                        worker.running = true;
+                        worker.started_at = std::chrono::steady_clock::now();
+                    }
+                    else if (kind == 'S') {
+                        BenchmarkStats stats;
+                        if (!get(worker.buffer, record, stats)) {
+                            break;
+                        }
+                        tasks_[task].test->setBenchmarkStats_private(stats);
+                    }
+                    else if (kind == 'P') {
+                        PerfStats stats;
+                        if (!get(worker.buffer, record, stats)) {
+                            break;
+                        }
+                        tasks_[task].test->perf_stats_ = stats;
+                    }
+                    else if (kind == 'A') {
+                        AllocationStats stats;
+                        if (!get(worker.buffer, record, stats)) {
+                            break;
+                        }
+                        tasks_[task].test->allocation_stats_ = stats;
+                        tasks_[task].test->allocations_counted_ = true;
+                    }
+                    else if (kind == 'E') {
+                        uint8_t status = 0;
+                        double ms = 0, setup_ms = 0, teardown_ms = 0;
+                        std::string failure, error;
+                        uint32_t failure_count = 0, recorded = 0;
+                        if (!get(worker.buffer, record, status) || !get(worker.buffer, record, ms) ||
+                            !get(worker.buffer, record, setup_ms) || !get(worker.buffer, record, teardown_ms) ||
+                            !get(worker.buffer, record, failure) || !get(worker.buffer, record, error) ||
+                            !get(worker.buffer, record, failure_count) || !get(worker.buffer, record, recorded)) {
+                            break;
+                        }
+                        if (recorded > FailureBuffer::capacity + 1) { // the expectations and the assert
+                            return false;
+                        }
+                        std::vector<std::string> failures(recorded);
+                        if (!std::all_of(failures.begin(), failures.end(), [&](std::string& message) { return get(worker.buffer, record, message); })) {
+                            break;
+                        }
+                        auto& test = *tasks_[task].test;
+                        test.failure_count_ = failure_count;
+                        test.failures_ = std::move(failures);
+                        test.status_ = static_cast<Test::Status>(status);
+                        test.exec_time_ms_ = Duration{ ms };
+                        test.setup_time_ms_ = Duration{ setup_ms };
+                        test.teardown_time_ms_ = Duration{ teardown_ms };
+                        test.failure_reason_ = std::move(failure);
+                        test.error_ = std::move(error);
+                        worker.running = false;
+                        committer_.set_done(task);
+                    }
+                    else {
+                        return false;
+                    }
+                    offset = record;
+                }
+                worker.buffer.erase(0, offset);
+                return true;
+            }
+
+            // Deadline of the test a worker is running, max when there is none
+            std::chrono::steady_clock::time_point deadline(const Worker& worker) const {
+                if (worker.running) {
+                    const auto timeout = tasks_[worker.indices[worker.started - 1]].timeout;
+                    if (timeout.count() > 0) {
+                        return worker.started_at + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+                    }
+                }
+                return std::chrono::steady_clock::time_point::max();
+            }
+
+            std::chrono::steady_clock::time_point next_deadline(const std::vector<Worker>& workers) const {
+                auto next = std::chrono::steady_clock::time_point::max();
+                for (const auto& worker : workers) {
+                    if (!worker.timed_out) {
+                        next = std::min(next, deadline(worker));
+                    }
+                }
+                return next;
+            }
+
+            // Marks the workers to kill for a timeout, and returns their tests
+            std::vector<size_t> expire(std::vector<Worker>& workers) const {
+                std::vector<size_t> expired;
+                const auto now = std::chrono::steady_clock::now();
+                for (auto& worker : workers) {
+                    if (!worker.timed_out && deadline(worker) <= now) {
+                        worker.timed_out = true;
+                        expired.push_back(worker.indices[worker.started - 1]);
+                    }
+                }
+                return expired;
+            }
+
+            void report_timeouts(const std::vector<size_t>& expired) const {
+                for (auto task : expired) {
+                    tasks_[task].recorder->report_timeout(*tasks_[task].test, tasks_[task].timeout);
+                }
+            }
+
+            // The worker was killed for a timeout, and its pipe drained
+            void on_killed(Worker& worker) {
+                worker.timed_out = false;
+                worker.buffer.clear();
+                if (!worker.running) {
+                    return; // done with its test in between, nothing to blame
+                }
+                const auto expired = deadline(worker) <= std::chrono::steady_clock::now();
+                worker.running = false;
+                if (!expired) {
+                    --worker.started; // killed while starting the next test: run it again
+                    return;
+                }
+                const auto task = worker.indices[worker.started - 1];
+                auto& test = *tasks_[task].test;
+                test.exec_time_ms_ = std::chrono::steady_clock::now() - worker.started_at;
+                test.set_timed_out(tasks_[task].timeout, ", its worker process was killed");
+                committer_.set_done(task);
+            }
+
+            // The worker is gone: blame its current test and skip it
+            void on_exit(Worker& worker, const std::string& reason) {
+                if (worker.running) {
+                    auto task = worker.indices[worker.started - 1];
+                    auto& test = *tasks_[task].test;
+                    test.status_ = Test::Status::ERROR;
+                    test.error_ = reason;
+                    worker.running = false;
+                    committer_.set_done(task);
+                }
+                else if (worker.started < worker.indices.size()) {
+                    // Died between two tests, blame the next one so that we always make progress
+                    auto task = worker.indices[worker.started++];
+                    auto& test = *tasks_[task].test;
+                    test.status_ = Test::Status::ERROR;
+                    test.error_ = reason;
+                    committer_.set_done(task);
+                }
+                worker.buffer.clear();
+            }
+
+#if H2OFT_OS_WINDOWS_DESKTOP
+
+            bool spawn(Worker& worker, size_t shard) {
+                static std::mutex spawn_mutex; // the environment and inheritable handles are process wide
+                std::lock_guard<std::mutex> lock(spawn_mutex);
+
+                HANDLE read_pipe = nullptr, write_pipe = nullptr, inherited_pipe = nullptr;
+                if (!CreatePipe(&read_pipe, &write_pipe, nullptr, 0)) {
+                    return false;
+                }
+                if (!DuplicateHandle(GetCurrentProcess(), write_pipe, GetCurrentProcess(), &inherited_pipe, 0, TRUE, DUPLICATE_SAME_ACCESS)) {
+                    CloseHandle(read_pipe);
+                    CloseHandle(write_pipe);
+                    return false;
+                }
+                CloseHandle(write_pipe);
+
+                char spec[128];
+                sprintf_s(spec, "%llu %u %u %u %u", static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(inherited_pipe)),
+                    ordinal_, static_cast<unsigned>(shard), static_cast<unsigned>(shards_), static_cast<unsigned>(worker.started));
+                SetEnvironmentVariableA("H2OFT_PROCESS_WORKER", spec);
+
+                std::string command_line = GetCommandLineA();
+                STARTUPINFOA startup_info = {};
+                startup_info.cb = sizeof(startup_info);
+                PROCESS_INFORMATION process_info = {};
+                const auto created = CreateProcessA(nullptr, &command_line[0], nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startup_info, &process_info);
+
+                SetEnvironmentVariableA("H2OFT_PROCESS_WORKER", nullptr);
+                CloseHandle(inherited_pipe);
+                if (!created) {
+                    CloseHandle(read_pipe);
+                    return false;
+                }
+                CloseHandle(process_info.hThread);
+                worker.process = process_info.hProcess;
+                worker.pipe = read_pipe;
+                return true;
+            }
+
+            // One supervising thread per worker, results are recorded on the calling thread
+            void run_supervisor() {
+                std::cout.flush();
+                fflush(nullptr);
+
+                std::vector<Worker> workers(slice_count());
+                std::mutex mutex;
+                std::condition_variable cv;
+                size_t finished = 0;
+                auto stopping = false; // the run was stopped, the workers were terminated
+
+                auto supervise = [&](size_t shard) {
+                    auto& worker = workers[shard];
+                    for (;;) {
+                        {
+                            // Under the lock, the calling thread may terminate the process
+                            std::lock_guard<std::mutex> lock(mutex);
+                            if (worker.finished() || stopping) {
+                                break;
+                            }
+                            if (!spawn(worker, shard)) {
+                                on_exit(worker, "Unable to start a worker process");
+                                cv.notify_all();
+                                continue;
+                            }
+                        }
+                        char chunk[4096];
+                        DWORD read = 0;
+                        auto valid = true;
+                        while (valid && ReadFile(worker.pipe, chunk, sizeof(chunk), &read, nullptr) && read > 0) {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            worker.buffer.append(chunk, read);
+                            valid = consume(worker);
+                            cv.notify_all();
+                        }
+                        CloseHandle(worker.pipe);
+                        if (!valid) {
+                            TerminateProcess(worker.process, 1);
+                        }
+                        WaitForSingleObject(worker.process, INFINITE);
+                        DWORD code = 0;
+                        GetExitCodeProcess(worker.process, &code);
+
+                        std::lock_guard<std::mutex> lock(mutex);
+                        CloseHandle(worker.process);
+                        worker.process = nullptr;
+                        if (stopping) {
+                            worker.running = false; // its test is left out
+                        }
+                        else if (worker.timed_out) {
+                            on_killed(worker);
+                        }
+                        else if (!worker.finished()) {
+                            std::ostringstream oss;
+                            oss << "Worker process exited with code 0x" << std::hex << code;
+                            on_exit(worker, oss.str());
+                        }
+                        cv.notify_all();
+                    }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++finished;
+                    cv.notify_all();
+                };
+
+                for (size_t shard = 0; shard < workers.size(); ++shard) {
+                    workers[shard].indices = slice(shard, shards_);
+                }
+                // Serial tests wait for every other worker to be done
+                std::vector<std::thread> supervisors;
+                for (size_t shard = 0; shard < shards_; ++shard) {
+                    supervisors.emplace_back(supervise, shard);
+                }
+
+                // The calling thread also kills the workers whose test exceeds its timeout
+                std::vector<size_t> ready;
+                std::vector<size_t> expired;
+                for (auto serial_started = false;;) {
+                    ready.clear();
+                    expired.clear();
+                    auto all_done = false;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        for (;;) {
+                            committer_.collect(ready);
+                            if (!ready.empty() || finished == shards_ + 1 || (finished == shards_ && !serial_started) || control_.stopped()) {
+                                break;
+                            }
+                            expired = expire(workers);
+                            if (!expired.empty()) {
+                                for (auto& worker : workers) {
+                                    if (worker.timed_out && worker.process != nullptr) {
+                                        TerminateProcess(worker.process, 1);
+                                    }
+                                }
+                                break;
+                            }
+                            // Wakes up now and then for a cancellation from another thread
+                            cv.wait_until(lock, std::min(next_deadline(workers), std::chrono::steady_clock::now() + std::chrono::milliseconds{ 100 }));
+                        }
+                        all_done = finished == shards_ + 1;
+                        if (control_.stopped()) {
+                            stopping = true;
+                            for (auto& worker : workers) {
+                                if (worker.process != nullptr) {
+                                    TerminateProcess(worker.process, 1);
+                                }
+                            }
+                            all_done = true;
+                        }
+                        else if (finished == shards_ && !serial_started) {
+                            serial_started = true;
+                            supervisors.emplace_back(supervise, shards_);
+                        }
+                    }
+                    report_timeouts(expired);
+                    committer_.record(ready); // observers are not called with the lock held
+                    if (all_done) {
+                        break;
+                    }
+                }
+                for (auto& supervisor : supervisors) {
+                    supervisor.join();
+                }
+                committer_.commit_stopped();
+            }
+
+#elif H2OFT_HAS_FORK_
+
+            bool spawn(Worker& worker, size_t /*shard*/) {
+                int fds[2];
+                if (pipe(fds) != 0) {
+                    return false;
+                }
+                // Flush now, or the child would print what is still buffered a second time
+                std::cout.flush();
+                fflush(nullptr);
+                const auto pid = fork();
+                if (pid < 0) {
+                    close(fds[0]);
+                    close(fds[1]);
+                    return false;
+                }
+                if (pid == 0) {
+                    close(fds[0]);
+                    const auto fd = fds[1];
+                    auto code = 0;
+                    try {
+                        run_worker(worker.indices, worker.started, [fd](const std::string& bytes) {
+                            size_t written = 0;
+                            while (written < bytes.size()) {
+                                const auto count = write(fd, bytes.data() + written, bytes.size() - written);
+                                if (count < 0 && errno == EINTR) {
+                                    continue;
+                                }
+                                if (count <= 0) {
+                                    return false;
+                                }
+                                written += static_cast<size_t>(count);
+                            }
+                            return true;
+                        });
+                    }
+                    catch (...) {
+                        code = 1; // the parent blames the current test
+                    }
+                    std::cout.flush();
+                    fflush(nullptr);
+                    _exit(code); // No static destructors nor atexit handlers: they belong to the parent
+                }
+                close(fds[1]);
+                worker.pid = pid;
+                worker.fd = fds[0];
+                return true;
+            }
+
+            // Reaps a worker whose pipe was closed
+            void reap(Worker& worker) {
+                close(worker.fd);
+                worker.fd = -1;
+                int status = 0;
+                while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {}
+                worker.pid = -1;
+                if (worker.timed_out) {
+                    on_killed(worker);
+                }
+                else if (!worker.finished()) {
+                    std::ostringstream oss;
+                    if (WIFSIGNALED(status)) {
+                        oss << "Worker process killed by signal " << WTERMSIG(status) << " (" << strsignal(WTERMSIG(status)) << ")";
+                    }
+                    else {
+                        oss << "Worker process exited with code " << WEXITSTATUS(status);
+                    }
+                    on_exit(worker, oss.str());
+                }
+            }
+
+            // Single threaded supervision with poll, so forking is always safe
+            void run_supervisor() {
+                std::vector<Worker> workers(slice_count());
+                for (size_t shard = 0; shard < workers.size(); ++shard) {
+                    workers[shard].indices = slice(shard, shards_);
+                }
+
+                auto start = [this, &workers](size_t shard) {
+                    auto& worker = workers[shard];
+                    while (!control_.stopped() && !worker.finished() && worker.fd < 0 && !spawn(worker, shard)) {
+                        on_exit(worker, "Unable to start a worker process");
+                    }
+                };
+                for (size_t shard = 0; shard < shards_; ++shard) {
+                    start(shard);
+                }
+
+                // Serial tests wait for every other worker to be done
+                auto serial_started = false;
+                std::vector<pollfd> fds;
+                std::vector<size_t> polled;
+                for (;;) {
+                    committer_.commit();
+                    if (control_.stopped()) {
+                        // The tests the workers are running are left out
+                        for (auto& worker : workers) {
+                            if (worker.fd >= 0) {
+                                kill(worker.pid, SIGKILL);
+                                close(worker.fd);
+                                worker.fd = -1;
+                                while (waitpid(worker.pid, nullptr, 0) < 0 && errno == EINTR) {}
+                            }
+                        }
+                        break;
+                    }
+
+                    fds.clear();
+                    polled.clear();
+                    for (size_t shard = 0; shard < workers.size(); ++shard) {
+                        if (workers[shard].fd >= 0) {
+                            fds.push_back({ workers[shard].fd, POLLIN, 0 });
+                            polled.push_back(shard);
+                        }
+                    }
+                    if (fds.empty()) {
+                        if (serial_started) {
+                            break;
+                        }
+                        serial_started = true;
+                        start(shards_);
+                        continue;
+                    }
+
+                    // Wakes up now and then for a cancellation from another thread
+                    auto wait = 100;
+                    const auto next = next_deadline(workers);
+                    if (next != std::chrono::steady_clock::time_point::max()) {
+                        const auto left = std::chrono::ceil<std::chrono::milliseconds>(next - std::chrono::steady_clock::now()).count();
+                        wait = static_cast<int>(std::min<decltype(left)>(std::max<decltype(left)>(left, 0), wait));
+                    }
+                    const auto events = poll(fds.data(), static_cast<nfds_t>(fds.size()), wait);
+                    if (events < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        break;
+                    }
+                    if (events == 0) {
+                        const auto expired = expire(workers);
+                        report_timeouts(expired);
+                        for (auto shard : polled) {
+                            auto& worker = workers[shard];
+                            if (!worker.timed_out) {
+                                continue;
+                            }
+                            // Whatever the worker wrote before being killed still counts
+                            kill(worker.pid, SIGKILL);
+                            char chunk[4096];
+                            for (;;) {
+                                const auto count = read(worker.fd, chunk, sizeof(chunk));
+                                if (count < 0 && errno == EINTR) {
+                                    continue;
+                                }
+                                if (count <= 0) {
+                                    break;
+                                }
+                                worker.buffer.append(chunk, static_cast<size_t>(count));
+                            }
+                            consume(worker);
+                            reap(worker);
+                            start(shard);
+                        }
+                        continue;
+                    }
+                    for (size_t i = 0; i < fds.size(); ++i) {
+                        if (fds[i].revents == 0) {
+                            continue;
+                        }
+                        auto& worker = workers[polled[i]];
+                        char chunk[4096];
+                        const auto count = read(worker.fd, chunk, sizeof(chunk));
+                        if (count < 0 && errno == EINTR) {
+                            continue;
+                        }
+                        if (count > 0) {
+                            worker.buffer.append(chunk, static_cast<size_t>(count));
+                            if (consume(worker)) {
+                                continue;
+                            }
+                            kill(worker.pid, SIGKILL);
+                        }
+                        reap(worker);
+                        start(polled[i]);
+                    }
+                }
+                committer_.commit_stopped();
+            }
+
+#endif
+
+            const std::vector<ScheduledTest>& tasks_;
+            size_t shards_;
+            unsigned ordinal_; // rank of this run among the process sharded runs of the executable
+            OrderedCommitter committer_;
+            const RunControl& control_; // once stopped, the workers are killed and not respawned
+        };
+
+        // Runs a list of tests according to an execution policy.
+        // The list is filtered, then reordered or pruned by the statuses of the previous run,
+        // see ExecutionPolicy::Order, before being partitioned.
+        // With a shard count, only the partition of this process is run, see partition_by_cost.
+        // In parallel mode, each worker owns a deque seeded longest-first from the previous
+        // run's execution times (in this process, or from the timing file) and steals from the
+        // back of the others' once its own is empty, so the slowest tests start first and the
+        // tail is bounded by the slowest single test.
+        // Workers call setup/teardown around each test they run, from their own thread.
+        // Serial tests are run on the calling thread once the pool is idle, so they never run
+        // concurrently with another test.
+        // Results are always recorded on the calling thread, in the order of the list for the
+        // tests sharing the same recorder, as soon as they are available.
+        class TestScheduler {
+        public:
+
+            TestScheduler(const ExecutionPolicy& policy)
+                : policy_(policy)
+            {}
+
+            void run(const std::vector<ScheduledTest>& all_tasks) const {
+                TimingStore timings;
+                if (!policy_.timing_file.empty()) {
+                    timings.load(policy_.timing_file);
+                }
+
+                StatusCache statuses;
+                if (!policy_.status_file.empty()) {
+                    statuses.load(policy_.status_file);
+                }
+
+                auto tasks = select_shard(order_by_status(select_filtered(all_tasks), statuses), timings);
+                std::unique_ptr<BaselineGate> gate;
+                if (!policy_.baseline_file.empty()) {
+                    gate.reset(new BaselineGate{ policy_ });
+                }
+                const RunControl control{ policy_ };
+                auto timeouts = false;
+                for (auto& task : tasks) {
+                    task.gate = gate.get();
+                    task.control = &control;
+                    const auto own = task.test->getTimeout();
+                    const auto scenario = task.recorder->timeout();
+                    task.timeout = own.count() > 0 ? own : scenario.count() > 0 ? scenario : policy_.timeout;
+                    timeouts = timeouts || task.timeout.count() > 0;
+                }
+                // Worker processes enforce the timeouts themselves, see ProcessShards
+                std::unique_ptr<Watchdog> watchdog;
+                if (timeouts && policy_.mode != ExecutionPolicy::Mode::PROCESSES) {
+                    watchdog.reset(new Watchdog);
+                }
+                // Forked worker processes inherit what the scenarios set up
+                const auto scenarios = begin_scenarios(tasks);
+                // Coroutine tests interleave on an event loop once the others are done,
+                // worker processes give each its own loop
+                std::vector<ScheduledTest> coroutines;
+                const auto threaded = policy_.mode == ExecutionPolicy::Mode::PROCESSES ? tasks : split_coroutines(tasks, coroutines);
+                try {
+                    if (policy_.mode == ExecutionPolicy::Mode::PARALLEL) {
+                        run_parallel(threaded, timings, watchdog.get(), control);
+                    }
+                    else if (policy_.mode == ExecutionPolicy::Mode::PROCESSES) {
+                        ProcessShards{ threaded, policy_.workers, control }.run();
+                    }
+                    else {
+                        for (const auto& task : threaded) {
+                            if (control.stopped()) {
+                                break;
+                            }
+                            run_one(task, watchdog.get());
+                            record_task(task);
+                        }
+                    }
+                    run_coroutines(coroutines, control);
+                }
+                catch (...) {
+                    end_scenarios(scenarios);
+                    throw;
+                }
+                end_scenarios(scenarios);
+
+                // A sharded run leaves the timing file untouched, so that every shard computes
+                // the same partition, and writes the times of its own tests to <file>.<index>.
+                // Those files are merged by concatenation.
+                if (!policy_.timing_file.empty()) {
+                    auto sharded = policy_.shard_count > 1;
+                    TimingStore shard_timings;
+                    auto& updated = sharded ? shard_timings : timings;
+                    for (const auto& task : tasks) {
+                        if (task.test->getStatus() != Test::Status::NONE && task.test->getStatus() != Test::Status::SKIPPED) {
+                            updated.set(task.recorder->name(), task.test->getLabel(false), task.test->getExecTimeMs());
+                        }
+                    }
+                    updated.save(sharded ? policy_.timing_file + '.' + std::to_string(policy_.shard_index) : policy_.timing_file);
+                }
+                // Same as the timing file
+                if (!policy_.status_file.empty()) {
+                    auto sharded = policy_.shard_count > 1;
+                    StatusCache shard_statuses;
+                    auto& updated = sharded ? shard_statuses : statuses;
+                    for (const auto& task : tasks) {
+                        if (task.test->getStatus() != Test::Status::NONE) {
+                            updated.set(task.recorder->name(), task.test->getLabel(false), { task.test->getStatus(), task.test->getExecTimeMs() });
+                        }
+                    }
+                    updated.save(sharded ? policy_.status_file + '.' + std::to_string(policy_.shard_index) : policy_.status_file);
+                }
+                if (gate) {
+                    gate->save(tasks);
+                }
+            }
+
+        private:
+
+            // Sets up the scenarios of the tasks, in the order of the list, and returns them.
+            // The tasks of the scenarios failing to do so are recorded in ERROR and removed.
+            static std::vector<IRegistryRecorder*> begin_scenarios(std::vector<ScheduledTest>& tasks) {
+                std::vector<IRegistryRecorder*> scenarios;
+                std::map<IRegistryRecorder*, std::string> failed;
+                for (const auto& task : tasks) {
+                    if (std::find(scenarios.begin(), scenarios.end(), task.recorder) != scenarios.end() || failed.count(task.recorder)) {
+                        continue;
+                    }
+                    try {
+                        task.recorder->begin_scenario();
+                        scenarios.push_back(task.recorder);
+                    }
+                    catch (const std::exception& e) {
+                        failed[task.recorder] = e.what();
+                    }
+                    catch (...) {
+                        failed[task.recorder] = "Unkown error";
+                    }
+                }
+                if (!failed.empty()) {
+                    std::vector<ScheduledTest> runnable;
+                    for (const auto& task : tasks) {
+                        auto error = failed.find(task.recorder);
+                        if (error == failed.end()) {
+                            runnable.push_back(task);
+                            continue;
+                        }
+                        task.test->set_scenario_error(error->second);
+                        record_task(task);
+                    }
+                    tasks.swap(runnable);
+                }
+                return scenarios;
+            }
+
+            // In the reverse order
+            static void end_scenarios(const std::vector<IRegistryRecorder*>& scenarios) {
+                for (auto it = scenarios.rbegin(); it != scenarios.rend(); ++it) {
+                    (*it)->end_scenario();
+                }
+            }
+
+            // Moves the coroutine tests to coroutines, returns the others
+            static std::vector<ScheduledTest> split_coroutines(const std::vector<ScheduledTest>& tasks, std::vector<ScheduledTest>& coroutines) {
+                std::vector<ScheduledTest> others;
+                for (const auto& task : tasks) {
+                    (task.test->is_async_private() ? coroutines : others).push_back(task);
+                }
+                return others;
+            }
+
+            // At most async_tests of them at once, each recorded as soon as it finished
+            void run_coroutines(const std::vector<ScheduledTest>& tasks, const RunControl& control) const {
+                if (!tasks.empty()) {
+                    tasks.front().test->run_coroutines_private(tasks, control, std::max<size_t>(policy_.async_tests, 1));
+                }
+            }
+
+            static void run_one(const ScheduledTest& task, Watchdog* watchdog) {
+                if (watchdog) {
+                    watchdog->run(task);
+                }
+                else {
+                    task.test->run(*task.setup, *task.teardown);
+                }
+            }
+
+            // Expected duration of a test: the time of its last run in this process, or in a previous one
+            static Duration estimate(const ScheduledTest& task, const TimingStore& timings) {
+                auto time = task.test->getExecTimeMs();
+                if (time.count() <= 0) {
+                    timings.find(task.recorder->name(), task.test->getLabel(false), time);
+                }
+                return time;
+            }
+
+            // Keeps the tests selected by the filter of the policy
+            std::vector<ScheduledTest> select_filtered(const std::vector<ScheduledTest>& tasks) const {
+                if (policy_.filter.empty()) {
+                    return tasks;
+                }
+                std::vector<ScheduledTest> selected;
+                const IRegistryRecorder* recorder = nullptr;
+                std::string scenario;
+                for (const auto& task : tasks) {
+                    if (task.recorder != recorder) { // the tasks of a scenario are usually together
+                        recorder = task.recorder;
+                        scenario = scenario_name(recorder->name());
+                    }
+                    if (policy_.filter.matches(scenario, task.test->getLabel(false))) {
+                        selected.push_back(task);
+                    }
+                }
+                return selected;
+            }
+
+            // Moves the tests that did not pass in the last run first, or only keeps them and the
+            // tests unknown to the cache, in the order of the list
+            std::vector<ScheduledTest> order_by_status(std::vector<ScheduledTest> tasks, const StatusCache& statuses) const {
+                if (policy_.order == ExecutionPolicy::Order::REGISTRATION) {
+                    return tasks;
+                }
+                for (auto& task : tasks) {
+                    const auto last = statuses.find(task.recorder->name(), task.test->getLabel(false));
+                    task.failed_last = last != nullptr && is_failure(last->status);
+                    if (policy_.order == ExecutionPolicy::Order::ONLY_FAILED && last == nullptr) {
+                        task.failed_last = true; // new since the last run
+                    }
+                }
+                auto failed_end = std::stable_partition(tasks.begin(), tasks.end(), [](const ScheduledTest& task) { return task.failed_last; });
+                if (policy_.order == ExecutionPolicy::Order::ONLY_FAILED) {
+                    tasks.erase(failed_end, tasks.end());
+                }
+                return tasks;
+            }
+
+            // Keeps the tests of this process' partition, in the order of the list.
+            // Tests never timed are assumed to last as long as the average known test.
+            std::vector<ScheduledTest> select_shard(const std::vector<ScheduledTest>& tasks, const TimingStore& timings) const {
+                if (policy_.shard_count <= 1) {
+                    return tasks;
+                }
+
+                std::vector<Duration> costs(tasks.size(), Duration{ 0 });
+                std::vector<char> timed(tasks.size(), 0);
+                auto known = Duration{ 0 };
+                size_t known_count = 0;
+                for (size_t i = 0; i < tasks.size(); ++i) {
+                    timed[i] = timings.find(tasks[i].recorder->name(), tasks[i].test->getLabel(false), costs[i]);
+                    if (timed[i]) {
+                        known += costs[i];
+                        ++known_count;
+                    }
+                }
+                const auto unknown = known.count() > 0 ? known / static_cast<double>(known_count) : Duration{ 1 };
+                for (size_t i = 0; i < tasks.size(); ++i) {
+                    if (!timed[i]) {
+                        costs[i] = unknown;
+                    }
+                }
+
+                const auto assignment = partition_by_cost(costs, policy_.shard_count);
+                std::vector<ScheduledTest> selected;
+                for (size_t i = 0; i < tasks.size(); ++i) {
+                    if (assignment[i] == policy_.shard_index) {
+                        selected.push_back(tasks[i]);
+                    }
+                }
+                return selected;
+            }
+
+            // A test, or a chunk of a test split in several
+            struct Job {
+                static constexpr size_t whole = static_cast<size_t>(-1);
+                size_t task;
+                size_t chunk;
+            };
+
+            // Job indices owned by a worker
+            struct WorkQueue {
+                std::mutex mutex;
+                std::deque<size_t> tasks;
+            };
+
+            void run_parallel(const std::vector<ScheduledTest>& tasks, const TimingStore& timings, Watchdog* watchdog, const RunControl& control) const {
+                const auto workers = std::max<size_t>(policy_.workers, 1);
+
+                // Longest first, list order between equals
+                std::vector<size_t> order;
+                for (size_t i = 0; i < tasks.size(); ++i) {
+                    if (!tasks[i].test->isSerial()) {
+                        order.push_back(i);
+                    }
+                }
+                std::vector<Duration> costs;
+                for (const auto& task : tasks) {
+                    costs.push_back(estimate(task, timings));
+                }
+                // The tests that failed last time come first anyway
+                std::stable_sort(order.begin(), order.end(), [&tasks, &costs](size_t lhs, size_t rhs) {
+                    if (tasks[lhs].failed_last != tasks[rhs].failed_last) {
+                        return tasks[lhs].failed_last;
+                    }
+                    return costs[lhs] > costs[rhs];
+                });
+                // Tests without a timeout may be split in chunks, spread over the queues like tests
+                std::vector<Job> jobs;
+                std::vector<size_t> chunks_left(tasks.size(), 0);
+                for (auto task : order) {
+                    const auto chunks = tasks[task].timeout.count() > 0 ? 1 : tasks[task].test->split_private(workers * 4);
+                    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                        jobs.push_back({ task, chunks > 1 ? chunk : Job::whole });
+                    }
+                    chunks_left[task] = chunks;
+                }
+                std::vector<WorkQueue> queues(std::min(workers, std::max<size_t>(jobs.size(), 1)));
+                for (size_t i = 0; i < jobs.size(); ++i) {
+                    queues[i % queues.size()].tasks.push_back(i);
+                }
+
+                OrderedCommitter committer{ tasks };
+                size_t completed = 0;
+                size_t running = 0; // workers that did not return yet
+                std::atomic<bool> aborted{ false };
+                std::exception_ptr failure; // setup or teardown may throw
+                std::mutex mutex;
+                std::condition_variable cv;
+
+                auto next_task = [&queues](size_t self, size_t& task) {
+                    {
+                        std::lock_guard<std::mutex> lock(queues[self].mutex);
+                        if (!queues[self].tasks.empty()) {
+                            task = queues[self].tasks.front();
+                            queues[self].tasks.pop_front();
+                            return true;
+                        }
+                    }
+                    for (size_t i = 1; i < queues.size(); ++i) {
+                        auto& victim = queues[(self + i) % queues.size()];
+                        std::lock_guard<std::mutex> lock(victim.mutex);
+                        if (!victim.tasks.empty()) {
+                            task = victim.tasks.back();
+                            victim.tasks.pop_back();
+                            return true;
+                        }
+                    }
+                    return false; // nothing is ever pushed back, so every queue is drained
+                };
+
+                auto worker = [&](size_t self) {
+                    size_t job;
+                    while (!aborted && !control.stopped() && next_task(self, job)) {
+                        const auto task = jobs[job].task;
+                        try {
+                            if (jobs[job].chunk == Job::whole) {
+                                run_one(tasks[task], watchdog);
+                            }
+                            else {
+                                tasks[task].test->run_chunk(*tasks[task].setup, *tasks[task].teardown, jobs[job].chunk);
+                            }
+                        }
+                        catch (...) {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            if (!failure) {
+                                failure = std::current_exception();
+                            }
+                            aborted = true;
+                            --running;
+                            cv.notify_all();
+                            return;
+                        }
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (--chunks_left[task] > 0) {
+                            continue;
+                        }
+                        if (jobs[job].chunk != Job::whole) {
+                            tasks[task].test->merge_chunks_private();
+                        }
+                        committer.set_done(task);
+                        ++completed;
+                        cv.notify_all();
+                    }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    --running;
+                    cv.notify_all();
+                };
+
+                std::vector<std::thread> pool;
+                for (size_t i = 0; i < queues.size() && !order.empty(); ++i) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        ++running;
+                    }
+                    pool.emplace_back(worker, i);
+                }
+                auto join_pool = [&pool]() {
+                    for (auto& thread : pool) {
+                        thread.join();
+                    }
+                    pool.clear();
+                };
+
+                try {
+                    std::vector<size_t> ready;
+                    for (auto finished = false; !finished;) {
+                        ready.clear();
+                        {
+                            std::unique_lock<std::mutex> lock(mutex);
+                            for (;;) {
+                                // Once stopped, the workers return after their current test
+                                finished = aborted || completed == order.size() || running == 0;
+                                committer.collect(ready);
+                                if (finished || !ready.empty()) {
+                                    break;
+                                }
+                                cv.wait(lock);
+                            }
+                        }
+                        committer.record(ready); // observers are not called with the lock held
+                    }
+                    join_pool(); // every concurrent test is done past this point
+
+                    for (size_t i = 0; i < tasks.size() && !aborted && !control.stopped(); ++i) {
+                        if (tasks[i].test->isSerial()) {
+                            run_one(tasks[i], watchdog);
+                            committer.set_done(i);
+                            committer.commit();
+                        }
+                    }
+                }
+                catch (...) {
+                    aborted = true;
+                    join_pool();
+                    throw;
+                }
+
+                join_pool();
+                if (failure) {
+                    std::rethrow_exception(failure);
+                }
+                committer.commit_stopped();
+            }
+
+            ExecutionPolicy policy_;
+        };
+
+        // POD containing informations about a test
+        using TestInfo = std::reference_wrapper<const Test>;
+
+        // Interface for making an observer
+        class IRegistryObserver {
+        public:
+            virtual ~IRegistryObserver() {}
+            virtual void update(TestInfo infos) const = 0;
+            // Called as soon as a test exceeds its timeout, while it may still be running
+            virtual void updateTimeout(TestInfo /*infos*/, Duration /*timeout*/) const {}
+            // Called once the tests of a run are all recorded, must return once every update is delivered
+            virtual void flush() const {}
+        };
+
+        // Implementation of the observable part of the DP observer
+        // Observers can be added or removed from any thread, but not from an update
+        class IRegistryObservable {
+        public:
+            void notify(TestInfo infos) const {
+                std::shared_lock<std::shared_mutex> lock{ observers_mutex_ };
+                for (auto& observer : list_observers_) {
+                    observer->update(infos);
+                }
+            }
+            void notifyTimeout(TestInfo infos, Duration timeout) const {
+                std::shared_lock<std::shared_mutex> lock{ observers_mutex_ };
+                for (auto& observer : list_observers_) {
+                    observer->updateTimeout(infos, timeout);
+                }
+            }
+            void flushObservers() const {
+                std::shared_lock<std::shared_mutex> lock{ observers_mutex_ };
+                for (auto& observer : list_observers_) {
+                    observer->flush();
+                }
+            }
+            void addObserver(const std::shared_ptr<IRegistryObserver>& observer) {
+                std::unique_lock<std::shared_mutex> lock{ observers_mutex_ };
+                list_observers_.insert(observer);
+            }
+            void removeObserver(const std::shared_ptr<IRegistryObserver>& observer) {
+                std::unique_lock<std::shared_mutex> lock{ observers_mutex_ };
+                list_observers_.erase(observer);
+            }
+        private:
+            std::set<std::shared_ptr<IRegistryObserver>> list_observers_;
+            mutable std::shared_mutex observers_mutex_;
+        };
+
+        // Bounded lock-free queue for several producers and a single consumer
+        // Each cell carries a sequence number telling whether it is free for the
+        // producer of a given position or ready for the consumer
+        template<class T>
+        class BoundedQueue {
+        public:
+            BoundedQueue(size_t capacity) : mask_(round_capacity(capacity) - 1), cells_(new Cell[mask_ + 1]), enqueue_pos_(0), dequeue_pos_(0) {
+                for (size_t i = 0; i <= mask_; ++i) {
+                    cells_[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            BoundedQueue(const BoundedQueue&) = delete;
+            BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+            size_t capacity() const { return mask_ + 1; }
+
+            // Returns false when the queue is full
+            bool try_push(const T& value) {
+                auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+                Cell* cell;
+                for (;;) {
+                    cell = &cells_[pos & mask_];
+                    const auto sequence = cell->sequence.load(std::memory_order_acquire);
+                    const auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+                    if (diff == 0) {
+                        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            break;
+                        }
+                    }
+                    else if (diff < 0) {
+                        return false;
+                    }
+                    else {
+                        pos = enqueue_pos_.load(std::memory_order_relaxed);
+                    }
+                }
+                cell->value = value;
+                cell->sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+
+            // Returns false when the queue is empty, only to be called by the consumer
+            bool try_pop(T& value) {
+                const auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+                auto& cell = cells_[pos & mask_];
+                if (cell.sequence.load(std::memory_order_acquire) != pos + 1) {
+                    return false;
+                }
+                value = cell.value;
+                cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+                return true;
+            }
+
+        private:
+            struct Cell {
+                std::atomic<size_t> sequence;
+                T value;
+            };
+
+            static size_t round_capacity(size_t capacity) {
+                size_t rounded = 2;
+                while (rounded < capacity) {
+                    rounded <<= 1;
+                }
+                return rounded;
+            }
+
+            const size_t mask_;
+            std::unique_ptr<Cell[]> cells_;
+            // Producers and consumer work on different cache lines
+            alignas(64) std::atomic<size_t> enqueue_pos_;
+            alignas(64) std::atomic<size_t> dequeue_pos_;
+        };
+
+        // Owns the tests of a scenario.
+        // Tests are constructed in place in a chain of geometrically growing blocks, so that
+        // registering a whole scenario costs a handful of allocations and its tests are laid
+        // out contiguously, in registration order, when iterated.
+        class TestList {
+        public:
+
+            using const_iterator = std::vector<Test*>::const_iterator;
+
+            TestList() = default;
+
+            TestList(const TestList&) = delete;
+            TestList& operator=(const TestList&) = delete;
+
+            TestList(TestList&& list) noexcept
+                : blocks_(std::move(list.blocks_)), tests_(std::move(list.tests_))
+            {
+                list.blocks_.clear();
+                list.tests_.clear();
+            }
+
+            TestList& operator=(TestList&& list) noexcept {
+                std::swap(blocks_, list.blocks_);
+                std::swap(tests_, list.tests_);
+                return *this;
+            }
+
+            ~TestList() {
+                for (auto it = tests_.rbegin(); it != tests_.rend(); ++it) {
+                    (*it)->~Test();
+                }
+            }
+
+            // Construct a test (or a class derived from Test) at the end of the list
+            template<class TestType = Test, class... Args>
+            TestType& emplace(Args&&... args) {
+                if (tests_.size() == tests_.capacity()) {
+                    tests_.reserve(std::max<size_t>(16, tests_.size() * 2)); // nothing can throw past the construction
+                }
+                auto test = new (allocate(sizeof(TestType), alignof(TestType))) TestType(std::forward<Args>(args)...);
+                tests_.push_back(test);
+                return *test;
+            }
+
+            // Expected number of tests, saves the reallocations of the index
+            void reserve(size_t count) { tests_.reserve(count); }
+
+            size_t size() const { return tests_.size(); }
+            bool empty() const { return tests_.empty(); }
+            Test* operator[](size_t index) const { return tests_[index]; }
+            const_iterator begin() const { return tests_.begin(); }
+            const_iterator end() const { return tests_.end(); }
+
+        private:
+
+            struct Block {
+                std::unique_ptr<unsigned char[]> data;
+                size_t size;
+                size_t used;
+            };
+
+            void* allocate(size_t size, size_t alignment) {
+                if (!blocks_.empty()) {
+                    auto& block = blocks_.back();
+                    void* position = block.data.get() + block.used;
+                    auto space = block.size - block.used;
+                    if (std::align(alignment, size, position, space)) {
+                        block.used = block.size - space + size;
+                        return position;
+                    }
+                }
+                const auto block_size = std::max<size_t>(blocks_.empty() ? first_block_size : 2 * blocks_.back().size, size + alignment);
+                blocks_.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[block_size]), block_size, 0 });
+                return allocate(size, alignment);
+            }
+
+            static const size_t first_block_size = 4096;
+
+            std::vector<Block> blocks_;
+            std::vector<Test*> tests_;
+        };
+
+        // Fixture built on first use and then shared by the tests, whatever the thread they run on:
+        //     SharedFixture<Dataset> dataset{ []() { return std::make_unique<Dataset>("data.bin"); } };
+        //     add_test("Rows", []() { AssertThat(dataset->rows()).isEqualTo(42, "Expect 42 rows"); });
+        //     tear_down_scenario([]() { dataset.reset(); });
+        // When the factory throws, the test using it is in ERROR and the next use tries again.
+        // Built once per worker process in process mode, unless built before the run.
+        template<class T>
+        class SharedFixture {
+        public:
+            using Factory = std::function<std::unique_ptr<T>()>;
+
+            SharedFixture() : SharedFixture([]() { return std::make_unique<T>(); }) {}
+            SharedFixture(Factory factory) : factory_(std::move(factory)), built_(nullptr) {}
+
+            SharedFixture(const SharedFixture&) = delete;
+            SharedFixture& operator=(const SharedFixture&) = delete;
+
+            // Only the first use takes the lock
+            T& get() const {
+                auto value = built_.load(std::memory_order_acquire);
+                if (value == nullptr) {
+                    std::lock_guard<std::mutex> lock{ mutex_ };
+                    value = built_.load(std::memory_order_relaxed);
+                    if (value == nullptr) {
+                        value_ = factory_();
+                        value = value_.get();
+                        if (value == nullptr) {
+                            throw std::runtime_error{ "The factory of a shared fixture returned null" };
+                        }
+                        built_.store(value, std::memory_order_release);
+                    }
+                }
+                return *value;
+            }
+
+            T& operator*() const { return get(); }
+            T* operator->() const { return &get(); }
+
+            bool isBuilt() const { return built_.load(std::memory_order_acquire) != nullptr; }
+
+            // Destroys the fixture, the next use builds it again; not while tests use it
+            void reset() {
+                std::lock_guard<std::mutex> lock{ mutex_ };
+                built_.store(nullptr, std::memory_order_release);
+                value_.reset();
+            }
+
+        private:
+            Factory factory_;
+            mutable std::unique_ptr<T> value_;
+            mutable std::atomic<T*> built_;
+            mutable std::mutex mutex_;
+        };
+
+        // Results recorded by a registry as packed columns, one row per result in the order they were
+        // recorded: summaries and filters scan the statuses and times without touching the tests.
+        // A row keeps the status and time the test had when it was recorded.
+        class ResultTable {
+        public:
+            static constexpr size_t status_count = static_cast<size_t>(Test::Status::NONE) + 1;
+
+            void reserve(size_t rows) {
+                tests_.reserve(rows);
+                statuses_.reserve(rows);
+                exec_times_ms_.reserve(rows);
+            }
+
+            void push(const Test& test) {
+                tests_.push_back(&test);
+                statuses_.push_back(static_cast<uint8_t>(test.getStatus()));
+                exec_times_ms_.push_back(test.getExecTimeMs().count());
+            }
+
+            size_t size() const { return tests_.size(); }
+            size_t capacity() const { return tests_.capacity(); }
+            const Test& test(size_t row) const { return *tests_[row]; }
+            Test::Status status(size_t row) const { return static_cast<Test::Status>(statuses_[row]); }
+            Duration exec_time(size_t row) const { return Duration{ exec_times_ms_[row] }; }
+
+            // Calls visitor(row) on the rows from first with the given status
+            template<class Visitor>
+            void visit(Test::Status status, Visitor&& visitor, size_t first = 0) const {
+                const auto value = static_cast<uint8_t>(status);
+                for (auto row = first; row < statuses_.size(); ++row) {
+                    if (statuses_[row] == value) {
+                        visitor(row);
+                    }
+                }
+            }
+
+            Duration exec_time(Test::Status status) const {
+                Duration total{ 0 };
+                visit(status, [this, &total](size_t row) { total += exec_time(row); });
+                return total;
+            }
+
+        private:
+            std::vector<const Test*> tests_;
+            std::vector<uint8_t> statuses_;
+            std::vector<double> exec_times_ms_;
+        };
+
+        // Everything registered for a scenario, kept together
+        struct ScenarioSlot {
+            explicit ScenarioSlot(std::type_index type)
+                : type(type), setup([]() {}), teardown([]() {}), recorder(nullptr) {}
+
+            ScenarioSlot(const ScenarioSlot&) = delete;
+            ScenarioSlot& operator=(const ScenarioSlot&) = delete;
+
+            std::type_index type;
+            TestList tests;
+            SetUpFunctor setup;
+            TearDownFunctor teardown;
+            // Empty unless the scenario set one
+            SetUpFunctor scenario_setup;
+            TearDownFunctor scenario_teardown;
+            // The AsyncFixtures of a scenario with coroutine tests, null otherwise. Type erased,
+            // so the slot is the same for the translation units built without coroutines
+            std::shared_ptr<void> async_fixtures;
+            IRegistryRecorder* recorder;
+        };
+
+        using SlotStorage = std::vector<std::unique_ptr<ScenarioSlot>>;
+
+        // Global static registry storage object
+        // Slots are created once per scenario, in registration order, and never move:
+        // a RegistryManager resolves its own when it is constructed and keeps it
+        class RegistryStorage {
+        public:
+
+            ScenarioSlot& getSlot(std::type_index index) {
+                auto it = index_.find(index);
+                if (it != index_.end()) {
+                    return *slots_[it->second];
+                }
+                index_.emplace(index, slots_.size());
+                slots_.push_back(std::make_unique<ScenarioSlot>(index));
+                return *slots_.back();
+            }
+
+            TestList& getTests(std::type_index index) { return getSlot(index).tests; }
+            SetUpFunctor& getSetUp(std::type_index index) { return getSlot(index).setup; }
+            TearDownFunctor& getTearDown(std::type_index index) { return getSlot(index).teardown; }
+            SetUpFunctor& getScenarioSetUp(std::type_index index) { return getSlot(index).scenario_setup; }
+            TearDownFunctor& getScenarioTearDown(std::type_index index) { return getSlot(index).scenario_teardown; }
+
+            const SlotStorage& getAllSlots() const { return slots_; }
+
+        private:
+
+            SlotStorage slots_;
+            std::map<std::type_index, size_t> index_;
+
+        };
+
+#if H2OFT_DEFINE_FUNCTIONS_
+        H2OFT_INLINE RegistryStorage& get_registry() {
+            static RegistryStorage registry;
+            return registry;
+        }
+#else
+        RegistryStorage& get_registry();
+#endif
+
+        // Manage a registry in a static context
+        template<class ScenarioName>
+        class RegistryManager : public IRegistryObservable, private IRegistryRecorder {
+        public:
+
+            using FeederFunctor = std::function<void(void)>;
+
+            RegistryManager(FeederFunctor feeder)
+                : slot_(get_registry().getSlot(type_helper<ScenarioName>::type_index())),
+                run_(false), retained_(true), recorded_counts_(), exec_time_ms_accumulator_(Duration{ 0 }), setup_time_ms_accumulator_(Duration{ 0 }),
+                teardown_time_ms_accumulator_(Duration{ 0 }), viewed_rows_(), timeout_(Duration{ 0 }) {
+                feeder();
+                slot_.recorder = this;
+            }
+
+            RegistryManager(const RegistryManager&) = delete;
+            RegistryManager& operator=(const RegistryManager&) = delete;
+
+            virtual ~RegistryManager() {
+                if (slot_.recorder == this) {
+                    slot_.recorder = nullptr;
+                }
+            }
+
+            void add_test(Test&& test) {
+                tests().emplace(std::move(test));
+            }
+
+            void add_test(TestFunctor&& func) {
+                tests().emplace(std::move(func));
+            }
+
+            void add_test(const std::string& label, TestFunctor&& func) {
+                tests().emplace(label, std::move(func));
+            }
+
+            // The test is TIMEOUT once it runs for longer than timeout
+            void add_test(const std::string& label, Duration timeout, TestFunctor&& func) {
+                tests().emplace(label, std::move(func)).timeout_ = timeout;
+            }
+
+            // The test FAILED when its body allocates more than budget allows
+            // Only checked with the allocation hooks linked in, see AllocationCounter
+            void add_test(const std::string& label, const AllocationBudget& budget, TestFunctor&& func) {
+                tests().emplace(label, std::move(func)).allocation_budget_ = budget;
+            }
+
+#if H2OFT_HAS_COROUTINES_
+            // Coroutine test, its body returns a Task, see AsyncTest
+            template <typename Func, typename = typename std::enable_if<std::is_same<typename std::invoke_result<Func&>::type, Task>::value>::type>
+            void add_test(const std::string& label, Func&& func) {
+                auto& fixtures = async_fixtures();
+                tests().template emplace<AsyncTest>(label, AsyncTest::Body{ std::forward<Func>(func) }, &fixtures.setup, &fixtures.teardown);
+            }
+
+            template <typename Func, typename = typename std::enable_if<std::is_same<typename std::invoke_result<Func&>::type, Task>::value>::type>
+            void add_test(const std::string& label, Duration timeout, Func&& func) {
+                auto& fixtures = async_fixtures();
+                tests().template emplace<AsyncTest>(label, AsyncTest::Body{ std::forward<Func>(func) }, &fixtures.setup, &fixtures.teardown).timeout_ = timeout;
+            }
+
+            // Awaited by each coroutine test of the scenario after set_up, and before tear_down
+            void set_up_async(AsyncTest::Body&& func) {
+                async_fixtures().setup = std::move(func);
+            }
+
+            void tear_down_async(AsyncTest::Body&& func) {
+                async_fixtures().teardown = std::move(func);
+            }
+#endif
+
+            void skip_test(TestFunctor&& func) {
+                tests().template emplace<SkippedTest>(std::move(func));
+            }
+
+            void skip_test(const std::string& label, TestFunctor&& func) {
+                tests().template emplace<SkippedTest>(label, std::move(func));
+            }
+
+            void skip_test(const std::string& reason, const std::string& label, TestFunctor&& func) {
+                tests().template emplace<SkippedTest>(reason, label, std::move(func));
+            }
+
+            void set_up(SetUpFunctor&& func) {
+                slot_.setup = std::move(func);
+            }
+
+            void tear_down(TearDownFunctor&& func) {
+                slot_.teardown = std::move(func);
+            }
+
+            // Called once on the calling thread before the first test of a run, and after the last one
+            // When it throws, the tests of the run are in ERROR and the tear down is not called
+            void set_up_scenario(SetUpFunctor&& func) {
+                slot_.scenario_setup = std::move(func);
+            }
+
+            void tear_down_scenario(TearDownFunctor&& func) {
+                slot_.scenario_teardown = std::move(func);
+            }
+
+            // Timeout of the tests of the scenario without their own, 0 for the policy's
+            // Set it from the feeder, before the tests run
+            void set_timeout(Duration timeout) {
+                timeout_ = timeout;
+            }
+
+            // Unless retained, results are only counted: visit and the lists of tests by status see none
+            // of them, and their messages are freed once the observers got them at the end of the run.
+            // Meant for huge runs streamed to a BinaryResultLog, set it before the tests run.
+            void set_results_retained(bool retained) {
+                retained_ = retained;
+            }
+
+            void add_serial_test(const std::string& label, TestFunctor&& func) {
+                tests().emplace(label, std::move(func)).serial_ = true;
+            }
+
+            void add_benchmark(const std::string& label, TestFunctor&& func) {
+                tests().template emplace<BenchmarkTest>(label, std::move(func));
+            }
+
+            void add_benchmark(const std::string& label, const BenchmarkOptions& options, TestFunctor&& func) {
+                tests().template emplace<BenchmarkTest>(label, options, std::move(func));
+            }
+
+            // Runs func(parameter) on every case of range, see ParameterizedTest and range, generate, values, lines_of
+            template<class Param, class Func>
+            void add_parameterized_test(const std::string& label, ParameterRange<Param> range, Func&& func) {
+                tests().template emplace<ParameterizedTest<Param>>(label, std::move(range), typename ParameterizedTest<Param>::CaseFunctor{ std::forward<Func>(func) });
+            }
+
+            // labeller(number, parameter) names the first case that did not pass
+            template<class Param, class Func, class Labeller>
+            void add_parameterized_test(const std::string& label, ParameterRange<Param> range, Func&& func, Labeller&& labeller) {
+                tests().template emplace<ParameterizedTest<Param>>(label, std::move(range), typename ParameterizedTest<Param>::CaseFunctor{ std::forward<Func>(func) },
+                    typename ParameterizedTest<Param>::LabelFunctor{ std::forward<Labeller>(labeller) });
+            }
+
+            // Run all the tests
+            void run_tests() {
+                run_tests(ExecutionPolicy::sequential());
+            }
+
+            void run_tests(const ExecutionPolicy& policy) {
+                std::vector<ScheduledTest> tasks;
+                tasks.reserve(slot_.tests.size());
+                for (auto test : slot_.tests) {
+                    tasks.push_back({ test, &slot_.setup, &slot_.teardown, this });
+                }
+                TestScheduler{ policy }.run(tasks);
+                set_run();
+            }
+
+            // describe test suite
+            virtual void describe() {}
+
+            // Get informations
+
+            // Call visitor(const Test&) on every result recorded so far, grouped by status
+            // (passed, failed, slow, timed out, skipped then with error), without copying them
+            // Safe to call from several reporters at once, even while the tests run
+            template<class Visitor>
+            void visit(Visitor&& visitor) const {
+                std::shared_lock<std::shared_mutex> lock{ results_mutex_ };
+                for (auto status : { Test::Status::PASSED, Test::Status::FAILED, Test::Status::SLOW, Test::Status::TIMEOUT, Test::Status::SKIPPED, Test::Status::ERROR }) {
+                    results_.visit(status, [this, &visitor](size_t row) { visitor(results_.test(row)); });
+                }
+            }
+
+            // Call visitor(const Test&) on every result recorded so far with the given status
+            template<class Visitor>
+            void visit(Test::Status status, Visitor&& visitor) const {
+                std::shared_lock<std::shared_mutex> lock{ results_mutex_ };
+                results_.visit(status, [this, &visitor](size_t row) { visitor(results_.test(row)); });
+            }
+
+            // Time of the bodies of the results recorded so far with the given status
+            Duration getRecordedExecTimeMs(Test::Status status) const {
+                std::shared_lock<std::shared_mutex> lock{ results_mutex_ };
+                return results_.exec_time(status);
+            }
+
+            // Number of results recorded so far with the given status
+            size_t getRecordedCount(Test::Status status) const {
+                std::shared_lock<std::shared_mutex> lock{ results_mutex_ };
+                return recorded_counts_[static_cast<size_t>(status)];
+            }
+
+            // The lists of tests by status are built from the results on first use, and extended with
+            // the results recorded since on the next ones: prefer visit while the tests run
+            size_t getPassedCount() const { return run_count(Test::Status::PASSED); }
+            const std::vector<std::reference_wrapper<const Test>>& getPassedTests() const { return results(Test::Status::PASSED); }
+
+            size_t getFailedCount() const { return run_count(Test::Status::FAILED); }
+            const std::vector<std::reference_wrapper<const Test >>& getFailedTests() const { return results(Test::Status::FAILED); }
+
+            size_t getSkippedCount() const { return run_count(Test::Status::SKIPPED); }
+            const std::vector<std::reference_wrapper<const Test>>& getSkippedTests() const { return results(Test::Status::SKIPPED); }
+
+            size_t getWithErrorCount() const { return run_count(Test::Status::ERROR); }
+            const std::vector<std::reference_wrapper<const Test>>& getWithErrorTests() const { return results(Test::Status::ERROR); }
+
+            size_t getSlowCount() const { return run_count(Test::Status::SLOW); }
+            const std::vector<std::reference_wrapper<const Test>>& getSlowTests() const { return results(Test::Status::SLOW); }
+
+            size_t getTimedOutCount() const { return run_count(Test::Status::TIMEOUT); }
+            const std::vector<std::reference_wrapper<const Test>>& getTimedOutTests() const { return results(Test::Status::TIMEOUT); }
+
+            // Tests left out of the run: filtered out, or not run once it was stopped
+            size_t getNotRunCount() const {
+                std::shared_lock<std::shared_mutex> lock{ results_mutex_ };
+                if (!run_) {
+                    return 0;
+                }
+                size_t recorded = 0;
+                for (auto status : { Test::Status::PASSED, Test::Status::FAILED, Test::Status::SLOW, Test::Status::TIMEOUT, Test::Status::SKIPPED, Test::Status::ERROR }) {
+                    recorded += recorded_counts_[static_cast<size_t>(status)];
+                }
+                const auto all = getAllTests().size();
+                return all > recorded ? all - recorded : 0;
+            }
+
+            size_t getAllTestsCount() const { return is_run() ? slot_.tests.size() : 0; }
+            const TestList& getAllTests() const { return slot_.tests; }
+            Duration getAllTestsExecTimeMs() const {
+                std::shared_lock<std::shared_mutex> lock{ results_mutex_ };
+                return run_ ? exec_time_ms_accumulator_ : Duration{ 0 };
+            }
+            // Time spent in the set up and tear down around the tests, apart from their bodies
+            Duration getAllSetUpTimeMs() const {
+                std::shared_lock<std::shared_mutex> lock{ results_mutex_ };
+                return run_ ? setup_time_ms_accumulator_ : Duration{ 0 };
+            }
+            Duration getAllTearDownTimeMs() const {
+                std::shared_lock<std::shared_mutex> lock{ results_mutex_ };
+                return run_ ? teardown_time_ms_accumulator_ : Duration{ 0 };
+            }
+
+        private:
+
+            TestList& tests() { return slot_.tests; }
+
+#if H2OFT_HAS_COROUTINES_
+            // Created with the first coroutine test or asynchronous fixture, and never moved
+            AsyncFixtures& async_fixtures() {
+                if (!slot_.async_fixtures) {
+                    slot_.async_fixtures = std::make_shared<AsyncFixtures>();
+                }
+                return *static_cast<AsyncFixtures*>(slot_.async_fixtures.get());
+            }
+#endif
+
+            const std::vector<std::reference_wrapper<const Test>>& results(Test::Status status) const {
+                std::shared_lock<std::shared_mutex> lock{ results_mutex_ };
+                std::lock_guard<std::mutex> views_lock{ views_mutex_ };
+                const auto index = static_cast<size_t>(status);
+                auto& view = views_[index];
+                results_.visit(status, [this, &view](size_t row) { view.push_back(std::cref(results_.test(row))); }, viewed_rows_[index]);
+                viewed_rows_[index] = results_.size();
+                return view;
+            }
+
+            bool is_run() const {
+                std::shared_lock<std::shared_mutex> lock{ results_mutex_ };
+                return run_;
+            }
+
+            size_t run_count(Test::Status status) const {
+                std::shared_lock<std::shared_mutex> lock{ results_mutex_ };
+                return run_ ? recorded_counts_[static_cast<size_t>(status)] : 0;
+            }
+
+            virtual void set_run() override {
+                {
+                    std::unique_lock<std::shared_mutex> lock{ results_mutex_ };
+                    run_ = true;
+                }
+                flushObservers();
+                // Every update is delivered, asynchronous ones included
+                if (!retained_) {
+                    for (auto test : slot_.tests) {
+                        test->release_messages();
+                    }
+                }
+            }
+            virtual const char* name() const override { return type_helper<ScenarioName>::name(); }
+            virtual Duration timeout() const override { return timeout_; }
+            virtual void print_results(bool verbose) const override {
+                RegistryTraversal_ConsoleIO<ScenarioName>{ *this }.print(verbose);
+            }
+            virtual void begin_scenario() override {
+                if (slot_.scenario_setup) {
+                    slot_.scenario_setup();
+                }
+            }
+            virtual void end_scenario() override {
+                if (slot_.scenario_teardown) {
+                    slot_.scenario_teardown();
+                }
+            }
+            virtual void report_timeout(const Test& test, Duration timeout) override {
+                notifyTimeout(TestInfo{ test }, timeout);
+            }
+
+            // Notify the observers and store the result of a test that was just run
+            virtual void record_result(const Test& test) override {
+                notify(TestInfo{ test });
+                std::unique_lock<std::shared_mutex> lock{ results_mutex_ };
+                exec_time_ms_accumulator_ += test.getExecTimeMs();
+                setup_time_ms_accumulator_ += test.getSetUpTimeMs();
+                teardown_time_ms_accumulator_ += test.getTearDownTimeMs();
+                ++recorded_counts_[static_cast<size_t>(test.getStatus())];
+                if (!retained_) {
+                    return;
+                }
+                // Room for a whole run at once, writers then hold the lock for a few stores
+                if (results_.size() == results_.capacity()) {
+                    results_.reserve(std::max(results_.size() + slot_.tests.size(), 2 * results_.size()));
+                }
+                results_.push(test);
+            }
+
+            ScenarioSlot& slot_;
+            bool run_;
+            bool retained_;
+            size_t recorded_counts_[ResultTable::status_count]; // by status
+            Duration exec_time_ms_accumulator_;
+            Duration setup_time_ms_accumulator_;
+            Duration teardown_time_ms_accumulator_;
+            ResultTable results_;
+            mutable std::shared_mutex results_mutex_;
+            // Lists of tests by status, see getPassedTests
+            mutable std::vector<std::reference_wrapper<const Test>> views_[ResultTable::status_count];
+            mutable size_t viewed_rows_[ResultTable::status_count];
+            mutable std::mutex views_mutex_;
+            Duration timeout_;
+
+        };
+
+        // Run the tests of every registered scenario together
+#if H2OFT_DEFINE_FUNCTIONS_
+        H2OFT_INLINE void run_all_tests(const ExecutionPolicy& policy) {
+            std::vector<ScheduledTest> tasks;
+            std::vector<IRegistryRecorder*> recorders;
+            for (const auto& slot : get_registry().getAllSlots()) {
+                if (slot->recorder == nullptr) {
+                    continue;
+                }
+                for (auto test : slot->tests) {
+                    tasks.push_back({ test, &slot->setup, &slot->teardown, slot->recorder });
+                }
+                recorders.push_back(slot->recorder);
+            }
+            TestScheduler{ policy }.run(tasks);
+            for (auto recorder : recorders) {
+                recorder->set_run();
+            }
+        }
+#else
+        void run_all_tests(const ExecutionPolicy& policy);
+#endif
+    }
+
+    /*
+    *
+    * Public interface
+    *
+    */
+
+    // Public accessible types
+    using detail::LineInfo;
+    using detail::TestInfo;
+    using detail::Test;
+    using detail::RegistryStorage;
+    using detail::IRegistryObserver;
+    using detail::ExecutionPolicy;
+    using detail::CancellationToken;
+    using detail::TestFilter;
+    using detail::Duration;
+    using detail::BenchmarkOptions;
+    using detail::BenchmarkStats;
+    using detail::AllocationBudget;
+    using detail::AllocationStats;
+    using detail::PerfStats;
+    using detail::ParameterSource;
+    template<class Param>
+    using ParameterRange = detail::ParameterRange<Param>;
+    using detail::range;
+    using detail::generate;
+    using detail::values;
+    using detail::lines_of;
+    using detail::run_all_tests;
+    using detail::parse_command_line;
+    template<class ScenarioName>
+    using RegistryManager = detail::RegistryManager<ScenarioName>;
+    template<class T>
+    using SharedFixture = detail::SharedFixture<T>;
+#if H2OFT_HAS_COROUTINES_
+    using detail::Task;
+    using detail::AsyncTest;
+
+    // Awaitables of the coroutine tests
+    namespace Async {
+        using detail::sleep_for;
+        using detail::yield;
+#if H2OFT_HAS_POLL_
+        using detail::readable;
+        using detail::writable;
+#endif
+    }
+#endif
+
+    // Asserter exposition
+    namespace Asserter {
+        using detail::AsserterExpression;
+        using detail::AssertThat;
+        using detail::ExpectThat;
+    }
+
+    // Benchmark helpers
+#if defined(__GNUC__) || defined(__clang__)
+    // Keeps the compiler from optimizing away the computation of value
+    template<class T>
+    inline void DoNotOptimize(const T& value) { asm volatile("" : : "r,m"(value) : "memory"); }
+    template<class T>
+    inline void DoNotOptimize(T& value) { asm volatile("" : "+m"(value) : : "memory"); }
+    // Keeps the compiler from optimizing away or reordering the writes to memory
+    inline void ClobberMemory() { asm volatile("" : : : "memory"); }
+#else
+    namespace detail {
+        inline const volatile char* volatile benchmark_sink = nullptr;
+    }
+    // Keeps the compiler from optimizing away the computation of value
+    template<class T>
+    inline void DoNotOptimize(const T& value) {
+        detail::benchmark_sink = &reinterpret_cast<const volatile char&>(value);
+#   if defined(_MSC_VER)
+        _ReadWriteBarrier();
+#   endif
+    }
+    // Keeps the compiler from optimizing away or reordering the writes to memory
+    inline void ClobberMemory() {
+#   if defined(_MSC_VER)
+        _ReadWriteBarrier();
+#   else
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+#   endif
+    }
+#endif
+
+    // Interface to Implement to access access a registry information
+    // Possibility to export services into a DLL for forther customization
+    // Does not own nor copy the registry : it must outlive the traversal
+    template<class ScenarioName>
+    class IRegistryTraversal {
+    public:
+        IRegistryTraversal(const RegistryManager<ScenarioName>& registry) : registry_(registry) {}
+        virtual ~IRegistryTraversal() {}
+    protected:
+        const RegistryManager<ScenarioName>& getRegistryManager() const { return registry_; }
+
+        // See RegistryManager::visit
+        template<class Visitor>
+        void visit(Visitor&& visitor) const { registry_.visit(std::forward<Visitor>(visitor)); }
+        template<class Visitor>
+        void visit(Test::Status status, Visitor&& visitor) const { registry_.visit(status, std::forward<Visitor>(visitor)); }
+    private:
+        const RegistryManager<ScenarioName>& registry_;
+    };
+
+    // Colored console output formatted into a reusable buffer and written with one call per batch
+    // The batch is written once it holds capacity bytes, once flush_interval elapsed since the last
+    // write, on flush() and on destruction
+    class ConsoleBuffer {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        ConsoleBuffer(FILE* stream = stdout, size_t capacity = 64 * 1024, std::chrono::milliseconds flush_interval = std::chrono::milliseconds{ 100 })
+            : stream_(stream), buffer_(capacity + 1), size_(0), capacity_(capacity), flush_interval_(flush_interval), last_flush_(Clock::now()),
+            use_color_(ShouldUseColor(posix::IsATTY(posix::FileNo(stream)) != 0)), use_ansi_(true) {
+#if H2OFT_OS_WINDOWS_DESKTOP
+            // Consoles without virtual terminal support fall back to one attribute change per colored run
+            console_ = reinterpret_cast<HANDLE>(_get_osfhandle(posix::FileNo(stream)));
+            DWORD mode = 0;
+            if (use_color_ && GetConsoleMode(console_, &mode)) {
+                use_ansi_ = SetConsoleMode(console_, mode | 0x0004 /* ENABLE_VIRTUAL_TERMINAL_PROCESSING */) != 0;
+                CONSOLE_SCREEN_BUFFER_INFO buffer_info;
+                GetConsoleScreenBufferInfo(console_, &buffer_info);
+                default_attributes_ = buffer_info.wAttributes;
+            }
+#endif
+        }
+
+        ConsoleBuffer(const ConsoleBuffer&) = delete;
+        ConsoleBuffer& operator=(const ConsoleBuffer&) = delete;
+
+        ~ConsoleBuffer() { flush(); }
+
+        void setCapacity(size_t capacity) {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            capacity_ = capacity;
+            if (buffer_.size() < capacity_ + 1) {
+                buffer_.resize(capacity_ + 1);
+            }
+        }
+
+        void setFlushInterval(std::chrono::milliseconds flush_interval) {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            flush_interval_ = flush_interval;
+        }
+
+        H2OFT_PRINTF_FORMAT_(3, 4) void printf(H2OFTColor color, const char* fmt, ...) {
+            va_list args;
+            va_start(args, fmt);
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            const bool colored = use_color_ && color != COLOR_DEFAULT;
+            if (colored) {
+                begin_color(color);
+            }
+            append(fmt, args);
+            if (colored) {
+                end_color();
+            }
+            va_end(args);
+            if (size_ >= capacity_ || Clock::now() - last_flush_ >= flush_interval_) {
+                write();
+            }
+        }
+
+        void flush() {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            write();
+        }
+
+    private:
+        void append(const char* fmt, va_list args) {
+            va_list retry;
+            va_copy(retry, args);
+            const auto written = std::vsnprintf(buffer_.data() + size_, buffer_.size() - size_, fmt, args);
+            if (written > 0) {
+                if (size_ + written >= buffer_.size()) {
+                    // Grow once for this batch, the buffer is reused by the next ones
+                    buffer_.resize(size_ + written + 1);
+                    std::vsnprintf(buffer_.data() + size_, buffer_.size() - size_, fmt, retry);
+                }
+                size_ += written;
+            }
+            va_end(retry);
+        }
+
+        H2OFT_PRINTF_FORMAT_(2, 3) void append_raw(const char* fmt, ...) {
+            va_list args;
+            va_start(args, fmt);
+            append(fmt, args);
+            va_end(args);
+        }
+
+        void begin_color(H2OFTColor color) {
+            if (use_ansi_) {
+                append_raw("\033[0;3%sm", GetAnsiColorCode(color));
+            }
+#if H2OFT_OS_WINDOWS_DESKTOP
+            else {
+                colored_runs_.push_back({ size_, color });
+            }
+#endif
+        }
+
+        void end_color() {
+            if (use_ansi_) {
+                append_raw("\033[m");
+            }
+#if H2OFT_OS_WINDOWS_DESKTOP
+            else {
+                colored_runs_.push_back({ size_, COLOR_DEFAULT });
+            }
+#endif
+        }
+
+        void write() {
+            if (size_ > 0) {
+#if H2OFT_OS_WINDOWS_DESKTOP
+                if (!colored_runs_.empty()) {
+                    write_colored_runs();
+                }
+                else
+#endif
+                {
+                    std::fwrite(buffer_.data(), 1, size_, stream_);
+                    std::fflush(stream_);
+                }
+                size_ = 0;
+            }
+            last_flush_ = Clock::now();
+        }
+
+#if H2OFT_OS_WINDOWS_DESKTOP
+        void write_colored_runs() {
+            size_t begin = 0;
+            for (const auto& run : colored_runs_) {
+                std::fwrite(buffer_.data() + begin, 1, run.first - begin, stream_);
+                std::fflush(stream_);
+                SetConsoleTextAttribute(console_, run.second == COLOR_DEFAULT ? default_attributes_ : GetForegroundColorAttribute(run.second) | FOREGROUND_INTENSITY);
+                begin = run.first;
+            }
+            std::fwrite(buffer_.data() + begin, 1, size_ - begin, stream_);
+            std::fflush(stream_);
+            colored_runs_.clear();
+        }
+
+        HANDLE console_;
+        WORD default_attributes_ = 0;
+        std::vector<std::pair<size_t, H2OFTColor>> colored_runs_;
+#endif
+
+        FILE* stream_;
+        std::vector<char> buffer_;
+        size_t size_;
+        size_t capacity_;
+        std::chrono::milliseconds flush_interval_;
+        Clock::time_point last_flush_;
+        bool use_color_;
+        bool use_ansi_;
+        std::mutex mutex_;
+    };
+
+    // Buffer shared by the console reporters so that their outputs keep their order
+#if H2OFT_DEFINE_FUNCTIONS_
+    H2OFT_INLINE ConsoleBuffer& get_console_buffer() {
+        static ConsoleBuffer console_buffer;
+        return console_buffer;
+    }
+#else
+    ConsoleBuffer& get_console_buffer();
+#endif
+
+    // Binary result log of a run, appended through a mapping as the results are recorded, so
+    // that huge runs need not keep them in memory, see RegistryManager::set_results_retained:
+    //     <path>          ResultLogHeader, then one ResultRecord per result
+    //     <path>.strings  the labels, messages and benchmark statistics the records point to
+    // The header is written after each record: the log of a crashed run holds every result
+    // recorded before the crash. Read it back with ResultLogReader.
+    struct ResultLogHeader {
+        static constexpr uint32_t current_version = 1;
+
+        char magic[8];         // "H2OFTLOG"
+        uint32_t version;
+        uint32_t record_size;
+        uint64_t records;
+        uint64_t string_bytes;
+    };
+
+    struct ResultRecord {
+        static constexpr uint64_t none = ~uint64_t{ 0 };
+
+        uint64_t label;        // offsets in the string table
+        uint64_t message;      // the failure reason, skipped reason or error, by status
+        uint64_t benchmark;    // the BenchmarkStats, none for other tests
+        uint32_t label_size;
+        uint32_t message_size;
+        double exec_ms;
+        double setup_ms;
+        double teardown_ms;
+        uint32_t failure_count;
+        uint8_t status;        // Test::Status
+        uint8_t reserved[3];
+    };
+
+    static_assert(sizeof(ResultRecord) == 64, "Result records are meant to stay small and fixed size");
+    static_assert(std::is_trivially_copyable<BenchmarkStats>::value, "Benchmark statistics are logged as they are");
+
+    namespace detail {
+        // The message of a result, which depends on its status
+        inline const std::string& result_message(const Test& test) {
+            static const std::string none;
+            switch (test.getStatus()) {
+            case Test::Status::FAILED:
+            case Test::Status::SLOW:
+            case Test::Status::TIMEOUT:
+                return test.getFailureReason();
+            case Test::Status::SKIPPED:
+                return test.getSkippedReason();
+            case Test::Status::ERROR:
+                return test.getError();
+            default:
+                return none;
+            }
+        }
+    }
+
+    // Observer appending each result to a binary result log
+    class BinaryResultLog : public IRegistryObserver {
+    public:
+        BinaryResultLog(const std::string& path)
+            : records_(path, "result log"), strings_(path + ".strings", "result log strings"), count_(0) {
+            write_header();
+        }
+
+        virtual void update(TestInfo infos) const override {
+            const auto& test = infos.get();
+            ResultRecord record = {};
+            record.exec_ms = test.getExecTimeMs().count();
+            record.setup_ms = test.getSetUpTimeMs().count();
+            record.teardown_ms = test.getTearDownTimeMs().count();
+            record.failure_count = static_cast<uint32_t>(test.getFailureCount());
+            record.status = static_cast<uint8_t>(test.getStatus());
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            record.label = append(test.getLabel(false), record.label_size);
+            record.message = append(detail::result_message(test), record.message_size);
+            record.benchmark = ResultRecord::none;
+            if (auto stats = test.getBenchmarkStats()) {
+                // Aligned, so that the reader can use them in place
+                record.benchmark = (strings_.size() + alignof(BenchmarkStats) - 1) / alignof(BenchmarkStats) * alignof(BenchmarkStats);
+                strings_.write(record.benchmark, stats, sizeof(*stats));
+            }
+            records_.write(sizeof(ResultLogHeader) + count_ * sizeof(ResultRecord), &record, sizeof(record));
+            ++count_;
+            write_header();
+        }
+
+        virtual void flush() const override {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            strings_.flush();
+            records_.flush();
+        }
+
+    private:
+        uint64_t append(const std::string& text, uint32_t& size) const {
+            const auto offset = strings_.size();
+            size = static_cast<uint32_t>(text.size());
+            strings_.write(offset, text.data(), text.size());
+            return offset;
+        }
+
+        void write_header() const {
+            ResultLogHeader header = { { 'H', '2', 'O', 'F', 'T', 'L', 'O', 'G' }, ResultLogHeader::current_version,
+                static_cast<uint32_t>(sizeof(ResultRecord)), count_, strings_.size() };
+            records_.write(0, &header, sizeof(header));
+        }
+
+        mutable detail::AppendFile records_;
+        mutable detail::AppendFile strings_;
+        mutable uint64_t count_;
+        mutable std::mutex mutex_;
+    };
 
-        // Helper functions to build/skip a test case
-        std::unique_ptr<Test> make_test(TestFunctor&& func) { return std::make_unique<Test>(std::move(func)); }
-        std::unique_ptr<Test> make_test(const std::string& label, TestFunctor&& func) { return std::make_unique<Test>(label, std::move(func)); }
-        std::unique_ptr<Test> make_skipped_test(TestFunctor&& test) { return std::make_unique<SkippedTest>(std::move(test)); }
-        std::unique_ptr<Test> make_skipped_test(const std::string& label, TestFunctor&& func) { return std::make_unique<SkippedTest>(label, std::move(func)); }
-        std::unique_ptr<Test> make_skipped_test(const std::string& reason, const std::string& label, TestFunctor&& func) { return std::make_unique<SkippedTest>(reason, label, std::move(func)); }
+    // A result read from a binary result log, with the accessors of Test the reporters use
+    class LoggedResult {
+    public:
+        LoggedResult(const ResultRecord& record, const char* strings)
+            : record_(record), strings_(strings) {}
+
+        std::string getLabel(bool /*verbose*/) const { return std::string{ label() }; }
+        std::string_view label() const { return { strings_ + record_.label, record_.label_size }; }
+        std::string_view message() const { return { strings_ + record_.message, record_.message_size }; }
+        Test::Status getStatus() const { return static_cast<Test::Status>(record_.status); }
+        Duration getExecTimeMs() const { return Duration{ record_.exec_ms }; }
+        Duration getSetUpTimeMs() const { return Duration{ record_.setup_ms }; }
+        Duration getTearDownTimeMs() const { return Duration{ record_.teardown_ms }; }
+        std::string getFailureReason() const { return message_if(Test::Status::FAILED, Test::Status::SLOW, Test::Status::TIMEOUT); }
+        std::string getSkippedReason() const { return message_if(Test::Status::SKIPPED); }
+        std::string getError() const { return message_if(Test::Status::ERROR); }
+        // The failures are logged in the failure reason only
+        const std::vector<std::string>& getFailures() const {
+            static const std::vector<std::string> none;
+            return none;
+        }
+        size_t getFailureCount() const { return record_.failure_count; }
+        const BenchmarkStats* getBenchmarkStats() const {
+            return record_.benchmark == ResultRecord::none ? nullptr : reinterpret_cast<const BenchmarkStats*>(strings_ + record_.benchmark);
+        }
 
-        // POD containing informations about a test
-        using TestInfo = std::reference_wrapper<const Test>;
+    private:
+        template<class... Statuses>
+        std::string message_if(Statuses... statuses) const {
+            const auto status = getStatus();
+            return ((status == statuses) || ...) ? std::string{ message() } : std::string{};
+        }
 
-        // Interface for making an observer
-        class IRegistryObserver {
-        public:
-            virtual void update(TestInfo infos) const = 0;
-        };
+        ResultRecord record_;
+        const char* strings_;
+    };
 
-        // Implementation of the observable part of the DP observer
-        class IRegistryObservable {
-        public:
-            void notify(TestInfo infos) const {
-                for (auto& observer : list_observers_) {
-                    observer->update(infos);
+    // Reads a binary result log back, with the counters and the visits of RegistryManager, so
+    // that the reporters can consume it, see print_summary and JUnitReporter::write
+    // The log is checked whole when opened, and throws when it is not a valid one
+    class ResultLogReader {
+    public:
+        ResultLogReader(const std::string& path)
+            : counts_(), exec_time_ms_(0), setup_time_ms_(0), teardown_time_ms_(0) {
+            records_.open(path, "result log");
+            strings_.open(path + ".strings", "result log strings");
+            ResultLogHeader header;
+            if (records_.size() < sizeof(header)) {
+                invalid(path);
+            }
+            std::memcpy(&header, records_.data(), sizeof(header));
+            if (std::memcmp(header.magic, "H2OFTLOG", sizeof(header.magic)) != 0 || header.version != ResultLogHeader::current_version ||
+                header.record_size != sizeof(ResultRecord) || (records_.size() - sizeof(header)) / sizeof(ResultRecord) < header.records ||
+                strings_.size() < header.string_bytes) {
+                invalid(path);
+            }
+            size_ = static_cast<size_t>(header.records);
+            for (size_t i = 0; i < size_; ++i) {
+                const auto record = get(i);
+                if (record.status > static_cast<uint8_t>(Test::Status::NONE) ||
+                    !fits(record.label, record.label_size, header.string_bytes) || !fits(record.message, record.message_size, header.string_bytes) ||
+                    (record.benchmark != ResultRecord::none && (record.benchmark % alignof(BenchmarkStats) != 0 ||
+                        !fits(record.benchmark, sizeof(BenchmarkStats), header.string_bytes)))) {
+                    invalid(path);
                 }
+                ++counts_[record.status];
+                exec_time_ms_ += Duration{ record.exec_ms };
+                setup_time_ms_ += Duration{ record.setup_ms };
+                teardown_time_ms_ += Duration{ record.teardown_ms };
             }
-            void addObserver(const std::shared_ptr<IRegistryObserver>& observer) { list_observers_.insert(observer); }
-            void removeObserver(const std::shared_ptr<IRegistryObserver>& observer) { list_observers_.erase(observer); }
-        private:
-            std::set<std::shared_ptr<IRegistryObserver>> list_observers_;
-        };
-
-        // Global static registry storage object
-        using TestList = std::vector<std::unique_ptr<Test>>;
-        using TestStorage = std::map<std::type_index, TestList>;
-        using SetUpStorage = std::map<std::type_index, SetUpFunctor>;
-        using TearDownStorage = std::map<std::type_index, TearDownFunctor>;
-
-        class RegistryStorage {
-        public:
+        }
 
-            TestList& getTests(std::type_index index) { return getAllTests()[index]; }
-            SetUpFunctor& getSetUp(std::type_index index) { return getAllSetUps()[index]; }
-            TearDownFunctor& getTearDown(std::type_index index) { return getAllTearDowns()[index]; }
+        // Results in the order they were recorded
+        size_t size() const { return size_; }
+        LoggedResult operator[](size_t index) const { return LoggedResult{ get(index), strings_.data() }; }
 
-            TestStorage& getAllTests() { return tests_; }
-            SetUpStorage& getAllSetUps() { return setups_; }
-            SetUpStorage& getAllTearDowns() { return teardowns_; }
+        // Call visitor(const LoggedResult&) on every result, grouped by status as RegistryManager::visit
+        template<class Visitor>
+        void visit(Visitor&& visitor) const {
+            for (auto status : { Test::Status::PASSED, Test::Status::FAILED, Test::Status::SLOW, Test::Status::TIMEOUT, Test::Status::SKIPPED, Test::Status::ERROR }) {
+                visit(status, visitor);
+            }
+        }
 
-        private:
+        template<class Visitor>
+        void visit(Test::Status status, Visitor&& visitor) const {
+            if (counts_[static_cast<size_t>(status)] == 0) {
+                return;
+            }
+            for (size_t i = 0; i < size_; ++i) {
+                const auto result = (*this)[i];
+                if (result.getStatus() == status) {
+                    visitor(result);
+                }
+            }
+        }
 
-            TestStorage tests_;
-            SetUpStorage setups_;
-            TearDownStorage teardowns_;
+        size_t getRecordedCount(Test::Status status) const { return counts_[static_cast<size_t>(status)]; }
+        size_t getPassedCount() const { return getRecordedCount(Test::Status::PASSED); }
+        size_t getFailedCount() const { return getRecordedCount(Test::Status::FAILED); }
+        size_t getSkippedCount() const { return getRecordedCount(Test::Status::SKIPPED); }
+        size_t getWithErrorCount() const { return getRecordedCount(Test::Status::ERROR); }
+        size_t getSlowCount() const { return getRecordedCount(Test::Status::SLOW); }
+        size_t getTimedOutCount() const { return getRecordedCount(Test::Status::TIMEOUT); }
+        // Only the tests that were recorded are logged
+        size_t getNotRunCount() const { return 0; }
+        size_t getAllTestsCount() const { return size_; }
+        Duration getAllTestsExecTimeMs() const { return exec_time_ms_; }
+        Duration getAllSetUpTimeMs() const { return setup_time_ms_; }
+        Duration getAllTearDownTimeMs() const { return teardown_time_ms_; }
 
-        };
+    private:
+        ResultRecord get(size_t index) const {
+            ResultRecord record;
+            std::memcpy(&record, records_.data() + sizeof(ResultLogHeader) + index * sizeof(ResultRecord), sizeof(record));
+            return record;
+        }
 
-        RegistryStorage& get_registry() {
-            static RegistryStorage registry;
-            return registry;
+        static bool fits(uint64_t offset, uint64_t size, uint64_t string_bytes) {
+            return offset <= string_bytes && size <= string_bytes - offset;
         }
 
-        // Manage a registry in a static context
-        template<class ScenarioName>
-        class RegistryManager : public IRegistryObservable {
-        public:
+        [[noreturn]] static void invalid(const std::string& path) {
+            throw std::runtime_error{ "Invalid result log " + path };
+        }
 
-            using FeederFunctor = std::function<void(void)>;
+        detail::MappedFile records_;
+        detail::MappedFile strings_;
+        size_t size_ = 0;
+        size_t counts_[static_cast<size_t>(Test::Status::NONE) + 1]; // by status
+        Duration exec_time_ms_;
+        Duration setup_time_ms_;
+        Duration teardown_time_ms_;
+    };
 
-            RegistryManager(FeederFunctor feeder)
-                : run_(false), exec_time_ms_accumulator_(Duration{ 0 }) {
-                feeder();
+    // Summary of the results of a registry or of a result log, see RegistryTraversal_ConsoleIO
+    // Results has the counters of RegistryManager and its visit(status, visitor)
+    // The whole summary is written at once
+    template<class Results>
+    void print_summary(const std::string& name, const Results& results, bool verbose, ConsoleBuffer& out = get_console_buffer()) {
+        out.printf(COLOR_CYAN, "UNIT TEST SUMMARY [%s] [%.6f ms] : \n", name.c_str(), results.getAllTestsExecTimeMs().count());
+        // Whether the scenario is bound by its fixtures or by its tests
+        out.printf(COLOR_CYAN, "\tTIMES: set up %.6f ms, tests %.6f ms, tear down %.6f ms\n", results.getAllSetUpTimeMs().count(),
+            results.getAllTestsExecTimeMs().count(), results.getAllTearDownTimeMs().count());
+
+        const auto all_count = static_cast<unsigned long long>(results.getAllTestsCount());
+
+        if (results.getPassedCount() > 0) {
+            out.printf(COLOR_GREEN, "\tPASSED: %llu/%llu\n", static_cast<unsigned long long>(results.getPassedCount()), all_count);
+            if (verbose) {
+                results.visit(Test::Status::PASSED, [&out, verbose](const auto& test) {
+                    out.printf(COLOR_GREEN, "\t\t[%s] [%.6f ms]\n", test.getLabel(verbose).c_str(), test.getExecTimeMs().count());
+                });
             }
+        }
 
-            //Recursive variadic to iterate over the test pack
-            void add_test(Test&& test) {
-                get_registry().getTests(type_helper<ScenarioName>::type_index()).push_back(std::move(test));
+        // Always print benchmarks
+        bool benchmarks = false;
+        results.visit(Test::Status::PASSED, [&out, &benchmarks, verbose](const auto& test) {
+            if (auto stats = test.getBenchmarkStats()) {
+                if (!benchmarks) {
+                    out.printf(COLOR_CYAN, "\tBENCHMARKS:\n");
+                    benchmarks = true;
+                }
+                // In ns, benchmarked bodies are usually short
+                out.printf(COLOR_CYAN, "\t\t[%s] min %.2f ns, median %.2f ns, p99 %.2f ns, stddev %.2f ns (%llu x %llu)\n",
+                    test.getLabel(verbose).c_str(), stats->min * 1e6, stats->median * 1e6, stats->p99 * 1e6, stats->stddev * 1e6,
+                    static_cast<unsigned long long>(stats->samples), static_cast<unsigned long long>(stats->iterations));
+                if (stats->counters.has(PerfStats::INSTRUCTIONS)) {
+                    out.printf(COLOR_CYAN, "\t\t\t%.1f instructions, %.1f cycles per iteration\n",
+                        stats->per_iteration(PerfStats::INSTRUCTIONS), stats->per_iteration(PerfStats::CYCLES));
+                }
             }
+        });
+
+        if (results.getFailedCount() > 0) {
+            out.printf(COLOR_RED, "\tFAILED: %llu/%llu\n", static_cast<unsigned long long>(results.getFailedCount()), all_count);
+            // Always print failed tests
+            // One message per failure for tests with several failed expectations, see ExpectThat
+            results.visit(Test::Status::FAILED, [&out, verbose](const auto& test) {
+                out.printf(COLOR_RED, "\t\t[%s] [%.6f ms]\n", test.getLabel(verbose).c_str(), test.getExecTimeMs().count());
+                if (test.getFailures().empty()) {
+                    out.printf(COLOR_RED, "\t\tMessage: %s\n", test.getFailureReason().c_str());
+                }
+                for (const auto& failure : test.getFailures()) {
+                    out.printf(COLOR_RED, "\t\tMessage: %s\n", failure.c_str());
+                }
+                if (test.getFailureCount() > test.getFailures().size()) {
+                    out.printf(COLOR_RED, "\t\t(%llu failures, %llu not recorded)\n", static_cast<unsigned long long>(test.getFailureCount()),
+                        static_cast<unsigned long long>(test.getFailureCount() - test.getFailures().size()));
+                }
+            });
+        }
 
-            void add_test(TestFunctor&& func) {
-                get_registry().getTests(type_helper<ScenarioName>::type_index()).push_back(std::move(make_test(std::move(func))));
-            }
+        if (results.getSlowCount() > 0) {
+            out.printf(COLOR_BLUE, "\tSLOW: %llu/%llu\n", static_cast<unsigned long long>(results.getSlowCount()), all_count);
+            // Always print slow tests
+            results.visit(Test::Status::SLOW, [&out, verbose](const auto& test) {
+                out.printf(COLOR_BLUE, "\t\t[%s] [%.6f ms]\n\t\tMessage: %s\n", test.getLabel(verbose).c_str(), test.getExecTimeMs().count(), test.getFailureReason().c_str());
+            });
+        }
 
-            void add_test(const std::string& label, TestFunctor&& func) {
-                get_registry().getTests(type_helper<ScenarioName>::type_index()).push_back(std::move(make_test(label, std::move(func))));
-            }
-            void skip_test(TestFunctor&& func) {
-                get_registry().getTests(type_helper<ScenarioName>::type_index()).push_back(std::move(make_skipped_test(std::move(func))));
-            }
+        if (results.getTimedOutCount() > 0) {
+            out.printf(COLOR_PURPLE, "\tTIMEOUTS: %llu/%llu\n", static_cast<unsigned long long>(results.getTimedOutCount()), all_count);
+            // Always print timed out tests
+            results.visit(Test::Status::TIMEOUT, [&out, verbose](const auto& test) {
+                out.printf(COLOR_PURPLE, "\t\t[%s] [%.6f ms]\n\t\tMessage: %s\n", test.getLabel(verbose).c_str(), test.getExecTimeMs().count(), test.getFailureReason().c_str());
+            });
+        }
 
-            void skip_test(const std::string& label, TestFunctor&& func) {
-                get_registry().getTests(type_helper<ScenarioName>::type_index()).push_back(std::move(make_skipped_test(label, std::move(func))));
+        if (results.getSkippedCount() > 0) {
+            out.printf(COLOR_YELLOW, "\tSKIPPED: %llu/%llu\n", static_cast<unsigned long long>(results.getSkippedCount()), all_count);
+            if (verbose) {
+                results.visit(Test::Status::SKIPPED, [&out, verbose](const auto& test) {
+                    out.printf(COLOR_YELLOW, "\t\t[%s] [%.6f ms]\n\t\tMessage: %s\n", test.getLabel(verbose).c_str(), test.getExecTimeMs().count(), test.getSkippedReason().c_str());
+                });
             }
+        }
 
-            void skip_test(const std::string& reason, const std::string& label, TestFunctor&& func) {
-                get_registry().getTests(type_helper<ScenarioName>::type_index()).push_back(std::move(make_skipped_test(reason, label, std::move(func))));
-            }
+        if (results.getWithErrorCount() > 0) {
+            out.printf(COLOR_PURPLE, "\tERRORS: %llu/%llu\n", static_cast<unsigned long long>(results.getWithErrorCount()), all_count);
+            // Always print error tests
+            results.visit(Test::Status::ERROR, [&out, verbose](const auto& test) {
+                out.printf(COLOR_PURPLE, "\t\t[%s] [%.6f ms]\n\t\tMessage: %s\n", test.getLabel(verbose).c_str(), test.getExecTimeMs().count(), test.getError().c_str());
+            });
+        }
 
-            void set_up(SetUpFunctor&& func) {
-                get_registry().getSetUp(type_helper<ScenarioName>::type_index()) = std::move(func);
-            }
+        if (results.getNotRunCount() > 0) {
+            out.printf(COLOR_YELLOW, "\tNOT RUN: %llu/%llu\n", static_cast<unsigned long long>(results.getNotRunCount()), all_count);
+        }
+        out.flush();
+    }
 
-            void tear_down(TearDownFunctor&& func) {
-                get_registry().getTearDown(type_helper<ScenarioName>::type_index()) = std::move(func);
-            }
+    // Trivial impl for console display results
+    template<class ScenarioName>
+    class RegistryTraversal_ConsoleIO : private IRegistryTraversal<ScenarioName> {
+    public:
+        RegistryTraversal_ConsoleIO(const RegistryManager<ScenarioName>& registry) : IRegistryTraversal<ScenarioName>(registry) {}
+        // The whole summary is written at once
+        void print(bool verbose, ConsoleBuffer& out = get_console_buffer()) const {
+            print_summary(detail::scenario_name(detail::type_helper<ScenarioName>::name()), this->getRegistryManager(), verbose, out);
+        }
 
-            // Run all the tests
-            void run_tests() {
-                const auto& setup = get_registry().getSetUp(type_helper<ScenarioName>::type_index());
-                const auto& teardown = get_registry().getTearDown(type_helper<ScenarioName>::type_index());
-                auto& tests = get_registry().getTests(type_helper<ScenarioName>::type_index());
-                for (auto& test : tests) {
-                    test->run(setup, teardown);
-                    exec_time_ms_accumulator_ += test->getExecTimeMs();
-                    notify(TestInfo{ *test });
-                    switch (test->getStatus()) {
-                    case Test::Status::PASSED:
-                        tests_passed_.push_back(std::cref(*test));
-                        break;
-                    case Test::Status::FAILED:
-                        tests_failed_.push_back(std::cref(*test));
-                        break;
-                    case Test::Status::SKIPPED:
-                        tests_skipped_.push_back(std::cref(*test));
-                        break;
-                    case Test::Status::ERROR:
-                        tests_with_error_.push_back(std::cref(*test));
-                        break;
-                    default: break;
-                    }
-                }
-                run_ = true;
-            }
+        // Summary of the results of the scenario logged by a BinaryResultLog
+        static void print(const ResultLogReader& log, bool verbose, ConsoleBuffer& out = get_console_buffer()) {
+            print_summary(detail::scenario_name(detail::type_helper<ScenarioName>::name()), log, verbose, out);
+        }
+    };
 
-            // describe test suite
-            virtual void describe() {}
+    // Observer impl example
+    class ConsoleIO_Observer : public IRegistryObserver {
+        virtual void update(TestInfo infos) const override {
+            std::cout << (infos.get().getStatus() == Test::Status::SKIPPED ? "SKIPPING TEST [" : "RUNNING TEST [")
+                << infos.get().getLabel(false) << "] [" << infos.get().getExecTimeMs().count() << "ms]:" << std::endl
+                << "Status: " << infos.get().getStatus() << std::endl;
+            if (auto stats = infos.get().getBenchmarkStats()) {
+                std::cout << "Benchmark: min " << stats->min << "ms, median " << stats->median << "ms, p99 " << stats->p99
+                    << "ms, stddev " << stats->stddev << "ms (" << stats->samples << " samples of " << stats->iterations << " iterations)" << std::endl;
+            }
+        }
+        virtual void updateTimeout(TestInfo infos, Duration timeout) const override {
+            std::cout << "TEST TIMED OUT [" << infos.get().getLabel(false) << "] after " << timeout.count() << "ms" << std::endl;
+        }
+    };
 
-            // Get informations
+    // Delivers the updates to an observer from a background thread, so that a slow observer
+    // does not slow the tests down
+    // Only a pointer to the recorded test is queued : tests are not modified until their
+    // scenario is run again, and every update is delivered before a run returns
+    class AsyncObserver : public IRegistryObserver {
+    public:
+        // What update does when the queue is full
+        enum class Backpressure {
+            BLOCK,  // wait for the background thread to make room
+            DROP    // drop the update, see getDroppedCount
+        };
 
-            size_t getPassedCount() const { return run_ ? tests_passed_.size() : 0; }
-            const std::vector<std::reference_wrapper<const Test>>& getPassedTests() const { return tests_passed_; }
+        AsyncObserver(std::shared_ptr<IRegistryObserver> observer, size_t capacity = 1024, Backpressure backpressure = Backpressure::BLOCK)
+            : channel_(new Channel(std::move(observer), capacity, backpressure)) {
+            channel_->consumer = std::thread{ [this]() { drain(); } };
+        }
 
-            size_t getFailedCount() const { return run_ ? tests_failed_.size() : 0; }
-            const std::vector<std::reference_wrapper<const Test >>& getFailedTests() const { return tests_failed_; }
+        AsyncObserver(const AsyncObserver&) = delete;
+        AsyncObserver& operator=(const AsyncObserver&) = delete;
 
-            size_t getSkippedCount() const { return run_ ? tests_skipped_.size() : 0; }
-            const std::vector<std::reference_wrapper<const Test>>& getSkippedTests() const { return tests_skipped_; }
+        // Delivers what is left before returning
+        virtual ~AsyncObserver() {
+            {
+                std::lock_guard<std::mutex> lock{ channel_->mutex };
+                channel_->stop = true;
+            }
+            channel_->wake_consumer.notify_one();
+            channel_->consumer.join();
+        }
 
-            size_t getWithErrorCount() const { return run_ ? tests_with_error_.size() : 0; }
-            const std::vector<std::reference_wrapper<const Test>>& getWithErrorTests() const { return tests_with_error_; }
+        virtual void update(TestInfo infos) const override {
+            auto& channel = *channel_;
+            const Test* test = &infos.get();
+            while (!channel.queue.try_push(test)) {
+                if (channel.backpressure == Backpressure::DROP) {
+                    ++channel.dropped;
+                    return;
+                }
+                wake();
+                std::this_thread::yield();
+            }
+            ++channel.enqueued;
+            if (channel.consumer_waiting.load()) {
+                wake();
+            }
+        }
 
-            size_t getAllTestsCount() const { return run_ ? get_registry().getTests(type_helper<ScenarioName>::type_index()).size() : 0; }
-            const TestList& getAllTests() const { return get_registry().getTests(type_helper<ScenarioName>::type_index()); }
-            Duration getAllTestsExecTimeMs() const { return run_ ? exec_time_ms_accumulator_ : Duration{ 0 }; }
+        // Waits until every queued update is delivered
+        // Rethrows the first exception thrown by the observer
+        virtual void flush() const override {
+            auto& channel = *channel_;
+            const auto enqueued = channel.enqueued.load();
+            std::exception_ptr failure;
+            {
+                std::unique_lock<std::mutex> lock{ channel.mutex };
+                channel.wake_consumer.notify_one();
+                channel.drained.wait(lock, [&channel, enqueued]() { return channel.delivered.load() >= enqueued; });
+                failure = std::exchange(channel.failure, nullptr);
+            }
+            if (failure) {
+                std::rethrow_exception(failure);
+            }
+            channel.observer->flush();
+        }
 
-        private:
+        // Not queued: the test is still running, and may never be recorded
+        virtual void updateTimeout(TestInfo infos, Duration timeout) const override {
+            channel_->observer->updateTimeout(infos, timeout);
+        }
 
-            bool run_;
-            Duration exec_time_ms_accumulator_;
-            std::vector<std::reference_wrapper<const Test>> tests_passed_;
-            std::vector<std::reference_wrapper<const Test>> tests_failed_;
-            std::vector<std::reference_wrapper<const Test>> tests_skipped_;
-            std::vector<std::reference_wrapper<const Test>> tests_with_error_;
+        size_t getDroppedCount() const { return channel_->dropped.load(); }
 
+    private:
+        struct Channel {
+            Channel(std::shared_ptr<IRegistryObserver> observer_, size_t capacity, Backpressure backpressure_)
+                : observer(std::move(observer_)), queue(capacity), backpressure(backpressure_) {}
+
+            std::shared_ptr<IRegistryObserver> observer;
+            detail::BoundedQueue<const Test*> queue;
+            const Backpressure backpressure;
+            std::atomic<size_t> enqueued{ 0 };
+            std::atomic<size_t> delivered{ 0 };
+            std::atomic<size_t> dropped{ 0 };
+            std::atomic<bool> consumer_waiting{ false };
+            std::mutex mutex;
+            std::condition_variable wake_consumer;
+            std::condition_variable drained;
+            std::exception_ptr failure;
+            bool stop = false;
+            std::thread consumer;
         };
-    }
 
-    /*
-    *
-    * Public interface
-    *
-    */
+        void wake() const {
+            std::lock_guard<std::mutex> lock{ channel_->mutex };
+            channel_->wake_consumer.notify_one();
+        }
 
-    // Public accessible types
-    using detail::LineInfo;
-    using detail::TestInfo;
-    using detail::Test;
-    using detail::RegistryStorage;
-    using detail::IRegistryObserver;
-    template<class ScenarioName>
-    using RegistryManager = detail::RegistryManager<ScenarioName>;
+        void drain() {
+            auto& channel = *channel_;
+            for (;;) {
+                const Test* test;
+                while (channel.queue.try_pop(test)) {
+                    try {
+                        channel.observer->update(std::cref(*test));
+                    }
+                    catch (...) {
+                        std::lock_guard<std::mutex> lock{ channel.mutex };
+                        if (!channel.failure) {
+                            channel.failure = std::current_exception();
+                        }
+                    }
+                    ++channel.delivered;
+                }
+                std::unique_lock<std::mutex> lock{ channel.mutex };
+                channel.drained.notify_all();
+                if (channel.stop && channel.delivered.load() >= channel.enqueued.load()) {
+                    return;
+                }
+                // Producers only take the lock to wake the consumer up when it waits
+                channel.consumer_waiting.store(true);
+                channel.wake_consumer.wait_for(lock, std::chrono::milliseconds{ 10 }, [&channel]() {
+                    return channel.stop || channel.delivered.load() < channel.enqueued.load();
+                });
+                channel.consumer_waiting.store(false);
+            }
+        }
 
-    // Asserter exposition
-    namespace Asserter {
-        using detail::AsserterExpression;
-        using detail::AssertThat;
-    }
+        std::unique_ptr<Channel> channel_;
+    };
 
-    // Interface to Implement to access access a registry information
-    // Possibility to export services into a DLL for forther customization
-    template<class ScenarioName>
-    class IRegistryTraversal {
+    // Same output as ConsoleIO_Observer, batched through the shared console buffer
+    class BufferedConsoleIO_Observer : public IRegistryObserver {
     public:
-        IRegistryTraversal(const RegistryManager<ScenarioName>& registry) : registry_(registry) {}
-        virtual ~IRegistryTraversal() {}
-    protected:
-        const RegistryManager<ScenarioName>& getRegistryManager() const { return registry_; }
+        BufferedConsoleIO_Observer(ConsoleBuffer& out = get_console_buffer()) : out_(out) {}
+        virtual ~BufferedConsoleIO_Observer() { out_.flush(); }
+        virtual void flush() const override { out_.flush(); }
+        virtual void update(TestInfo infos) const override {
+            out_.printf(COLOR_DEFAULT, "%s%s] [%gms]:\nStatus: %s\n",
+                infos.get().getStatus() == Test::Status::SKIPPED ? "SKIPPING TEST [" : "RUNNING TEST [",
+                infos.get().getLabel(false).c_str(), infos.get().getExecTimeMs().count(), detail::status_name(infos.get().getStatus()));
+            if (auto stats = infos.get().getBenchmarkStats()) {
+                out_.printf(COLOR_DEFAULT, "Benchmark: min %gms, median %gms, p99 %gms, stddev %gms (%llu samples of %llu iterations)\n",
+                    stats->min, stats->median, stats->p99, stats->stddev,
+                    static_cast<unsigned long long>(stats->samples), static_cast<unsigned long long>(stats->iterations));
+            }
+        }
+        // Flushed at once, the test may hang for good
+        virtual void updateTimeout(TestInfo infos, Duration timeout) const override {
+            out_.printf(COLOR_DEFAULT, "TEST TIMED OUT [%s] after %gms\n", infos.get().getLabel(false).c_str(), timeout.count());
+            out_.flush();
+        }
     private:
-        RegistryManager<ScenarioName> registry_;
+        ConsoleBuffer& out_;
     };
 
-    // Trivial impl for console display results
-    template<class ScenarioName>
-    class RegistryTraversal_ConsoleIO : private IRegistryTraversal<ScenarioName> {
+    // Streams each result as one JSON object per line, as soon as it is recorded
+    // Every line is flushed, so the file stays readable whatever happens to the process
+    class JsonLinesReporter : public IRegistryObserver {
     public:
-        RegistryTraversal_ConsoleIO(const RegistryManager<ScenarioName>& registry) : IRegistryTraversal<ScenarioName>(registry) {}
-        void print(bool verbose) const {
-            auto& registry_manager = this->getRegistryManager();
-            const auto test_name = std::string{ H2OFastTests::detail::type_helper<ScenarioName>::name() };
-            ColoredPrintf(COLOR_CYAN, "UNIT TEST SUMMARY [%s] [%.6f ms] : \n", test_name.substr(test_name.find(' ') + 1).c_str(), registry_manager.getAllTestsExecTimeMs().count());
+        JsonLinesReporter(const std::string& path, const std::string& suite = {})
+            : file_(path, std::ios::trunc | std::ios::binary), suite_(suite) {
+            if (!file_) {
+                throw std::runtime_error{ "Unable to write the report file " + path };
+            }
+            file_.setf(std::ios::fixed);
+            file_.precision(6);
+        }
 
-            if (registry_manager.getPassedCount() > 0) {
-                ColoredPrintf(COLOR_GREEN, "\tPASSED: %d/%d\n", registry_manager.getPassedCount(), registry_manager.getAllTestsCount());
-                if (verbose) {
-                    for (const auto& test : registry_manager.getPassedTests()) {
-                        ColoredPrintf(COLOR_GREEN, "\t\t[%s] [%.6f ms]\n", test.get().getLabel(verbose).c_str(), test.get().getExecTimeMs().count());
+        virtual void update(TestInfo infos) const override {
+            const auto& test = infos.get();
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            file_ << "{\"suite\":\"";
+            write_escaped(suite_);
+            file_ << "\",\"name\":\"";
+            write_escaped(test.getLabel(false));
+            file_ << "\",\"status\":\"" << detail::status_name(test.getStatus()) << "\",\"time_ms\":" << test.getExecTimeMs().count()
+                << ",\"setup_ms\":" << test.getSetUpTimeMs().count() << ",\"teardown_ms\":" << test.getTearDownTimeMs().count();
+            if (auto stats = test.getPerfStats()) {
+                file_ << ",\"counters\":{";
+                const char* separator = "";
+                for (int event = 0; event < detail::PerfStats::EVENT_COUNT; ++event) {
+                    if (stats->has(static_cast<detail::PerfStats::Event>(event))) {
+                        file_ << separator << '"' << detail::PerfStats::name(static_cast<detail::PerfStats::Event>(event)) << "\":" << stats->values[event];
+                        separator = ",";
                     }
                 }
+                file_ << '}';
+            }
+            if (auto stats = test.getAllocationStats()) {
+                file_ << ",\"allocations\":{\"count\":" << stats->allocations << ",\"bytes\":" << stats->bytes
+                    << ",\"peak_bytes\":" << stats->peak_bytes << ",\"leaked\":" << stats->leaks() << '}';
+            }
+            if (auto stats = test.getBenchmarkStats()) {
+                file_ << ",\"benchmark\":{\"samples\":" << stats->samples << ",\"iterations\":" << stats->iterations
+                    << ",\"min_ms\":" << stats->min << ",\"median_ms\":" << stats->median << ",\"p99_ms\":" << stats->p99
+                    << ",\"mean_ms\":" << stats->mean << ",\"stddev_ms\":" << stats->stddev << '}';
             }
+            switch (test.getStatus()) {
+            case Test::Status::FAILED:
+            case Test::Status::SLOW:
+            case Test::Status::TIMEOUT:
+                write_message(test.getFailureReason());
+                break;
+            case Test::Status::SKIPPED:
+                write_message(test.getSkippedReason());
+                break;
+            case Test::Status::ERROR:
+                write_message(test.getError());
+                break;
+            default: break;
+            }
+            file_ << "}\n";
+            file_.flush();
+        }
 
-            if (registry_manager.getFailedCount() > 0) {
-                ColoredPrintf(COLOR_RED, "\tFAILED: %d/%d\n", registry_manager.getFailedCount(), registry_manager.getAllTestsCount());
-                // Always print failed tests
-                for (const auto& test : registry_manager.getFailedTests()) {
-                    ColoredPrintf(COLOR_RED, "\t\t[%s] [%.6f ms]\n\t\tMessage: %s\n", test.get().getLabel(verbose).c_str(), test.get().getExecTimeMs().count(), test.get().getFailureReason().c_str());
+    private:
+        void write_message(const std::string& message) const {
+            file_ << ",\"message\":\"";
+            write_escaped(message);
+            file_ << '"';
+        }
+
+        // Writes the runs of plain characters as they are, escaping the others
+        void write_escaped(const std::string& text) const {
+            size_t begin = 0;
+            for (size_t i = 0; i < text.size(); ++i) {
+                const auto c = static_cast<unsigned char>(text[i]);
+                if (c >= 0x20 && c != '"' && c != '\\') {
+                    continue;
+                }
+                file_.write(text.data() + begin, i - begin);
+                switch (c) {
+                case '"': file_ << "\\\""; break;
+                case '\\': file_ << "\\\\"; break;
+                case '\n': file_ << "\\n"; break;
+                case '\r': file_ << "\\r"; break;
+                case '\t': file_ << "\\t"; break;
+                default: {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    file_ << escaped;
+                }
                 }
+                begin = i + 1;
             }
+            file_.write(text.data() + begin, text.size() - begin);
+        }
 
-            if (registry_manager.getSkippedCount() > 0) {
-                ColoredPrintf(COLOR_YELLOW, "\tSKIPPED: %d/%d\n", registry_manager.getSkippedCount(), registry_manager.getAllTestsCount());
-                if (verbose) {
-                    for (const auto& test : registry_manager.getSkippedTests()) {
-                        ColoredPrintf(COLOR_YELLOW, "\t\t[%s] [%.6f ms]\n\t\tMessage: %s\n", test.get().getLabel(verbose).c_str(), test.get().getExecTimeMs().count(), test.get().getSkippedReason().c_str());
-                    }
-                }
+        mutable std::ofstream file_;
+        const std::string suite_;
+        mutable std::mutex mutex_;
+    };
+
+    // Streams a JUnit XML report, one testcase at a time
+    // The closing tag is rewritten after each testcase, so the file is always a complete document
+    class JUnitReporter : public IRegistryObserver {
+    public:
+        JUnitReporter(const std::string& path, const std::string& suite = "H2OFastTests")
+            : file_(path, std::ios::trunc | std::ios::binary), suite_(suite) {
+            if (!file_) {
+                throw std::runtime_error{ "Unable to write the report file " + path };
+            }
+            file_.setf(std::ios::fixed);
+            file_.precision(6);
+            file_ << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites>\n<testsuite name=\"";
+            write_escaped(suite_);
+            file_ << "\">\n";
+            write_trailer();
+        }
+
+        virtual void update(TestInfo infos) const override {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            write_testcase(infos.get());
+            write_trailer();
+        }
+
+        // Writes a testcase per result of a binary result log, see BinaryResultLog
+        void write(const ResultLogReader& log) const {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            for (size_t i = 0; i < log.size(); ++i) {
+                write_testcase(log[i]);
+            }
+            write_trailer();
+        }
+
+    private:
+        // Result is a Test or a LoggedResult
+        template<class Result>
+        void write_testcase(const Result& test) const {
+            file_ << "<testcase classname=\"";
+            write_escaped(suite_);
+            file_ << "\" name=\"";
+            write_escaped(test.getLabel(false));
+            file_ << "\" time=\"" << test.getExecTimeMs().count() / 1000 << '"';
+            switch (test.getStatus()) {
+            case Test::Status::FAILED:
+            case Test::Status::SLOW:
+                write_child("failure", test.getFailureReason());
+                break;
+            case Test::Status::SKIPPED:
+                write_child("skipped", test.getSkippedReason());
+                break;
+            case Test::Status::ERROR:
+                write_child("error", test.getError());
+                break;
+            case Test::Status::TIMEOUT:
+                write_child("error", test.getFailureReason());
+                break;
+            default:
+                file_ << "/>\n";
+                break;
             }
+        }
 
-            if (registry_manager.getWithErrorCount() > 0) {
-                ColoredPrintf(COLOR_PURPLE, "\tERRORS: %d/%d\n", registry_manager.getWithErrorCount(), registry_manager.getAllTestsCount());
-                // Always print error tests
-                for (const auto& test : registry_manager.getWithErrorTests()) {
-                    ColoredPrintf(COLOR_PURPLE, "\t\t[%s] [%.6f ms]\n\t\tMessage: %s\n", test.get().getLabel(verbose).c_str(), test.get().getExecTimeMs().count(), test.get().getError().c_str());
+        void write_child(const char* tag, const std::string& message) const {
+            file_ << ">\n<" << tag << " message=\"";
+            write_escaped(message);
+            file_ << "\"/>\n</testcase>\n";
+        }
+
+        // Writes the closing tags, the next testcase overwrites them
+        void write_trailer() const {
+            const auto position = file_.tellp();
+            file_ << "</testsuite>\n</testsuites>\n";
+            file_.flush();
+            file_.seekp(position);
+        }
+
+        // Writes the runs of plain characters as they are, escaping the others
+        // Control characters are not allowed in XML 1.0 and are replaced
+        void write_escaped(const std::string& text) const {
+            size_t begin = 0;
+            for (size_t i = 0; i < text.size(); ++i) {
+                const auto c = static_cast<unsigned char>(text[i]);
+                if ((c >= 0x20 || c == '\t') && c != '&' && c != '<' && c != '>' && c != '"' && c != '\'') {
+                    continue;
                 }
+                file_.write(text.data() + begin, i - begin);
+                switch (c) {
+                case '&': file_ << "&amp;"; break;
+                case '<': file_ << "&lt;"; break;
+                case '>': file_ << "&gt;"; break;
+                case '"': file_ << "&quot;"; break;
+                case '\'': file_ << "&apos;"; break;
+                case '\n': file_ << "&#10;"; break;
+                case '\r': file_ << "&#13;"; break;
+                default: file_ << '?'; break;
+                }
+                begin = i + 1;
             }
+            file_.write(text.data() + begin, text.size() - begin);
         }
+
+        mutable std::ofstream file_;
+        const std::string suite_;
+        mutable std::mutex mutex_;
     };
 
-    // Observer impl example
-    class ConsoleIO_Observer : public IRegistryObserver {
-        virtual void update(TestInfo infos) const override {
-            std::cout << (infos.get().getStatus() == Test::Status::SKIPPED ? "SKIPPING TEST [" : "RUNNING TEST [")
-                << infos.get().getLabel(false) << "] [" << infos.get().getExecTimeMs().count() << "ms]:" << std::endl
-                << "Status: " << infos.get().getStatus() << std::endl;
+    // Runs every registered scenario with the options of the command line, see
+    // parse_command_line, and prints their summaries, verbose with --verbose.
+    // Returns 0 when no test failed, 1 otherwise, and 2 for invalid or unknown options.
+#if H2OFT_DEFINE_FUNCTIONS_
+    H2OFT_INLINE int run_main(int argc, const char* const* argv) {
+        ExecutionPolicy policy;
+        std::vector<std::string> unknown;
+        try {
+            policy = parse_command_line(argc, argv, ExecutionPolicy::sequential(), &unknown);
         }
-    };
+        catch (const std::invalid_argument& e) {
+            std::cerr << e.what() << std::endl;
+            return 2;
+        }
+        auto verbose = false;
+        auto invalid = false;
+        for (const auto& arg : unknown) {
+            if (arg == "--verbose") {
+                verbose = true;
+            }
+            else {
+                std::cerr << "Unknown option " << arg << std::endl;
+                invalid = true;
+            }
+        }
+        if (invalid) {
+            return 2;
+        }
+        run_all_tests(policy);
+        for (const auto& slot : detail::get_registry().getAllSlots()) {
+            if (slot->recorder != nullptr) {
+                slot->recorder->print_results(verbose);
+            }
+        }
+        return policy.cancellation.getFailureCount() > 0 ? 1 : 0;
+    }
+#else
+    int run_main(int argc, const char* const* argv);
+#endif
+}
+
+// Define H2OFT_DEFINE_MAIN in one source file before including this header
+// to get a main running the tests from the command line, see H2OFastTests::run_main
+#if defined(H2OFT_DEFINE_MAIN)
+int main(int argc, char** argv) {
+    return H2OFastTests::run_main(argc, argv);
 }
+#endif
 
 //Helper macros to use the unit test suit
 #define register_scenario(ScenarioName) \
@@ -860,11 +6579,7 @@ namespace H2OFastTests {
         ScenarioName(H2OFastTests::template RegistryManager<ScenarioName>::FeederFunctor feeder); \
         virtual void describe(); \
     }; \
-    static ScenarioName ScenarioName ## _registry_manager{ []() { \
-        H2OFastTests::detail::get_registry().getAllTests().emplace(H2OFastTests::detail::template type_helper<ScenarioName>::type_index(), H2OFastTests::detail::TestList{}); \
-        H2OFastTests::detail::get_registry().getAllSetUps().emplace(H2OFastTests::detail::template type_helper<ScenarioName>::type_index(), [](){}); \
-        H2OFastTests::detail::get_registry().getAllTearDowns().emplace(H2OFastTests::detail::template type_helper<ScenarioName>::type_index(), [](){}); \
-    } }; \
+    static ScenarioName ScenarioName ## _registry_manager{ []() {} }; \
     ScenarioName::ScenarioName(H2OFastTests::template RegistryManager<ScenarioName>::FeederFunctor feeder) \
         : RegistryManager<ScenarioName>{ feeder } { \
         describe(); \
@@ -874,12 +6589,39 @@ namespace H2OFastTests {
 #define run_scenario(ScenarioName) \
     ScenarioName ## _registry_manager.run_tests();
 
+// workers = 0 means one worker per hardware thread
+#define run_scenario_parallel(ScenarioName, workers) \
+    ScenarioName ## _registry_manager.run_tests(H2OFastTests::ExecutionPolicy::parallel(workers));
+
+// shards = 0 means one worker process per hardware thread
+#define run_scenario_isolated(ScenarioName, shards) \
+    ScenarioName ## _registry_manager.run_tests(H2OFastTests::ExecutionPolicy::processes(shards));
+
+#define run_all_scenarios() \
+    H2OFastTests::run_all_tests(H2OFastTests::ExecutionPolicy::sequential());
+
+// workers = 0 means one worker per hardware thread
+#define run_all_scenarios_parallel(workers) \
+    H2OFastTests::run_all_tests(H2OFastTests::ExecutionPolicy::parallel(workers));
+
+// shards = 0 means one worker process per hardware thread
+#define run_all_scenarios_isolated(shards) \
+    H2OFastTests::run_all_tests(H2OFastTests::ExecutionPolicy::processes(shards));
+
+// See H2OFastTests::parse_command_line for the options
+#define run_all_scenarios_from_command_line(argc, argv) \
+    H2OFastTests::run_all_tests(H2OFastTests::parse_command_line(argc, argv));
+
 #define register_observer(ScenarioName, class_name) \
     ScenarioName ## _registry_manager.addObserver(std::make_shared<class_name>())
 
 #define register_custom_observer(ScenarioName, class_name, instance_ptr) \
     ScenarioName ## _registry_manager.addObserver(std::shared_ptr<class_name>(instance_ptr))
 
+// The observer is updated from a background thread, see H2OFastTests::AsyncObserver
+#define register_async_observer(ScenarioName, class_name) \
+    ScenarioName ## _registry_manager.addObserver(std::make_shared<H2OFastTests::AsyncObserver>(std::make_shared<class_name>()))
+
 #define print_result_verbose(ScenarioName) \
     H2OFastTests::RegistryTraversal_ConsoleIO<ScenarioName>(ScenarioName ## _registry_manager).print(true)
 
@@ -152,6 +152,53 @@ struct _RTL_CRITICAL_SECTION;
 # include <strings.h>
 #endif  // H2OFT_OS_WINDOWS
 
+// Process isolation: workers are forked where available, see ProcessShards.
+#if !H2OFT_OS_WINDOWS && !H2OFT_OS_NACL
+# define H2OFT_HAS_FORK_ 1
+# include <poll.h>  // NOLINT
+# include <signal.h>  // NOLINT
+# include <sys/types.h>  // NOLINT
+# include <sys/wait.h>  // NOLINT
+#endif  // !H2OFT_OS_WINDOWS && !H2OFT_OS_NACL
+
+// Parameter files and result logs are memory mapped where available, see MappedFile and AppendFile.
+#if !H2OFT_OS_WINDOWS && !H2OFT_OS_NACL
+# define H2OFT_HAS_MMAP_ 1
+# include <fcntl.h>  // NOLINT
+# include <sys/mman.h>  // NOLINT
+# include <sys/stat.h>  // NOLINT
+#endif  // !H2OFT_OS_WINDOWS && !H2OFT_OS_NACL
+
+// Tests are timed with the time stamp counter on x86 with H2OFT_USE_TSC, see TscClock.
+#if defined(H2OFT_USE_TSC) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+# define H2OFT_HAS_TSC_ 1
+# ifdef _MSC_VER
+#  include <intrin.h>
+# else
+#  include <x86intrin.h>
+# endif
+#endif
+
+// The bodies of the tests are measured with perf_event counters with H2OFT_PERF_COUNTERS, see PerfCounters.
+#if defined(H2OFT_PERF_COUNTERS) && H2OFT_OS_LINUX
+# define H2OFT_HAS_PERF_EVENTS_ 1
+# include <linux/perf_event.h>  // NOLINT
+# include <sys/syscall.h>  // NOLINT
+#endif
+
+// Coroutine tests with C++20, see AsyncTest. The library may be built with an older standard:
+// the coroutine support is compiled with the tests, in the header.
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+# if __cpp_impl_coroutine >= 201902L && __has_include(<coroutine>)
+#  define H2OFT_HAS_COROUTINES_ 1
+#  include <coroutine>
+#  if !H2OFT_OS_WINDOWS
+#   define H2OFT_HAS_POLL_ 1
+#   include <poll.h>  // NOLINT
+#  endif
+# endif
+#endif
+
 #if _MSC_VER >= 1500
 # define H2OFT_DISABLE_MSC_WARNINGS_PUSH_(warnings) \
     __pragma(warning(push))                        \
@@ -196,6 +243,29 @@ namespace posix {
 
 }  // namespace posix
 
+// Out-of-line functions are defined inline in every translation unit by default.
+// With H2OFT_SEPARATE_COMPILATION, they are only declared, and defined once in the
+// translation unit which defines H2OFT_IMPLEMENTATION before the include, see src/H2OFastTests.cpp.
+// This saves compiling these functions, not parsing the headers: the classes and templates
+// which stay in the header still need every standard and system include of the library.
+#if !defined(H2OFT_SEPARATE_COMPILATION)
+# define H2OFT_INLINE inline
+# define H2OFT_DEFINE_FUNCTIONS_ 1
+#elif defined(H2OFT_IMPLEMENTATION)
+# define H2OFT_INLINE
+# define H2OFT_DEFINE_FUNCTIONS_ 1
+#else
+# define H2OFT_DEFINE_FUNCTIONS_ 0
+#endif
+
+// Lets the compiler check the arguments of a printf like function: the indices of its format
+// and of its first variadic argument, counting this as the first argument of a member
+#if defined(__GNUC__) || defined(__clang__)
+# define H2OFT_PRINTF_FORMAT_(format_index, first_index) __attribute__((format(printf, format_index, first_index)))
+#else
+# define H2OFT_PRINTF_FORMAT_(format_index, first_index)
+#endif
+
 #define FOREGROUND_INTENSITY 0x0008 // text color is intensified.
 #define BACKGROUND_INTENSITY 0x0080 // background color is intensified.
 
@@ -212,8 +282,9 @@ enum H2OFTColor {
 #if H2OFT_OS_WINDOWS && !H2OFT_OS_WINDOWS_MOBILE && \
     !H2OFT_OS_WINDOWS_PHONE && !H2OFT_OS_WINDOWS_RT
 
+#if H2OFT_DEFINE_FUNCTIONS_
 // Returns the character attribute for the given color.
-WORD GetForegroundColorAttribute(H2OFTColor color) {
+H2OFT_INLINE WORD GetForegroundColorAttribute(H2OFTColor color) {
     switch (color) {
     case COLOR_RED:    return FOREGROUND_RED;
     case COLOR_GREEN:  return FOREGROUND_GREEN;
@@ -224,6 +295,9 @@ WORD GetForegroundColorAttribute(H2OFTColor color) {
     default:           return 0;
     }
 }
+#else
+WORD GetForegroundColorAttribute(H2OFTColor color);
+#endif
 
 /*
 // Returns the character attribute for the given color.
@@ -240,7 +314,8 @@ default:           return 0;
 }
 */
 
-#else
+#endif  // H2OFT_OS_WINDOWS && !H2OFT_OS_WINDOWS_MOBILE
+
 /*
 Black       0;30     Dark Gray     1;30
 Blue        0;34     Light Blue    1;34
@@ -251,8 +326,9 @@ Purple      0;35     Light Purple  1;35
 Brown       0;33     Yellow        1;33
 Light Gray  0;37     White         1;37
 */
+#if H2OFT_DEFINE_FUNCTIONS_
 // Returns the ANSI color code for the given color.
-const char* GetAnsiColorCode(H2OFTColor color) {
+H2OFT_INLINE const char* GetAnsiColorCode(H2OFTColor color) {
     switch (color) {
     case COLOR_RED:     return "1";
     case COLOR_GREEN:   return "2";
@@ -264,10 +340,8 @@ const char* GetAnsiColorCode(H2OFTColor color) {
     };
 }
 
-#endif  // H2OFT_OS_WINDOWS && !H2OFT_OS_WINDOWS_MOBILE
-
 // Returns true iff Google Test should use colors in the output.
-bool ShouldUseColor(bool stdout_is_tty) {
+H2OFT_INLINE bool ShouldUseColor(bool stdout_is_tty) {
     const std::string H2OFT_color = "auto";
 
     if (H2OFT_color == "auto") {
@@ -332,7 +406,7 @@ bool ShouldUseColor(bool stdout_is_tty) {
 // cannot simply emit special characters and have the terminal change colors.
 // This routine must actually emit the characters rather than return a string
 // that would be colored when printed, as can be done on Linux.
-void ColoredPrintf(H2OFTColor color, const char* fmt, ...) {
+H2OFT_INLINE void ColoredPrintf(H2OFTColor color, const char* fmt, ...) {
     va_list args;
     va_start(args, fmt);
 
@@ -379,5 +453,10 @@ void ColoredPrintf(H2OFTColor color, const char* fmt, ...) {
 #endif  // H2OFT_OS_WINDOWS && !H2OFT_OS_WINDOWS_MOBILE
     va_end(args);
 }
+#else
+const char* GetAnsiColorCode(H2OFTColor color);
+bool ShouldUseColor(bool stdout_is_tty);
+void ColoredPrintf(H2OFTColor color, const char* fmt, ...);
+#endif  // H2OFT_DEFINE_FUNCTIONS_
 
 #endif
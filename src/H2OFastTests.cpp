@@ -0,0 +1,14 @@
+/*
+ *
+ *  (C) Copyright 2016 Michaël Roynard
+ *
+ *  Distributed under the MIT License, Version 1.0. (See accompanying
+ *  file LICENSE or copy at https://opensource.org/licenses/MIT)
+ *
+ *  See https://github.com/dutiona/H2OFastTests for documentation.
+ */
+
+// Single translation unit defining the out-of-line functions of the library when it is
+// built with H2OFT_SEPARATE_COMPILATION; the other translation units only see their declarations.
+#define H2OFT_IMPLEMENTATION
+#include "H2OFastTests.hpp"
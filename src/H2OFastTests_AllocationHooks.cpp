@@ -0,0 +1,106 @@
+/*
+ *
+ *  (C) Copyright 2016 Michaël Roynard
+ *
+ *  Distributed under the MIT License, Version 1.0. (See accompanying
+ *  file LICENSE or copy at https://opensource.org/licenses/MIT)
+ *
+ *  See https://github.com/dutiona/H2OFastTests for documentation.
+ */
+
+// Replaces the global operator new and delete to count the allocations of the running test,
+// see AllocationCounter. Link it in a test executable, at most once: this is the
+// H2OFastTestsAllocationHooks object library with CMake.
+// Each block is preceded by a header holding its size and its counter. Overaligned
+// allocations keep the default operators: they are not counted.
+#include "H2OFastTests.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+    struct alignas(std::max_align_t) BlockHeader {
+        size_t size;
+        uint64_t token; // of the counter which allocated the block, 0 if none
+    };
+
+    void* allocate(size_t size) noexcept {
+        auto block = static_cast<BlockHeader*>(std::malloc(sizeof(BlockHeader) + size));
+        if (block == nullptr) {
+            return nullptr;
+        }
+        const auto counter = H2OFastTests::detail::AllocationCounter::current();
+        block->size = size;
+        block->token = counter ? counter->allocate(size) : 0;
+        return block + 1;
+    }
+
+    void deallocate(void* pointer) noexcept {
+        if (pointer == nullptr) {
+            return;
+        }
+        const auto block = static_cast<BlockHeader*>(pointer) - 1;
+        if (const auto counter = H2OFastTests::detail::AllocationCounter::current()) {
+            counter->deallocate(block->token, block->size);
+        }
+        std::free(block);
+    }
+
+    const bool installed = (H2OFastTests::detail::AllocationCounter::installed() = true);
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    for (;;) {
+        if (auto pointer = allocate(size)) {
+            return pointer;
+        }
+        const auto handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc{};
+        }
+        handler();
+    }
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return ::operator new(size);
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return ::operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept {
+    deallocate(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    deallocate(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    deallocate(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    deallocate(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    deallocate(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    deallocate(pointer);
+}
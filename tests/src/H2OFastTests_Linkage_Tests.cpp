@@ -0,0 +1,55 @@
+/*
+*
+*  (C) Copyright 2016 Michal Roynard
+*
+*  Distributed under the MIT License, Version 1.0. (See accompanying
+*  file LICENSE or copy at https://opensource.org/licenses/MIT)
+*
+*  See https://github.com/dutiona/H2OFastTests for documentation.
+*/
+
+
+// Second translation unit of the test executable: checks that the scenarios of every
+// translation unit share the same registry, whether the library is header only or
+// compiled separately (H2OFT_SEPARATE_COMPILATION).
+
+#include "H2OFastTests.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace H2OFastTests::Asserter;
+
+register_scenario(H2OFastTests_Linkage_Tests)
+{
+    add_test("Linkage::Scenarios of every translation unit share the registry", []() {
+        std::vector<std::string> names;
+        for (const auto& slot : H2OFastTests::detail::get_registry().getAllSlots()) {
+            if (slot->recorder) {
+                names.push_back(H2OFastTests::detail::scenario_name(slot->recorder->name()));
+            }
+        }
+        const auto registered = [&names](const std::string& name) { return std::find(names.begin(), names.end(), name) != names.end(); };
+        AssertThat(registered("H2OFastTests_Linkage_Tests")).isTrue("Expect the scenario of this translation unit");
+        AssertThat(registered("H2OFastTests_Tests")).isTrue("Expect the scenarios of the other translation unit");
+    });
+
+    add_test("Linkage::Failures are raised by the shared definitions", []() {
+        try {
+            AssertThat(1).isEqualTo(2, "Failing on purpose");
+        }
+        catch (const H2OFastTests::detail::GenericTestFailure& failure) {
+            AssertThat(std::string{ failure.what() }.find("[REACHED] 1") != std::string::npos).isTrue("Expect the reached value in what()");
+            return;
+        }
+        AssertThat(false).isTrue("Expect the assert to throw");
+    });
+}
+
+bool run_linkage_tests() {
+    register_observer(H2OFastTests_Linkage_Tests, H2OFastTests::ConsoleIO_Observer);
+    run_scenario(H2OFastTests_Linkage_Tests);
+    print_result(H2OFastTests_Linkage_Tests);
+    return H2OFastTests_Linkage_Tests_registry_manager.getPassedCount() == H2OFastTests_Linkage_Tests_registry_manager.getAllTestsCount();
+}
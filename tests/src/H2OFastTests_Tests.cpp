@@ -10,9 +10,21 @@
 
 #include "H2OFastTests.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <limits>
+#include <memory>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 using namespace H2OFastTests::Asserter;
 
@@ -132,6 +144,79 @@ register_scenario(H2OFastTests_Tests)
         AssertThat(false).isFalse("Expect true != false");
     });
 
+    add_test("Assert::Failure message is built once, on demand", []() {
+        try {
+            AssertThat(std::string{ "aaa" }).isEqualTo(std::string{ "bbb" }, false, "Expect aaa == bbb");
+        }
+        catch (const H2OFastTests::detail::GenericTestFailure& failure) {
+            const auto message = std::string{ failure.what() };
+            AssertThat(message.find("Expect aaa == bbb") != std::string::npos).isTrue("Expect the message in what()");
+            AssertThat(message.find("[REACHED] aaa") != std::string::npos).isTrue("Expect the reached value in what()");
+            AssertThat(std::string{ failure.what() }).isEqualTo(message, false, "Expect what() to be stable");
+            return;
+        }
+        AssertThat(false).isTrue("Expect the assert to throw");
+    });
+
+    add_test("Assert::Failure operands are printed as streamed", []() {
+        const auto failure_of = [](auto&& assert) {
+            try {
+                assert();
+            }
+            catch (const H2OFastTests::detail::GenericTestFailure& failure) {
+                return std::string{ failure.what() };
+            }
+            return std::string{};
+        };
+        const auto integers = failure_of([]() { AssertThat(-1).isEqualTo(2); });
+        AssertThat(integers.find("[REACHED] -1\n\t\t\t[EXPECTED EQUAL TO] 2\n") != std::string::npos).isTrue("Expect the integers");
+        const auto doubles = failure_of([]() { AssertThat(0.5).isNotEqualTo(0.5); });
+        AssertThat(doubles.find("[REACHED] 0.5\n\t\t\t[EXPECTED DIFFERENT FROM] 0.5\n") != std::string::npos).isTrue("Expect the doubles");
+        const auto characters = failure_of([]() { AssertThat('a').isEqualTo('b'); });
+        AssertThat(characters.find("[REACHED] a\n") != std::string::npos).isTrue("Expect the characters");
+        const auto custom = failure_of([]() { AssertThat(CustomClass{ true }).isEqualTo(CustomClass{ false }); });
+        AssertThat(custom.find("[REACHED] is different from [EXPECTED]. Expected [EQUAL TO]") != std::string::npos).isTrue("Expect no values without operator<<");
+        const auto exception = failure_of([]() { AssertThat([]() {}).expectException<CustomException>(); });
+        AssertThat(exception.find("[EXPECTED Exception] ") != std::string::npos).isTrue("Expect the expected exception");
+    });
+
+    add_test("Assert::Elementwise equal ranges", []() {
+        std::vector<int> reached(1000000, 3);
+        const auto expected = reached;
+        AssertThat(reached).isElementwiseEqualTo(expected, "Expect equal buffers");
+        const int values[] = { 1, 2, 3 };
+        AssertThat(std::vector<int>{ 1, 2, 3 }).isElementwiseEqualTo(values, "Expect a vector equal to an array");
+        AssertThat(std::vector<CustomClass>{ { true }, { false } }).isElementwiseEqualTo(std::vector<CustomClass>{ { true }, { false } }, "Expect operator== to be used");
+        AssertThat(std::vector<double>{ 1., 2. }).isElementwiseNear(std::vector<double>{ 1. + 1e-9, 2. - 1e-9 }, 1e-6, "Expect near doubles");
+    });
+
+    add_test("Assert::Elementwise failures report the first mismatch", []() {
+        const auto failure_of = [](auto&& assert) {
+            try {
+                assert();
+            }
+            catch (const H2OFastTests::detail::GenericTestFailure& failure) {
+                return std::string{ failure.what() };
+            }
+            return std::string{};
+        };
+        std::vector<int> reached(1000000, 0);
+        const auto expected = reached;
+        reached[123456] = 1;
+        reached[999999] = 2;
+        const auto mismatch = failure_of([&]() { AssertThat(reached).isElementwiseEqualTo(expected, "Expect equal buffers"); });
+        AssertThat(mismatch.find("[FIRST MISMATCH AT] 123456\n") != std::string::npos).isTrue("Expect the first mismatch");
+        AssertThat(mismatch.find("[REACHED] from 123452: 0 0 0 0 [1] 0 0 0 0\n") != std::string::npos).isTrue("Expect the values around it");
+        AssertThat(mismatch.find("[REACHED SIZE]") == std::string::npos).isTrue("Expect no size mismatch");
+
+        const auto sizes = failure_of([]() { AssertThat(std::vector<float>{ 1.f, 2.f }).isElementwiseEqualTo(std::vector<float>{ 1.f, 2.f, 3.f }); });
+        AssertThat(sizes.find("[REACHED SIZE] 2 [EXPECTED SIZE] 3") != std::string::npos).isTrue("Expect the sizes");
+        AssertThat(sizes.find("[FIRST MISMATCH AT]") == std::string::npos).isTrue("Expect no mismatch in the common elements");
+
+        const auto nan = failure_of([]() { AssertThat(std::vector<double>{ 0., std::nan("") }).isElementwiseNear(std::vector<double>{ 0., 0. }, 1.); });
+        AssertThat(nan.find("[FIRST MISMATCH AT] 1\n") != std::string::npos && nan.find("[TOLERANCE] 1\n") != std::string::npos).isTrue("Expect NaN to be far from anything");
+    });
+
     add_test("Assert::ExceptException<CustomException>", []() {
         AssertThat([]() {
             throw CustomException{};
@@ -141,11 +226,1531 @@ register_scenario(H2OFastTests_Tests)
     });
 }
 
+std::atomic<int> running_tests{ 0 };
+
+register_scenario(H2OFastTests_Parallel_Tests)
+{
+    for (int i = 0; i < 8; ++i) {
+        add_test("Parallel::Concurrent #" + std::to_string(i), []() {
+            ++running_tests;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            --running_tests;
+        });
+    }
+
+    add_serial_test("Parallel::Serial runs alone", []() {
+        AssertThat(running_tests.load() == 0).isTrue("Expect no concurrent test while a serial test runs");
+    });
+
+    add_test("Parallel::Concurrent after serial", []() {
+        AssertThat(true).isTrue("Expect true == true");
+    });
+}
+
+register_scenario(H2OFastTests_Isolation_Tests)
+{
+    add_test("Isolation::Before crash", []() {
+        AssertThat(true).isTrue("Expect true == true");
+    });
+
+#if H2OFT_HAS_FORK_ || H2OFT_OS_WINDOWS_DESKTOP
+    add_test("Isolation::Crash is reported as an error", []() {
+        std::abort();
+    });
+
+    add_test("Isolation::Hang is killed", H2OFastTests::detail::Duration{ 200 }, []() {
+        for (;;) {
+            std::this_thread::sleep_for(std::chrono::seconds{ 1 });
+        }
+    });
+#endif
+
+    add_test("Isolation::After crash", []() {
+        AssertThat(true).isTrue("Expect true == true");
+    });
+
+    add_serial_test("Isolation::Serial", []() {
+        AssertThat(false).isFalse("Expect false == false");
+    });
+
+    for (int i = 0; i < 4; ++i) {
+        add_test("Isolation::Worker #" + std::to_string(i), []() {
+            AssertThat(1 + 1).isEqualTo(2, "Expect 1 + 1 == 2");
+        });
+    }
+
+    H2OFastTests::BenchmarkOptions quick;
+    quick.samples = 3;
+    quick.warmup_time = H2OFastTests::detail::Duration{ 0.1 };
+    quick.min_sample_time = H2OFastTests::detail::Duration{ 0.1 };
+    add_benchmark("Isolation::Benchmark", quick, []() {
+        H2OFastTests::ClobberMemory();
+    });
+}
+
+register_scenario(H2OFastTests_Sharding_Tests)
+{
+    using H2OFastTests::detail::Duration;
+
+    add_test("Sharding::Partition is balanced by time", []() {
+        const auto bins = H2OFastTests::detail::partition_by_cost({ Duration{ 30 }, Duration{ 10 }, Duration{ 10 }, Duration{ 10 } }, 2);
+        AssertThat(bins[0] == 0).isTrue("Expect the longest test alone on shard 0");
+        AssertThat(bins[1] == 1 && bins[2] == 1 && bins[3] == 1).isTrue("Expect the short tests together on shard 1");
+    });
+
+    add_test("Sharding::Timing file round trip", []() {
+        H2OFastTests::detail::TimingStore store;
+        store.set("Scenario", "label\twith\ttabs", Duration{ 12.5 });
+        store.save("H2OFastTests_timings.tmp");
+        H2OFastTests::detail::TimingStore loaded;
+        loaded.load("H2OFastTests_timings.tmp");
+        std::remove("H2OFastTests_timings.tmp");
+        Duration time;
+        AssertThat(loaded.find("Scenario", "label\twith\ttabs", time)).isTrue("Expect the label to be found");
+        AssertThat(time.count()).isEqualTo(12.5, 1e-9, "Expect 12.5 ms");
+    });
+
+    add_test("Sharding::Command line", []() {
+        const char* argv[] = { "Tests", "--jobs=4", "--shard-index", "1", "--shard-count=3", "--unknown" };
+        const auto policy = H2OFastTests::parse_command_line(6, argv);
+        AssertThat(policy.mode == H2OFastTests::ExecutionPolicy::Mode::PARALLEL).isTrue("Expect a parallel run");
+        AssertThat(policy.workers).isEqualTo(4u, "Expect 4 workers");
+        AssertThat(policy.shard_index).isEqualTo(1u, "Expect shard 1");
+        AssertThat(policy.shard_count).isEqualTo(3u, "Expect 3 shards");
+        std::vector<std::string> unknown;
+        H2OFastTests::parse_command_line(6, argv, H2OFastTests::ExecutionPolicy::sequential(), &unknown);
+        AssertThat(unknown.size() == 1 && unknown[0] == "--unknown").isTrue("Expect the unknown option to be returned");
+
+        const char* typo[] = { "Tests", "--fliter=Foo" };
+        AssertThat(H2OFastTests::run_main(2, typo)).isEqualTo(2, "Expect run_main to refuse an unknown option without running the tests");
+
+        const char* invalid[] = { "Tests", "--shard-index=3", "--shard-count=3" };
+        AssertThat([&invalid]() { H2OFastTests::parse_command_line(3, invalid); }).expectException<std::invalid_argument>("Expect an out of range shard to throw");
+
+        const char* baseline[] = { "Tests", "--baseline=times.tsv", "--slow-ratio", "2.5", "--min-slowdown=0.5", "--update-baseline" };
+        const auto gated = H2OFastTests::parse_command_line(6, baseline);
+        AssertThat(gated.baseline_file).isEqualTo(std::string{ "times.tsv" }, false, "Expect the baseline file");
+        AssertThat(gated.slow_ratio).isEqualTo(2.5, 1e-9, "Expect a 2.5 slowdown ratio");
+        AssertThat(gated.min_slowdown.count()).isEqualTo(0.5, 1e-9, "Expect a 0.5 ms minimal slowdown");
+        AssertThat(gated.update_baseline).isTrue("Expect the baseline to be updated");
+
+        const char* timeout[] = { "Tests", "--timeout=250" };
+        AssertThat(H2OFastTests::parse_command_line(2, timeout).timeout.count()).isEqualTo(250.0, 1e-9, "Expect a 250 ms timeout");
+
+        const char* fail_fast[] = { "Tests", "--fail-fast" };
+        AssertThat(H2OFastTests::parse_command_line(2, fail_fast).max_failures == 1).isTrue("Expect to stop at the first failure");
+        const char* max_failures[] = { "Tests", "--max-failures", "3" };
+        AssertThat(H2OFastTests::parse_command_line(3, max_failures).max_failures == 3).isTrue("Expect to stop at the third failure");
+
+        const char* filtered[] = { "Tests", "--filter=Assert::*", "--filter", "[fast]", "--exclude=*Slow*" };
+        const auto filter = H2OFastTests::parse_command_line(5, filtered).filter;
+        AssertThat(filter.matches("Scenario", "Assert::AreEqual") && filter.matches("Scenario", "Parses [fast]")).isTrue("Expect the filters to add up");
+        AssertThat(filter.matches("Scenario", "Assert::Slow")).isFalse("Expect the excluded tests not to match");
+
+        const char* rerun[] = { "Tests", "--status-file", "status.tsv", "--only-failed" };
+        const auto incremental = H2OFastTests::parse_command_line(4, rerun);
+        AssertThat(incremental.status_file).isEqualTo(std::string{ "status.tsv" }, false, "Expect the status file");
+        AssertThat(incremental.order == H2OFastTests::ExecutionPolicy::Order::ONLY_FAILED).isTrue("Expect only the failed tests to run");
+        const char* failed_first[] = { "Tests", "--failed-first" };
+        AssertThat(H2OFastTests::parse_command_line(2, failed_first).order == H2OFastTests::ExecutionPolicy::Order::FAILED_FIRST).isTrue("Expect the failed tests first");
+
+        const char* invalid_ratio[] = { "Tests", "--slow-ratio=fast" };
+        AssertThat([&invalid_ratio]() { H2OFastTests::parse_command_line(2, invalid_ratio); }).expectException<std::invalid_argument>("Expect an invalid ratio to throw");
+    });
+}
+
+// Counts the results of a scenario through the visitor interface
+template<class ScenarioName>
+class RegistryTraversal_Counter : private H2OFastTests::IRegistryTraversal<ScenarioName> {
+public:
+    RegistryTraversal_Counter(const H2OFastTests::RegistryManager<ScenarioName>& registry) : H2OFastTests::IRegistryTraversal<ScenarioName>(registry) {}
+    size_t count() const {
+        size_t visited = 0;
+        this->visit([&visited](const H2OFastTests::Test&) { ++visited; });
+        return visited;
+    }
+    size_t count(H2OFastTests::Test::Status status) const {
+        size_t visited = 0;
+        this->visit(status, [&visited](const H2OFastTests::Test&) { ++visited; });
+        return visited;
+    }
+};
+
+register_scenario(H2OFastTests_Storage_Tests)
+{
+    add_test("Storage::Traversals share the registry results without copying them", []() {
+        static_assert(!std::is_copy_constructible<H2OFastTests::RegistryManager<H2OFastTests_Sharding_Tests>>::value, "A registry must not be copied");
+        const auto& registry = H2OFastTests_Sharding_Tests_registry_manager;
+        const auto expected = registry.getPassedCount() + registry.getFailedCount() + registry.getSkippedCount() + registry.getWithErrorCount();
+        std::atomic<size_t> mismatches{ 0 };
+        std::vector<std::thread> reporters;
+        for (int i = 0; i < 4; ++i) {
+            reporters.emplace_back([&registry, &mismatches, expected]() {
+                const RegistryTraversal_Counter<H2OFastTests_Sharding_Tests> counter{ registry };
+                for (int j = 0; j < 1000; ++j) {
+                    if (counter.count() != expected || counter.count(H2OFastTests::Test::Status::PASSED) != registry.getPassedCount()) {
+                        ++mismatches;
+                    }
+                }
+            });
+        }
+        for (auto& reporter : reporters) {
+            reporter.join();
+        }
+        AssertThat(expected).isEqualTo(registry.getAllTestsCount(), "Expect every test of the scenario to be recorded");
+        AssertThat(mismatches.load() == 0).isTrue("Expect concurrent traversals to see every result");
+    });
+
+    add_test("Storage::Results by status come from one packed table", []() {
+        const auto& registry = H2OFastTests_Tests_registry_manager;
+        H2OFastTests::Duration total{ 0 };
+        for (auto status : { H2OFastTests::Test::Status::PASSED, H2OFastTests::Test::Status::FAILED, H2OFastTests::Test::Status::SKIPPED, H2OFastTests::Test::Status::ERROR }) {
+            H2OFastTests::Duration visited{ 0 };
+            registry.visit(status, [&visited](const H2OFastTests::Test& test) { visited += test.getExecTimeMs(); });
+            AssertThat(std::abs((visited - registry.getRecordedExecTimeMs(status)).count()) < 1e-9).isTrue("Expect the times of a status to be summed from the table");
+            total += visited;
+        }
+        AssertThat(std::abs((total - registry.getAllTestsExecTimeMs()).count()) < 1e-6).isTrue("Expect every result in the table");
+        AssertThat(registry.getFailedTests().size() == registry.getFailedCount()).isTrue("Expect the failed tests to be listed");
+        AssertThat(&registry.getFailedTests() == &registry.getFailedTests()).isTrue("Expect the list to be built once");
+        size_t listed = 0;
+        for (const auto& test : registry.getSkippedTests()) {
+            listed += test.get().getStatus() == H2OFastTests::Test::Status::SKIPPED;
+        }
+        AssertThat(listed == registry.getSkippedCount()).isTrue("Expect only the skipped tests in their list");
+    });
+
+    add_test("Storage::SmallFunction inline and heap callables", []() {
+        int calls = 0;
+        H2OFastTests::detail::SmallFunction small{ [&calls]() { ++calls; } };
+        char big_capture[256] = {};
+        H2OFastTests::detail::SmallFunction big{ [&calls, big_capture]() { calls += 1 + big_capture[0]; } };
+        auto moved_small = std::move(small);
+        auto moved_big = std::move(big);
+        moved_small();
+        moved_big();
+        AssertThat(calls).isEqualTo(2, "Expect both callables to be called once");
+        AssertThat(static_cast<bool>(small)).isFalse("Expect a moved from callable to be empty");
+    });
+
+    add_test("Storage::TestList keeps tests in registration order", []() {
+        H2OFastTests::detail::TestList list;
+        for (int i = 0; i < 1000; ++i) {
+            list.emplace("Test #" + std::to_string(i), []() {});
+        }
+        list.emplace<H2OFastTests::detail::SkippedTest>("Skipped", []() {});
+        AssertThat(list.size()).isEqualTo(1001u, "Expect 1001 tests");
+        AssertThat(std::string{ list[999]->getLabel(false) }).isEqualTo(std::string{ "Test #999" }, false, "Expect the registration order to be kept");
+        AssertThat(std::string{ list[1000]->getLabel(false) }).isEqualTo(std::string{ "Skipped" }, false, "Expect derived tests to be stored too");
+    });
+
+    add_test("Storage::Scenarios resolve to a single slot in registration order", []() {
+        auto& registry = H2OFastTests::detail::get_registry();
+        const auto index = H2OFastTests::detail::type_helper<H2OFastTests_Sharding_Tests>::type_index();
+        AssertThat(&registry.getTests(index) == &H2OFastTests_Sharding_Tests_registry_manager.getAllTests()).isTrue("Expect the scenario to keep its slot");
+        AssertThat(&registry.getSlot(index) == &registry.getSlot(index)).isTrue("Expect the slot to be created once");
+        std::vector<std::type_index> order;
+        for (const auto& slot : registry.getAllSlots()) {
+            order.push_back(slot->type);
+        }
+        const auto position = [&order](std::type_index type) { return std::find(order.begin(), order.end(), type) - order.begin(); };
+        AssertThat(position(typeid(H2OFastTests_Tests)) < position(typeid(H2OFastTests_Sharding_Tests))).isTrue("Expect the registration order");
+        AssertThat(position(typeid(H2OFastTests_Sharding_Tests)) < position(typeid(H2OFastTests_Storage_Tests))).isTrue("Expect the registration order");
+    });
+}
+
+// Counts its updates slowly, like an observer sending the results over the network
+class SlowObserver : public H2OFastTests::IRegistryObserver {
+public:
+    virtual void update(H2OFastTests::TestInfo) const override {
+        std::this_thread::sleep_for(std::chrono::microseconds{ 200 });
+        ++updates;
+    }
+    mutable std::atomic<size_t> updates{ 0 };
+};
+
+class ThrowingObserver : public H2OFastTests::IRegistryObserver {
+public:
+    virtual void update(H2OFastTests::TestInfo) const override {
+        throw std::runtime_error{ "Observer failure" };
+    }
+};
+
+std::string read_file(const char* path) {
+    std::ifstream file{ path, std::ios::binary };
+    return std::string{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+}
+
+size_t count_occurrences(const std::string& text, const std::string& pattern) {
+    size_t count = 0;
+    for (auto pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+// Scenario run by hand in a Reporting test
+struct UnretainedScenario {};
+
+register_scenario(H2OFastTests_Reporting_Tests)
+{
+    add_test("Reporting::JsonLinesReporter streams one line per result", []() {
+        size_t results = 0;
+        {
+            H2OFastTests::JsonLinesReporter reporter{ "H2OFastTests_report.jsonl.tmp", "H2OFastTests_Tests" };
+            H2OFastTests_Tests_registry_manager.visit([&reporter, &results](const H2OFastTests::Test& test) {
+                reporter.update(std::cref(test));
+                ++results;
+            });
+            const H2OFastTests::Test escaped{ "Quote \" backslash \\ tab \t" };
+            reporter.update(std::cref(escaped));
+            ++results;
+            AssertThat(count_occurrences(read_file("H2OFastTests_report.jsonl.tmp"), "\n") == results).isTrue("Expect each result to be written as soon as it is recorded");
+        }
+        const auto report = read_file("H2OFastTests_report.jsonl.tmp");
+        std::remove("H2OFastTests_report.jsonl.tmp");
+        AssertThat(count_occurrences(report, "\"status\":\"SKIPPED\"") == H2OFastTests_Tests_registry_manager.getSkippedCount()).isTrue("Expect the skipped tests to be reported");
+        AssertThat(report.find("\"name\":\"Quote \\\" backslash \\\\ tab \\t\"") != std::string::npos).isTrue("Expect the label to be escaped");
+    });
+
+    add_test("Reporting::JUnitReporter keeps the report well formed after each testcase", []() {
+        const char* closing = "</testsuite>\n</testsuites>\n";
+        H2OFastTests::JUnitReporter reporter{ "H2OFastTests_report.xml.tmp", "H2OFastTests_Tests" };
+        const H2OFastTests::Test escaped{ "<a & 'b'>" };
+        reporter.update(std::cref(escaped));
+        auto report = read_file("H2OFastTests_report.xml.tmp");
+        AssertThat(report.substr(report.size() - std::strlen(closing))).isEqualTo(std::string{ closing }, false, "Expect a complete document after the first testcase");
+        AssertThat(report.find("name=\"&lt;a &amp; &apos;b&apos;&gt;\"") != std::string::npos).isTrue("Expect the label to be escaped");
+        H2OFastTests_Tests_registry_manager.visit([&reporter](const H2OFastTests::Test& test) {
+            reporter.update(std::cref(test));
+        });
+        report = read_file("H2OFastTests_report.xml.tmp");
+        std::remove("H2OFastTests_report.xml.tmp");
+        AssertThat(count_occurrences(report, closing) == 1).isTrue("Expect the closing tags to be written once");
+        AssertThat(count_occurrences(report, "<testcase ") == H2OFastTests_Tests_registry_manager.getAllTestsCount() + 1).isTrue("Expect every result to be reported");
+        AssertThat(count_occurrences(report, "<skipped ") == H2OFastTests_Tests_registry_manager.getSkippedCount()).isTrue("Expect the skipped tests to be reported");
+    });
+
+    add_test("Reporting::AsyncObserver delivers every update of several producers", []() {
+        const auto slow = std::make_shared<SlowObserver>();
+        const H2OFastTests::Test test{ "Observed" };
+        H2OFastTests::AsyncObserver observer{ slow, 8 };
+        std::vector<std::thread> producers;
+        for (int i = 0; i < 4; ++i) {
+            producers.emplace_back([&observer, &test]() {
+                for (int j = 0; j < 50; ++j) {
+                    observer.update(std::cref(test));
+                }
+            });
+        }
+        for (auto& producer : producers) {
+            producer.join();
+        }
+        observer.flush();
+        AssertThat(slow->updates.load() == 200).isTrue("Expect every update to be delivered");
+        AssertThat(observer.getDroppedCount() == 0).isTrue("Expect no update to be dropped");
+    });
+
+    add_test("Reporting::AsyncObserver drops updates when full", []() {
+        const auto slow = std::make_shared<SlowObserver>();
+        const H2OFastTests::Test test{ "Observed" };
+        H2OFastTests::AsyncObserver observer{ slow, 4, H2OFastTests::AsyncObserver::Backpressure::DROP };
+        for (int i = 0; i < 100; ++i) {
+            observer.update(std::cref(test));
+        }
+        observer.flush();
+        AssertThat(observer.getDroppedCount() > 0).isTrue("Expect a full queue to drop updates");
+        AssertThat(slow->updates.load() + observer.getDroppedCount() == 100).isTrue("Expect every update to be either delivered or dropped");
+    });
+
+    add_test("Reporting::AsyncObserver rethrows the observer failures on flush", []() {
+        const H2OFastTests::Test test{ "Observed" };
+        H2OFastTests::AsyncObserver observer{ std::make_shared<ThrowingObserver>() };
+        observer.update(std::cref(test));
+        AssertThat([&observer]() { observer.flush(); }).expectException<std::runtime_error>("Expect the failure to be rethrown");
+    });
+
+    add_test("Reporting::ConsoleBuffer writes whole batches", []() {
+        const auto file = std::tmpfile();
+        AssertThat(file).isNotNull("Expect a temporary file");
+        {
+            H2OFastTests::ConsoleBuffer out{ file, 64, std::chrono::hours{ 1 } };
+            out.printf(COLOR_GREEN, "%s %d\n", "batch", 1);
+            AssertThat(std::ftell(file) == 0).isTrue("Expect nothing written before the batch is full");
+            out.printf(COLOR_RED, "%0100d\n", 2);
+            AssertThat(std::ftell(file) == 109).isTrue("Expect a full batch to be written at once");
+            out.printf(COLOR_DEFAULT, "end\n");
+        }
+        AssertThat(std::ftell(file) == 113).isTrue("Expect the last batch to be written on destruction");
+        char content[16] = {};
+        std::rewind(file);
+        AssertThat(std::fread(content, 1, 8, file) == 8).isTrue("Expect to read the first batch back");
+        std::fclose(file);
+        AssertThat(static_cast<const char*>(content)).isEqualTo("batch 1\n", false, "Expect no color codes outside of a terminal");
+    });
+
+    add_test("Reporting::BinaryResultLog is read back by the reporters", []() {
+        {
+            H2OFastTests::BinaryResultLog log{ "H2OFastTests_results.log.tmp" };
+            H2OFastTests_Tests_registry_manager.visit([&log](const H2OFastTests::Test& test) {
+                log.update(std::cref(test));
+            });
+        }
+        {
+            const H2OFastTests::ResultLogReader log{ "H2OFastTests_results.log.tmp" };
+            AssertThat(log.size() == H2OFastTests_Tests_registry_manager.getAllTestsCount()).isTrue("Expect every result to be logged");
+            for (auto status : { H2OFastTests::Test::Status::PASSED, H2OFastTests::Test::Status::FAILED, H2OFastTests::Test::Status::SKIPPED, H2OFastTests::Test::Status::ERROR }) {
+                AssertThat(log.getRecordedCount(status) == H2OFastTests_Tests_registry_manager.getRecordedCount(status)).isTrue("Expect the results counted by status");
+            }
+            std::vector<std::string> logged, recorded;
+            log.visit(H2OFastTests::Test::Status::FAILED, [&logged](const H2OFastTests::LoggedResult& result) {
+                logged.push_back(result.getLabel(false) + result.getFailureReason());
+            });
+            H2OFastTests_Tests_registry_manager.visit(H2OFastTests::Test::Status::FAILED, [&recorded](const H2OFastTests::Test& test) {
+                recorded.push_back(test.getLabel(false) + test.getFailureReason());
+            });
+            AssertThat(logged == recorded).isTrue("Expect the labels and messages of the failures");
+
+            const auto file = std::tmpfile();
+            AssertThat(file).isNotNull("Expect a temporary file");
+            {
+                H2OFastTests::ConsoleBuffer out{ file };
+                H2OFastTests::RegistryTraversal_ConsoleIO<H2OFastTests_Tests>::print(log, false, out);
+            }
+            std::string summary(static_cast<size_t>(std::ftell(file)), '\0');
+            std::rewind(file);
+            AssertThat(std::fread(&summary[0], 1, summary.size(), file) == summary.size()).isTrue("Expect to read the summary back");
+            std::fclose(file);
+            AssertThat(summary.find("UNIT TEST SUMMARY [H2OFastTests_Tests]") == 0).isTrue("Expect the summary of the scenario");
+            AssertThat(count_occurrences(summary, "\t\tMessage: ") >= log.getFailedCount() + log.getWithErrorCount()).isTrue("Expect the failures and errors to be printed");
+
+            {
+                H2OFastTests::JUnitReporter reporter{ "H2OFastTests_report.xml.tmp", "H2OFastTests_Tests" };
+                reporter.write(log);
+            }
+            const auto report = read_file("H2OFastTests_report.xml.tmp");
+            std::remove("H2OFastTests_report.xml.tmp");
+            AssertThat(count_occurrences(report, "<testcase ") == log.size()).isTrue("Expect a testcase per logged result");
+            AssertThat(count_occurrences(report, "<skipped ") == log.getSkippedCount()).isTrue("Expect the skipped tests to be reported");
+        }
+        std::remove("H2OFastTests_results.log.tmp.strings");
+        std::ofstream{ "H2OFastTests_results.log.tmp.strings" };
+        AssertThat([]() { H2OFastTests::ResultLogReader log{ "H2OFastTests_results.log.tmp" }; }).expectException<std::runtime_error>("Expect a log without its strings to be rejected");
+        std::remove("H2OFastTests_results.log.tmp");
+        std::remove("H2OFastTests_results.log.tmp.strings");
+    });
+
+    add_test("Reporting::Results that are not retained are counted and logged", []() {
+        {
+            H2OFastTests::RegistryManager<UnretainedScenario> registry{ []() {} };
+            registry.set_results_retained(false);
+            registry.addObserver(std::make_shared<H2OFastTests::BinaryResultLog>("H2OFastTests_unretained.log.tmp"));
+            registry.add_test("Passing", []() {});
+            registry.add_test("Failing", []() { AssertThat(1 + 1 == 3).isTrue("Expect some arithmetic"); });
+            registry.run_tests();
+            AssertThat(registry.getPassedCount() == 1 && registry.getFailedCount() == 1).isTrue("Expect the results to be counted");
+            AssertThat(registry.getFailedTests().empty()).isTrue("Expect the results not to be kept");
+            size_t visited = 0;
+            registry.visit([&visited](const H2OFastTests::Test&) { ++visited; });
+            AssertThat(visited == 0).isTrue("Expect nothing to visit");
+            for (auto test : registry.getAllTests()) {
+                AssertThat(test->getFailureReason().empty()).isTrue("Expect the messages to be freed");
+            }
+            const H2OFastTests::ResultLogReader log{ "H2OFastTests_unretained.log.tmp" };
+            AssertThat(log.size() == 2).isTrue("Expect both results to be logged");
+            AssertThat(log[1].label() == "Failing").isTrue("Expect the results in the order they were recorded");
+            AssertThat(log[1].message().find("Expect some arithmetic") != std::string_view::npos).isTrue("Expect the message to be logged");
+        }
+        std::remove("H2OFastTests_unretained.log.tmp");
+        std::remove("H2OFastTests_unretained.log.tmp.strings");
+    });
+}
+
+// Returns the test of a scenario registered with this label, if any
+template<class ScenarioName>
+const H2OFastTests::Test* find_test(const H2OFastTests::RegistryManager<ScenarioName>& registry, const std::string& label) {
+    for (auto test : registry.getAllTests()) {
+        if (test->getLabel(false) == label) {
+            return test;
+        }
+    }
+    return nullptr;
+}
+
+register_scenario(H2OFastTests_Benchmark_Tests)
+{
+    add_test("Benchmark::Statistics of the samples", []() {
+        std::vector<double> samples;
+        for (int i = 100; i > 0; --i) {
+            samples.push_back(i);
+        }
+        const auto stats = H2OFastTests::BenchmarkStats::from_samples(samples, 10);
+        AssertThat(stats.samples == 100 && stats.iterations == 10).isTrue("Expect the sample and iteration counts to be kept");
+        AssertThat(stats.min).isEqualTo(1.0, 1e-9, "Expect the smallest sample");
+        AssertThat(stats.median).isEqualTo(50.5, 1e-9, "Expect the middle of the two central samples");
+        AssertThat(stats.p99).isEqualTo(99.0, 1e-9, "Expect the 99th percentile");
+        AssertThat(stats.mean).isEqualTo(50.5, 1e-9, "Expect the mean");
+        AssertThat(stats.stddev).isEqualTo(29.011491975882, 1e-9, "Expect the sample standard deviation");
+    });
+
+    H2OFastTests::BenchmarkOptions quick;
+    quick.samples = 5;
+    quick.warmup_time = H2OFastTests::detail::Duration{ 1 };
+    quick.min_sample_time = H2OFastTests::detail::Duration{ 0.2 };
+    add_benchmark("Benchmark::AssertThat(int).isEqualTo", quick, []() {
+        int value = 42;
+        H2OFastTests::DoNotOptimize(value);
+        AssertThat(value).isEqualTo(42, "Expect 42");
+    });
+
+    add_test("Benchmark::Iterations are calibrated to the sample time", []() {
+        const auto benchmark = find_test(H2OFastTests_Benchmark_Tests_registry_manager, "Benchmark::AssertThat(int).isEqualTo");
+        AssertThat(benchmark).isNotNull("Expect the benchmark to be registered");
+        const auto stats = benchmark->getBenchmarkStats();
+        AssertThat(stats).isNotNull("Expect the benchmark to be measured");
+        AssertThat(stats->samples == 5).isTrue("Expect the requested number of samples");
+        AssertThat(stats->iterations > 1).isTrue("Expect several iterations per sample");
+        AssertThat(stats->min * stats->iterations >= 0.2 * 0.5).isTrue("Expect samples close to the sample time");
+        AssertThat(stats->min <= stats->median && stats->median <= stats->p99).isTrue("Expect ordered statistics");
+    });
+
+    add_test("Benchmark::Statistics come back from worker processes", []() {
+        const auto benchmark = find_test(H2OFastTests_Isolation_Tests_registry_manager, "Isolation::Benchmark");
+        AssertThat(benchmark).isNotNull("Expect the benchmark to be registered");
+        AssertThat(benchmark->getBenchmarkStats()).isNotNull("Expect the statistics of the worker");
+        AssertThat(benchmark->getBenchmarkStats()->samples == 3).isTrue("Expect the requested number of samples");
+    });
+
+    add_test("Benchmark::Plain tests have no statistics", []() {
+        const auto test = find_test(H2OFastTests_Benchmark_Tests_registry_manager, "Benchmark::Statistics of the samples");
+        AssertThat(test->getBenchmarkStats()).isNull("Expect no statistics");
+    });
+}
+
+// Scenario name for the tests scheduled outside of a registry
+class NamedRecorder : public H2OFastTests::detail::IRegistryRecorder {
+public:
+    virtual void record_result(const H2OFastTests::Test&) override {}
+    virtual void set_run() override {}
+    virtual const char* name() const override { return "Scenario"; }
+    virtual H2OFastTests::detail::Duration timeout() const override { return H2OFastTests::detail::Duration{ 0 }; }
+    virtual void report_timeout(const H2OFastTests::Test&, H2OFastTests::detail::Duration) override {}
+};
+
+// Counts the timeouts reported while the tests still run
+std::atomic<size_t> reported_timeouts{ 0 };
+
+class TimeoutCounter_Observer : public H2OFastTests::IRegistryObserver {
+public:
+    virtual void update(H2OFastTests::TestInfo) const override {}
+    virtual void updateTimeout(H2OFastTests::TestInfo, H2OFastTests::detail::Duration) const override {
+        ++reported_timeouts;
+    }
+};
+
+register_scenario(H2OFastTests_Timeout_Tests)
+{
+    using H2OFastTests::detail::Duration;
+
+    set_timeout(Duration{ 5000 });
+
+    add_test("Timeout::Sleep past its timeout", Duration{ 5 }, []() {
+        std::this_thread::sleep_for(std::chrono::milliseconds{ 50 });
+    });
+
+    add_test("Timeout::Within the scenario timeout", []() {
+        std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+    });
+
+    add_test("Timeout::Timed out tests are reported", []() {
+        const auto sleep = find_test(H2OFastTests_Timeout_Tests_registry_manager, "Timeout::Sleep past its timeout");
+        AssertThat(sleep->getStatus() == H2OFastTests::Test::Status::TIMEOUT).isTrue("Expect a test sleeping 10 times its timeout to be TIMEOUT");
+        AssertThat(sleep->getFailureReason().find("Exceeded its timeout") != std::string::npos).isTrue("Expect the timeout to be explained");
+        AssertThat(sleep->getTimeout().count()).isEqualTo(5.0, 1e-9, "Expect the timeout of the test");
+        AssertThat(reported_timeouts.load() >= 1).isTrue("Expect the observers to hear of it while it ran");
+        const auto within = find_test(H2OFastTests_Timeout_Tests_registry_manager, "Timeout::Within the scenario timeout");
+        AssertThat(within->getStatus() == H2OFastTests::Test::Status::PASSED).isTrue("Expect a test within its timeout to pass");
+    });
+
+#if H2OFT_HAS_FORK_ || H2OFT_OS_WINDOWS_DESKTOP
+    add_test("Timeout::Hung worker processes are killed", []() {
+        const auto hang = find_test(H2OFastTests_Isolation_Tests_registry_manager, "Isolation::Hang is killed");
+        AssertThat(hang->getStatus() == H2OFastTests::Test::Status::TIMEOUT).isTrue("Expect a hung test to be TIMEOUT");
+        AssertThat(hang->getFailureReason().find("worker process was killed") != std::string::npos).isTrue("Expect the kill to be explained");
+        const auto after = find_test(H2OFastTests_Isolation_Tests_registry_manager, "Isolation::After crash");
+        AssertThat(after->getStatus() == H2OFastTests::Test::Status::PASSED).isTrue("Expect the respawned worker to run the next tests");
+    });
+#endif
+}
+
+// Run by main with a baseline in which "Baseline::Sleep" is much faster than it is
+register_scenario(H2OFastTests_Baseline_Tests)
+{
+    add_test("Baseline::Sleep", []() {
+        std::this_thread::sleep_for(std::chrono::milliseconds{ 5 });
+    });
+
+    add_test("Baseline::Within its baseline", []() {
+        std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+    });
+
+    add_test("Baseline::Not in the baseline", []() {
+        std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+    });
+
+    add_test("Baseline::Slowdowns are reported when recorded", []() {
+        const auto slow = find_test(H2OFastTests_Baseline_Tests_registry_manager, "Baseline::Sleep");
+        AssertThat(slow->getStatus() == H2OFastTests::Test::Status::SLOW).isTrue("Expect a test 10 times slower than its baseline to be SLOW");
+        AssertThat(slow->getFailureReason().find("Slower than its baseline") != std::string::npos).isTrue("Expect the slowdown to be explained");
+        AssertThat(find_test(H2OFastTests_Baseline_Tests_registry_manager, "Baseline::Within its baseline")->getStatus() == H2OFastTests::Test::Status::PASSED).isTrue("Expect a test faster than its baseline to pass");
+        AssertThat(find_test(H2OFastTests_Baseline_Tests_registry_manager, "Baseline::Not in the baseline")->getStatus() == H2OFastTests::Test::Status::PASSED).isTrue("Expect a new test to pass");
+    });
+
+    add_test("Baseline::Known references are only replaced on demand", []() {
+        NamedRecorder recorder;
+        std::vector<H2OFastTests::detail::ScheduledTest> tasks;
+        for (auto test : H2OFastTests_Baseline_Tests_registry_manager.getAllTests()) {
+            if (test->getStatus() == H2OFastTests::Test::Status::PASSED) {
+                tasks.push_back({ test, nullptr, nullptr, &recorder });
+            }
+        }
+        H2OFastTests::detail::TimingStore reference;
+        reference.set("Scenario", "Baseline::Within its baseline", H2OFastTests::detail::Duration{ 1000 });
+        reference.save("H2OFastTests_baseline_save.tmp");
+
+        auto policy = H2OFastTests::ExecutionPolicy::sequential();
+        policy.baseline_file = "H2OFastTests_baseline_save.tmp";
+        H2OFastTests::detail::BaselineGate{ policy }.save(tasks);
+        H2OFastTests::detail::TimingStore kept;
+        kept.load("H2OFastTests_baseline_save.tmp");
+        H2OFastTests::detail::Duration time;
+        AssertThat(kept.find("Scenario", "Baseline::Within its baseline", time) && time.count() == 1000).isTrue("Expect a known reference to be kept");
+        AssertThat(kept.find("Scenario", "Baseline::Not in the baseline", time)).isTrue("Expect a new test to be added");
+
+        policy.update_baseline = true;
+        H2OFastTests::detail::BaselineGate{ policy }.save(tasks);
+        H2OFastTests::detail::TimingStore updated;
+        updated.load("H2OFastTests_baseline_save.tmp");
+        std::remove("H2OFastTests_baseline_save.tmp");
+        AssertThat(updated.find("Scenario", "Baseline::Within its baseline", time) && time.count() < 1000).isTrue("Expect the reference to be replaced");
+    });
+}
+
+// Keeps the labels of the results it is handed
+class ListRecorder : public NamedRecorder {
+public:
+    virtual void record_result(const H2OFastTests::Test& test) override {
+        labels.push_back(test.getLabel(false));
+    }
+    std::vector<std::string> labels;
+};
+
+using TestPtrList = std::vector<std::unique_ptr<H2OFastTests::Test>>;
+
+// Schedules tests without fixtures
+std::vector<H2OFastTests::detail::ScheduledTest> schedule(const TestPtrList& tests, H2OFastTests::detail::IRegistryRecorder& recorder) {
+    static const H2OFastTests::detail::SetUpFunctor none = []() {};
+    std::vector<H2OFastTests::detail::ScheduledTest> tasks;
+    for (const auto& test : tests) {
+        tasks.push_back({ test.get(), &none, &none, &recorder });
+    }
+    return tasks;
+}
+
+register_scenario(H2OFastTests_Cancellation_Tests)
+{
+    using H2OFastTests::detail::make_test;
+
+    add_test("Cancellation::Fail fast stops at the first failure", []() {
+        TestPtrList tests;
+        tests.push_back(make_test("Pass", []() {}));
+        tests.push_back(make_test("Fail", []() { AssertThat(false).isTrue("Expect to fail"); }));
+        tests.push_back(make_test("Not run", []() {}));
+        ListRecorder recorder;
+        const auto policy = H2OFastTests::ExecutionPolicy::fail_fast();
+        H2OFastTests::detail::TestScheduler{ policy }.run(schedule(tests, recorder));
+        AssertThat(recorder.labels.size() == 2 && recorder.labels.back() == "Fail").isTrue("Expect the run to stop after the failure");
+        AssertThat(tests[2]->getStatus() == H2OFastTests::Test::Status::NONE).isTrue("Expect the next test not to run");
+        AssertThat(policy.cancellation.isCancelled() && policy.cancellation.getFailureCount() == 1).isTrue("Expect the token to be cancelled");
+
+        H2OFastTests::detail::TestScheduler{ policy }.run(schedule(tests, recorder));
+        AssertThat(recorder.labels.size() == 2).isTrue("Expect a run sharing the cancelled token not to start");
+    });
+
+    add_test("Cancellation::Parallel workers stop at the failure limit", []() {
+        TestPtrList tests;
+        for (int i = 0; i < 2; ++i) {
+            tests.push_back(make_test("Fail #" + std::to_string(i), []() { AssertThat(false).isTrue("Expect to fail"); }));
+        }
+        for (int i = 0; i < 40; ++i) {
+            tests.push_back(make_test("Sleep #" + std::to_string(i), []() { std::this_thread::sleep_for(std::chrono::milliseconds{ 2 }); }));
+        }
+        ListRecorder recorder;
+        auto policy = H2OFastTests::ExecutionPolicy::parallel(2);
+        policy.max_failures = 2;
+        H2OFastTests::detail::TestScheduler{ policy }.run(schedule(tests, recorder));
+        AssertThat(recorder.labels.size() >= 2 && recorder.labels[0] == "Fail #0" && recorder.labels[1] == "Fail #1").isTrue("Expect the failures to be recorded first");
+        AssertThat(recorder.labels.size() < tests.size()).isTrue("Expect the workers to stop early");
+    });
+
+    add_test("Cancellation::A test can cancel the run", []() {
+        TestPtrList tests;
+        H2OFastTests::CancellationToken token;
+        for (int i = 0; i < 100; ++i) {
+            tests.push_back(make_test("Sleep #" + std::to_string(i), [token, i]() {
+                if (i == 5) {
+                    token.cancel();
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+            }));
+        }
+        ListRecorder recorder;
+        auto policy = H2OFastTests::ExecutionPolicy::parallel(2);
+        policy.cancellation = token;
+        H2OFastTests::detail::TestScheduler{ policy }.run(schedule(tests, recorder));
+        AssertThat(recorder.labels.size() < tests.size()).isTrue("Expect the workers to stop early");
+        AssertThat(token.getFailureCount() == 0).isTrue("Expect no failure");
+    });
+
+#if H2OFT_HAS_FORK_
+    add_test("Cancellation::Worker processes are killed at the failure limit", []() {
+        TestPtrList tests;
+        tests.push_back(make_test("Fail", []() { AssertThat(false).isTrue("Expect to fail"); }));
+        for (int i = 0; i < 20; ++i) {
+            tests.push_back(make_test("Sleep #" + std::to_string(i), []() { std::this_thread::sleep_for(std::chrono::milliseconds{ 20 }); }));
+        }
+        ListRecorder recorder;
+        H2OFastTests::detail::TestScheduler{ H2OFastTests::ExecutionPolicy::fail_fast(H2OFastTests::ExecutionPolicy::processes(2)) }.run(schedule(tests, recorder));
+        AssertThat(recorder.labels.size() >= 1 && recorder.labels[0] == "Fail").isTrue("Expect the failure to be recorded");
+        AssertThat(recorder.labels.size() < tests.size()).isTrue("Expect the workers to be stopped early");
+    });
+#endif
+}
+
+register_scenario(H2OFastTests_Filtering_Tests)
+{
+    using H2OFastTests::detail::GlobPattern;
+
+    add_test("Filtering::Globs", []() {
+        AssertThat(GlobPattern{ "Assert::AreEqual" }.matches("Assert::AreEqual")).isTrue("Expect a plain pattern to match itself");
+        AssertThat(GlobPattern{ "Assert::AreEqual" }.matches("Assert::AreEqualTo")).isFalse("Expect a plain pattern to match nothing else");
+        AssertThat(GlobPattern{ "Assert::*" }.matches("Assert::AreEqual")).isTrue("Expect a prefix to match");
+        AssertThat(GlobPattern{ "*Equal" }.matches("Assert::AreEqual")).isTrue("Expect a suffix to match");
+        AssertThat(GlobPattern{ "*" }.matches("")).isTrue("Expect a star to match the empty label");
+        AssertThat(GlobPattern{ "A*Are*l" }.matches("Assert::AreEqual")).isTrue("Expect the pieces to be found in order");
+        AssertThat(GlobPattern{ "*a*a*" }.matches("a")).isFalse("Expect every piece to be found once");
+        AssertThat(GlobPattern{ "*a*ab" }.matches("aab")).isTrue("Expect the last piece to be anchored at the end");
+        AssertThat(GlobPattern{ "Assert::AreEqua?" }.matches("Assert::AreEqual")).isTrue("Expect ? to match any character");
+        AssertThat(GlobPattern{ "*::?re*" }.matches("Assert::AreEqual")).isTrue("Expect ? to match inside a piece");
+        AssertThat(GlobPattern{ "?" }.matches("")).isFalse("Expect ? to match exactly one character");
+    });
+
+    add_test("Filtering::Filters match the label, the scenario and both", []() {
+        H2OFastTests::TestFilter filter;
+        AssertThat(filter.empty() && filter.matches("Scenario", "Anything")).isTrue("Expect an empty filter to match everything");
+        filter.include("Parse*, Render/Draw*");
+        AssertThat(filter.matches("Scenario", "Parse dates")).isTrue("Expect the label to match");
+        AssertThat(filter.matches("Parser", "Dates")).isTrue("Expect the scenario to match");
+        AssertThat(filter.matches("Render", "Draw lines")).isTrue("Expect the qualified label to match");
+        AssertThat(filter.matches("Scenario", "Draw lines")).isFalse("Expect the qualified pattern to need the scenario");
+        filter.exclude("*lines");
+        AssertThat(filter.matches("Render", "Draw lines")).isFalse("Expect an excluded test not to match");
+    });
+
+    add_test("Filtering::Tags", []() {
+        H2OFastTests::TestFilter filter;
+        filter.include("[io*]");
+        AssertThat(filter.matches("Scenario", "Dates are parsed [fast][ioctl]")).isTrue("Expect a tag to match");
+        AssertThat(filter.matches("Scenario", "Dates are parsed [fast]")).isFalse("Expect the other tags not to match");
+        AssertThat(filter.matches("Scenario", "io")).isFalse("Expect a tag pattern not to match the label");
+        filter.exclude("[slow]");
+        AssertThat(filter.matches("Scenario", "Files are read [io][slow]")).isFalse("Expect an excluded tag not to match");
+    });
+
+    add_test("Filtering::Scenario names", []() {
+        using H2OFastTests::detail::scenario_name;
+        AssertThat(scenario_name("struct Dates") == "Dates" && scenario_name("5Dates") == "Dates").isTrue("Expect the name as declared");
+        AssertThat(scenario_name("N3foo5DatesE") == "N3foo5DatesE" && scenario_name("12Dates") == "12Dates").isTrue("Expect other names as they are");
+    });
+
+    add_test("Filtering::Only the selected tests are run", []() {
+        TestPtrList tests;
+        tests.push_back(H2OFastTests::detail::make_test("Keep #0", []() {}));
+        tests.push_back(H2OFastTests::detail::make_test("Drop", []() {}));
+        tests.push_back(H2OFastTests::detail::make_test("Keep #1", []() {}));
+        ListRecorder recorder;
+        auto policy = H2OFastTests::ExecutionPolicy::parallel(2);
+        policy.filter.include("Scenario/Keep*");
+        H2OFastTests::detail::TestScheduler{ policy }.run(schedule(tests, recorder));
+        AssertThat(recorder.labels.size() == 2 && recorder.labels[0] == "Keep #0" && recorder.labels[1] == "Keep #1").isTrue("Expect the selected tests in order");
+        AssertThat(tests[1]->getStatus() == H2OFastTests::Test::Status::NONE).isTrue("Expect the other tests not to run");
+    });
+}
+
+register_scenario(H2OFastTests_Rerun_Tests)
+{
+    using H2OFastTests::detail::StatusCache;
+    using H2OFastTests::ExecutionPolicy;
+    using Status = H2OFastTests::Test::Status;
+
+    // "B" failed last time, "A" passed, "C" is new
+    auto previous_run = []() {
+        StatusCache cache;
+        cache.set("Scenario", "A", { Status::PASSED, H2OFastTests::Duration{ 1 } });
+        cache.set("Scenario", "B", { Status::FAILED, H2OFastTests::Duration{ 1 } });
+        cache.save("H2OFastTests_status.tmp");
+    };
+    auto run = [](ExecutionPolicy policy, std::vector<std::string>& executed) {
+        TestPtrList tests;
+        for (auto label : { "A", "B", "C" }) {
+            tests.push_back(H2OFastTests::detail::make_test(label, [&executed, label]() { executed.push_back(label); }));
+        }
+        ListRecorder recorder;
+        policy.status_file = "H2OFastTests_status.tmp";
+        H2OFastTests::detail::TestScheduler{ policy }.run(schedule(tests, recorder));
+        return recorder.labels;
+    };
+
+    add_test("Rerun::Status cache round trip", []() {
+        StatusCache cache;
+        cache.set("Scenario", "label\twith\ttabs", { Status::TIMEOUT, H2OFastTests::Duration{ 12.5 } });
+        cache.save("H2OFastTests_status.tmp");
+        StatusCache loaded;
+        loaded.load("H2OFastTests_status.tmp");
+        std::remove("H2OFastTests_status.tmp");
+        const auto entry = loaded.find("Scenario", "label\twith\ttabs");
+        AssertThat(entry).isNotNull("Expect the label to be found");
+        AssertThat(entry->status == Status::TIMEOUT).isTrue("Expect the status to be kept");
+        AssertThat(entry->time.count()).isEqualTo(12.5, 1e-9, "Expect 12.5 ms");
+        AssertThat(loaded.find("Scenario", "label")).isNull("Expect unknown labels not to be found");
+    });
+
+    add_test("Rerun::Failed first", [previous_run, run]() {
+        previous_run();
+        std::vector<std::string> executed;
+        auto recorded = run(ExecutionPolicy{}, executed);
+        AssertThat(recorded == std::vector<std::string>{ "A", "B", "C" }).isTrue("Expect the registration order by default");
+        previous_run();
+        executed.clear();
+        auto policy = ExecutionPolicy{};
+        policy.order = ExecutionPolicy::Order::FAILED_FIRST;
+        recorded = run(policy, executed);
+        std::remove("H2OFastTests_status.tmp");
+        AssertThat(executed == std::vector<std::string>{ "B", "A", "C" }).isTrue("Expect the failed test first");
+        AssertThat(recorded == executed).isTrue("Expect the results in the order they were run");
+    });
+
+    add_test("Rerun::Failed first beats longest first", [previous_run, run]() {
+        previous_run();
+        H2OFastTests::detail::TimingStore timings;
+        timings.set("Scenario", "A", H2OFastTests::Duration{ 100 });
+        timings.save("H2OFastTests_rerun_timings.tmp");
+        std::vector<std::string> executed;
+        auto policy = ExecutionPolicy::parallel(1);
+        policy.order = ExecutionPolicy::Order::FAILED_FIRST;
+        policy.timing_file = "H2OFastTests_rerun_timings.tmp";
+        run(policy, executed);
+        std::remove("H2OFastTests_status.tmp");
+        std::remove("H2OFastTests_rerun_timings.tmp");
+        AssertThat(executed == std::vector<std::string>{ "B", "A", "C" }).isTrue("Expect the failed test, then the longest one");
+    });
+
+    add_test("Rerun::Only failed", [previous_run, run]() {
+        previous_run();
+        std::vector<std::string> executed;
+        auto policy = ExecutionPolicy{};
+        policy.order = ExecutionPolicy::Order::ONLY_FAILED;
+        run(policy, executed);
+        AssertThat(executed == std::vector<std::string>{ "B", "C" }).isTrue("Expect the failed and the new tests only");
+
+        StatusCache updated;
+        updated.load("H2OFastTests_status.tmp");
+        AssertThat(updated.find("Scenario", "B")->status == Status::PASSED).isTrue("Expect the cache to be updated");
+        AssertThat(updated.find("Scenario", "A") != nullptr).isTrue("Expect the tests left out to be kept");
+
+        executed.clear();
+        run(policy, executed);
+        std::remove("H2OFastTests_status.tmp");
+        AssertThat(executed.empty()).isTrue("Expect nothing to run once everything passed");
+    });
+}
+
+// Counts the set ups and tear downs of its scenario, whose set up may throw
+class ScenarioRecorder : public ListRecorder {
+public:
+    virtual void begin_scenario() override {
+        ++begins;
+        if (throws) {
+            throw std::runtime_error{ "No dataset" };
+        }
+    }
+    virtual void end_scenario() override { ++ends; }
+    bool throws = false;
+    std::atomic<int> begins{ 0 };
+    std::atomic<int> ends{ 0 };
+};
+
+std::atomic<int> fixture_builds{ 0 };
+int scenario_setups = 0;
+int scenario_teardowns = 0;
+
+// Slow to build, so that the first uses of the parallel run overlap
+H2OFastTests::SharedFixture<std::vector<int>> shared_dataset{ []() {
+    ++fixture_builds;
+    std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+    return std::make_unique<std::vector<int>>(1000, 7);
+} };
+
+// Run by main on 4 threads
+register_scenario(H2OFastTests_Fixture_Tests)
+{
+    set_up_scenario([]() { ++scenario_setups; });
+    tear_down_scenario([]() {
+        ++scenario_teardowns;
+        shared_dataset.reset();
+    });
+
+    for (int i = 0; i < 8; ++i) {
+        add_test("Fixture::Shared dataset #" + std::to_string(i), []() {
+            AssertThat(shared_dataset->size() == 1000 && shared_dataset->front() == 7).isTrue("Expect the dataset to be built");
+            AssertThat(fixture_builds.load() == 1).isTrue("Expect the dataset to be built once");
+            AssertThat(scenario_setups == 1 && scenario_teardowns == 0).isTrue("Expect the scenario to be set up once, before its tests");
+        });
+    }
+
+    add_test("Fixture::Scenario tear down after the last test", []() {
+        TestPtrList tests;
+        ScenarioRecorder recorder;
+        for (int i = 0; i < 4; ++i) {
+            tests.push_back(H2OFastTests::detail::make_test("Test #" + std::to_string(i), [&recorder]() {
+                AssertThat(recorder.begins.load() == 1 && recorder.ends.load() == 0).isTrue("Expect the scenario to be set up");
+            }));
+        }
+        H2OFastTests::detail::TestScheduler{ H2OFastTests::ExecutionPolicy::parallel(2) }.run(schedule(tests, recorder));
+        AssertThat(recorder.begins.load() == 1 && recorder.ends.load() == 1).isTrue("Expect a single set up and tear down");
+        for (const auto& test : tests) {
+            AssertThat(test->getStatus() == H2OFastTests::Test::Status::PASSED).isTrue("Expect the tests to pass");
+        }
+    });
+
+    add_test("Fixture::Scenario set up failures are errors", []() {
+        TestPtrList tests;
+        auto run = false;
+        tests.push_back(H2OFastTests::detail::make_test("Test", [&run]() { run = true; }));
+        ScenarioRecorder recorder;
+        recorder.throws = true;
+        H2OFastTests::detail::TestScheduler{ H2OFastTests::ExecutionPolicy::sequential() }.run(schedule(tests, recorder));
+        AssertThat(run).isFalse("Expect the test not to run");
+        AssertThat(tests[0]->getStatus() == H2OFastTests::Test::Status::ERROR).isTrue("Expect the test in error");
+        AssertThat(tests[0]->getError()).isEqualTo(std::string{ "Set up of the scenario failed: No dataset" }, false, "Expect the set up error");
+        AssertThat(recorder.labels.size() == 1).isTrue("Expect the error to be recorded");
+        AssertThat(recorder.ends.load() == 0).isTrue("Expect no tear down");
+    });
+
+#if H2OFT_HAS_FORK_
+    add_test("Fixture::Set up failures in worker processes are errors", []() {
+        // The bodies append their name to a file, so that runs in any process are seen
+        char path[] = "/tmp/H2OFastTests_fixture_XXXXXX";
+        const auto fd = mkstemp(path);
+        AssertThat(fd >= 0).isTrue("Expect a temporary file");
+        const auto append = [fd](char name) {
+            return [fd, name]() { AssertThat(::write(fd, &name, 1) == 1).isTrue("Expect the run to be logged"); };
+        };
+        TestPtrList tests;
+        tests.push_back(H2OFastTests::detail::make_test("Before", append('b')));
+        tests.push_back(H2OFastTests::detail::make_test("Broken set up", append('s')));
+        tests.push_back(H2OFastTests::detail::make_test("After", append('a')));
+        const H2OFastTests::detail::SetUpFunctor throwing = []() { throw std::runtime_error{ "No dataset" }; };
+        ListRecorder recorder;
+        auto tasks = schedule(tests, recorder);
+        tasks[1].setup = &throwing;
+        H2OFastTests::detail::TestScheduler{ H2OFastTests::ExecutionPolicy::processes(1) }.run(tasks);
+        std::string runs(8, '\0');
+        runs.resize(static_cast<size_t>(pread(fd, &runs[0], runs.size(), 0)));
+        close(fd);
+        std::remove(path);
+        AssertThat(tests[1]->getStatus() == H2OFastTests::Test::Status::ERROR).isTrue("Expect the test in error");
+        AssertThat(tests[1]->getError()).isEqualTo(std::string{ "Set up or tear down failed: No dataset" }, false, "Expect the set up error");
+        AssertThat(tests[2]->getStatus() == H2OFastTests::Test::Status::PASSED).isTrue("Expect the next test to run");
+        AssertThat(runs).isEqualTo(std::string{ "ba" }, false, "Expect every body run once, and not the one after the failed set up");
+        AssertThat(recorder.labels.size() == 3).isTrue("Expect every test recorded once");
+    });
+#endif
+
+    add_test("Fixture::Failed builds are tried again", []() {
+        auto attempts = 0;
+        H2OFastTests::SharedFixture<int> fixture{ [&attempts]() {
+            if (++attempts == 1) {
+                throw std::runtime_error{ "Not yet" };
+            }
+            return std::make_unique<int>(42);
+        } };
+        AssertThat([&fixture]() { fixture.get(); }).expectException<std::runtime_error>("Expect the first build to throw");
+        AssertThat(fixture.isBuilt()).isFalse("Expect nothing built");
+        AssertThat(*fixture).isEqualTo(42, "Expect the second build to succeed");
+        AssertThat(&fixture.get() == &*fixture && attempts == 2).isTrue("Expect the fixture to be reused");
+        fixture.reset();
+        AssertThat(fixture.isBuilt()).isFalse("Expect the fixture to be destroyed");
+    });
+
+    add_test("Fixture::Set up, body and tear down are timed apart", []() {
+        const H2OFastTests::detail::SetUpFunctor setup = []() { std::this_thread::sleep_for(std::chrono::milliseconds{ 40 }); };
+        const H2OFastTests::detail::TearDownFunctor teardown = []() { std::this_thread::sleep_for(std::chrono::milliseconds{ 20 }); };
+        const auto policies = { H2OFastTests::ExecutionPolicy::sequential(), H2OFastTests::ExecutionPolicy::parallel(2), H2OFastTests::ExecutionPolicy::processes(1) };
+        for (auto policy : policies) {
+            TestPtrList tests;
+            tests.push_back(H2OFastTests::detail::make_test("Quick", []() {}));
+            tests.push_back(std::make_unique<H2OFastTests::detail::ParameterizedTest<int>>("Cases", H2OFastTests::range(0, 4), [](const int&) {}));
+            ListRecorder recorder;
+            auto tasks = schedule(tests, recorder);
+            for (auto& task : tasks) {
+                task.setup = &setup;
+                task.teardown = &teardown;
+            }
+            H2OFastTests::detail::TestScheduler{ policy }.run(tasks);
+            for (const auto& test : tests) {
+                AssertThat(test->getSetUpTimeMs().count() >= 40).isTrue("Expect the set up to be timed");
+                AssertThat(test->getTearDownTimeMs().count() >= 20).isTrue("Expect the tear down to be timed");
+                AssertThat(test->getExecTimeMs().count() < 20).isTrue("Expect the body to be timed alone");
+            }
+        }
+    });
+}
+
+// Run by main on 4 threads
+register_scenario(H2OFastTests_Parameterized_Tests)
+{
+    add_parameterized_test("Parameterized::Registered values", H2OFastTests::values({ 2, 4, 8 }), [](const int& value) {
+        AssertThat(value % 2 == 0).isTrue("Expect even values");
+    });
+
+    add_parameterized_test("Parameterized::Registered generator", H2OFastTests::generate(1000, [](size_t i) { return std::to_string(i); }), [](const std::string& value) {
+        AssertThat(value.empty()).isFalse("Expect a generated value");
+    });
+
+    add_test("Parameterized::Every case runs once", []() {
+        std::vector<std::atomic<int>> hits(10000);
+        TestPtrList tests;
+        tests.push_back(std::make_unique<H2OFastTests::detail::ParameterizedTest<int>>("Hits", H2OFastTests::range(0, 20000, 2), [&hits](const int& i) { ++hits[i / 2]; }));
+        ListRecorder recorder;
+        H2OFastTests::detail::TestScheduler{ H2OFastTests::ExecutionPolicy::parallel(4) }.run(schedule(tests, recorder));
+        AssertThat(tests[0]->getStatus() == H2OFastTests::Test::Status::PASSED).isTrue("Expect the test to pass");
+        AssertThat(recorder.labels.size() == 1).isTrue("Expect a single result");
+        AssertThat(std::all_of(hits.begin(), hits.end(), [](const std::atomic<int>& count) { return count.load() == 1; })).isTrue("Expect every case to run once");
+    });
+
+    add_test("Parameterized::The first failing case is reported", []() {
+        for (auto policy : { H2OFastTests::ExecutionPolicy::sequential(), H2OFastTests::ExecutionPolicy::parallel(4) }) {
+            TestPtrList tests;
+            tests.push_back(std::make_unique<H2OFastTests::detail::ParameterizedTest<int>>("Modulo", H2OFastTests::range(0, 1000), [](const int& i) {
+                AssertThat(i % 100 != 37).isTrue("Expect no 37");
+            }));
+            ListRecorder recorder;
+            H2OFastTests::detail::TestScheduler{ policy }.run(schedule(tests, recorder));
+            const auto& reason = tests[0]->getFailureReason();
+            AssertThat(tests[0]->getStatus() == H2OFastTests::Test::Status::FAILED).isTrue("Expect the test to fail");
+            AssertThat(reason.compare(0, 26, "Modulo [case 37: 37]: Expe") == 0).isTrue("Expect the first failing case");
+            AssertThat(reason.find("(10 of 1000 cases did not pass)") != std::string::npos).isTrue("Expect the number of failing cases");
+        }
+    });
+
+    add_test("Parameterized::Lines of a file", []() {
+        const char* path = "H2OFastTests_parameters.tmp";
+        {
+            std::ofstream file{ path, std::ios::binary };
+            for (int i = 0; i < 999; ++i) {
+                file << "line " << i << (i % 2 ? "\r\n" : "\n");
+            }
+            file << "line 999"; // no end of line
+        }
+        std::vector<std::string> lines(1000);
+        TestPtrList tests;
+        tests.push_back(std::make_unique<H2OFastTests::detail::ParameterizedTest<std::string_view>>("Lines", H2OFastTests::lines_of(path), [&lines](const std::string_view& line) {
+            const auto number = std::stoul(std::string{ line.substr(5) });
+            AssertThat(number < lines.size() && lines[number].empty()).isTrue("Expect each line once");
+            lines[number] = std::string{ line };
+        }));
+        tests.push_back(std::make_unique<H2OFastTests::detail::ParameterizedTest<std::string_view>>("Missing", H2OFastTests::lines_of("H2OFastTests_missing.tmp"), [](const std::string_view&) {}));
+        ListRecorder recorder;
+        H2OFastTests::detail::TestScheduler{ H2OFastTests::ExecutionPolicy::parallel(3) }.run(schedule(tests, recorder));
+        std::remove(path);
+        AssertThat(tests[0]->getStatus() == H2OFastTests::Test::Status::PASSED).isTrue("Expect every line to be read once");
+        AssertThat(lines[1]).isEqualTo(std::string{ "line 1" }, false, "Expect the end of lines to be removed");
+        AssertThat(lines[999]).isEqualTo(std::string{ "line 999" }, false, "Expect the last line");
+        AssertThat(tests[1]->getStatus() == H2OFastTests::Test::Status::ERROR).isTrue("Expect a missing file to be an error");
+        AssertThat(tests[1]->getError()).isEqualTo(std::string{ "Cannot open the parameter file H2OFastTests_missing.tmp" }, false, "Expect the missing file");
+    });
+
+    add_test("Parameterized::File chunks start on a line", []() {
+        const char* path = "H2OFastTests_chunks.tmp";
+        {
+            std::ofstream file{ path, std::ios::binary };
+            file << "a\nbb\n\nccc\ndddd\n";
+        }
+        H2OFastTests::detail::FileLines lines{ path };
+        size_t visited = 0;
+        std::string joined;
+        const auto chunks = lines.split(16);
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            lines.visit(chunk, [&](size_t number, const std::string_view& line) {
+                AssertThat(number == visited++).isTrue("Expect the lines in order");
+                joined += std::string{ line } + '|';
+            });
+        }
+        std::remove(path);
+        AssertThat(chunks > 1 && chunks <= 5).isTrue("Expect at most a chunk per line");
+        AssertThat(joined).isEqualTo(std::string{ "a|bb||ccc|dddd|" }, false, "Expect every line once");
+    });
+}
+
+register_scenario(H2OFastTests_Expectation_Tests)
+{
+    using H2OFastTests::detail::make_test;
+
+    add_test("Expect::Failures are recorded without stopping the test", []() {
+        const auto policies = { H2OFastTests::ExecutionPolicy::sequential(), H2OFastTests::ExecutionPolicy::parallel(4), H2OFastTests::ExecutionPolicy::processes(2) };
+        for (auto policy : policies) {
+            TestPtrList tests;
+            tests.push_back(make_test("Soft", []() {
+                ExpectThat(1).isEqualTo(2, "Expect 1 == 2");
+                ExpectThat(true).isTrue("Expect true");
+                ExpectThat(std::string{ "aaa" }).isEqualTo(std::string{ "bbb" }, false, "Expect aaa == bbb");
+            }));
+            tests.push_back(make_test("Passing", []() {
+                ExpectThat(1).isEqualTo(1, "Expect 1 == 1");
+            }));
+            ListRecorder recorder;
+            H2OFastTests::detail::TestScheduler{ policy }.run(schedule(tests, recorder));
+            const auto& failures = tests[0]->getFailures();
+            AssertThat(tests[0]->getStatus() == H2OFastTests::Test::Status::FAILED).isTrue("Expect the test to fail");
+            AssertThat(tests[0]->getFailureCount()).isEqualTo(size_t{ 2 }, "Expect two failures");
+            AssertThat(failures.size()).isEqualTo(size_t{ 2 }, "Expect two recorded failures");
+            AssertThat(failures[0].find("Expect 1 == 2") != std::string::npos && failures[0].find("[REACHED] 1") != std::string::npos).isTrue("Expect the first failure first");
+            AssertThat(failures[1].find("[REACHED] aaa") != std::string::npos).isTrue("Expect the second failure second");
+            AssertThat(tests[0]->getFailureReason()).isEqualTo(failures[0] + failures[1], false, "Expect the reason to list every failure");
+            AssertThat(tests[1]->getStatus() == H2OFastTests::Test::Status::PASSED).isTrue("Expect the other test to pass");
+            AssertThat(tests[1]->getFailures().empty()).isTrue("Expect no failure for the other test");
+        }
+    });
+
+    add_test("Expect::An assert stops the test after the expectations", []() {
+        auto reached = false;
+        TestPtrList tests;
+        tests.push_back(make_test("Soft then fatal", [&reached]() {
+            ExpectThat(std::vector<int>{ 1, 2, 3 }).isElementwiseEqualTo(std::vector<int>{ 1, 5, 3 }, "Expect equal ranges");
+            AssertThat(3).isEqualTo(4, "Expect 3 == 4");
+            reached = true;
+        }));
+        ListRecorder recorder;
+        H2OFastTests::detail::TestScheduler{ H2OFastTests::ExecutionPolicy::sequential() }.run(schedule(tests, recorder));
+        const auto& failures = tests[0]->getFailures();
+        AssertThat(reached).isFalse("Expect the assert to stop the test");
+        AssertThat(failures.size()).isEqualTo(size_t{ 2 }, "Expect both failures");
+        AssertThat(failures[0].find("[FIRST MISMATCH AT] 1") != std::string::npos).isTrue("Expect the expectation first");
+        AssertThat(failures[1].find("Expect 3 == 4") != std::string::npos).isTrue("Expect the assert last");
+    });
+
+    add_test("Expect::Failures past the buffer are only counted", []() {
+        TestPtrList tests;
+        tests.push_back(make_test("Many", []() {
+            for (int i = 0; i < 10000; ++i) {
+                ExpectThat(i).isEqualTo(-1, "Expect -1");
+            }
+        }));
+        ListRecorder recorder;
+        H2OFastTests::detail::TestScheduler{ H2OFastTests::ExecutionPolicy::sequential() }.run(schedule(tests, recorder));
+        AssertThat(tests[0]->getFailureCount()).isEqualTo(size_t{ 10000 }, "Expect every failure to be counted");
+        AssertThat(tests[0]->getFailures().size()).isEqualTo(H2OFastTests::detail::FailureBuffer::capacity, "Expect the first ones to be recorded");
+        AssertThat(tests[0]->getFailureReason().find("(10000 failures, 9968 not recorded)") != std::string::npos).isTrue("Expect the rest to be counted");
+    });
+
+    add_test("Expect::Failed expectations fail their case", []() {
+        for (auto policy : { H2OFastTests::ExecutionPolicy::sequential(), H2OFastTests::ExecutionPolicy::parallel(4) }) {
+            TestPtrList tests;
+            tests.push_back(std::make_unique<H2OFastTests::detail::ParameterizedTest<int>>("Modulo", H2OFastTests::range(0, 1000), [](const int& i) {
+                ExpectThat(i % 100 != 37).isTrue("Expect no 37");
+                ExpectThat(i % 100 != 38).isTrue("Expect no 38");
+            }));
+            ListRecorder recorder;
+            H2OFastTests::detail::TestScheduler{ policy }.run(schedule(tests, recorder));
+            const auto& reason = tests[0]->getFailureReason();
+            AssertThat(tests[0]->getStatus() == H2OFastTests::Test::Status::FAILED).isTrue("Expect the test to fail");
+            AssertThat(reason.compare(0, 26, "Modulo [case 37: 37]: Expe") == 0).isTrue("Expect the first failing case");
+            AssertThat(reason.find("(20 of 1000 cases did not pass)") != std::string::npos).isTrue("Expect the number of failing cases");
+        }
+    });
+
+    add_test("Expect::Failures of a test stay in that test", []() {
+        ExpectThat(1).isEqualTo(1, "Expect 1 == 1");
+        TestPtrList tests;
+        tests.push_back(make_test("Inner", []() {
+            ExpectThat(0).isEqualTo(1, "Expect 0 == 1");
+        }));
+        ListRecorder recorder;
+        H2OFastTests::detail::TestScheduler{ H2OFastTests::ExecutionPolicy::sequential() }.run(schedule(tests, recorder));
+        AssertThat(tests[0]->getFailureCount()).isEqualTo(size_t{ 1 }, "Expect the failure in the inner test");
+        AssertThat(H2OFastTests::detail::FailureBuffer::current() != nullptr).isTrue("Expect this test to record its expectations");
+    });
+}
+
+// A test with an allocation budget, as RegistryManager::add_test makes them
+class BudgetedTest : public H2OFastTests::Test {
+public:
+    BudgetedTest(const std::string& label, const H2OFastTests::AllocationBudget& budget, H2OFastTests::detail::TestFunctor&& func)
+        : Test{ label, std::move(func) }
+    {
+        allocation_budget_ = budget;
+    }
+};
+
+// The allocation hooks are linked in the test executable
+register_scenario(H2OFastTests_Allocation_Tests)
+{
+    add_test("Allocation::The body allocations are counted", []() {
+        AssertThat(H2OFastTests::detail::AllocationCounter::installed().load()).isTrue("Expect the hooks to be linked in");
+        for (auto policy : { H2OFastTests::ExecutionPolicy::sequential(), H2OFastTests::ExecutionPolicy::processes(1) }) {
+            int* leaked = nullptr;
+            TestPtrList tests;
+            tests.push_back(H2OFastTests::detail::make_test("Allocating", [&leaked]() {
+                std::vector<int> values(100);
+                leaked = new int{ 42 };
+            }));
+            ListRecorder recorder;
+            const H2OFastTests::detail::SetUpFunctor setup = []() { std::vector<int> fixture(1000); };
+            auto tasks = schedule(tests, recorder);
+            tasks[0].setup = &setup;
+            H2OFastTests::detail::TestScheduler{ policy }.run(tasks);
+            delete leaked;
+            const auto stats = tests[0]->getAllocationStats();
+            AssertThat(stats).isNotNull("Expect the allocations to be counted");
+            AssertThat(stats->allocations).isEqualTo(uint64_t{ 2 }, "Expect the allocations of the body alone");
+            AssertThat(stats->bytes).isEqualTo(uint64_t{ 100 * sizeof(int) + sizeof(int) }, "Expect the bytes of the body");
+            AssertThat(stats->peak_bytes).isEqualTo(stats->bytes, "Expect both blocks allocated at once");
+            AssertThat(stats->leaks()).isEqualTo(uint64_t{ 1 }, "Expect the leaked block");
+            AssertThat(stats->live_bytes).isEqualTo(uint64_t{ sizeof(int) }, "Expect the leaked bytes");
+            AssertThat(tests[0]->getStatus() == H2OFastTests::Test::Status::PASSED).isTrue("Expect leaks allowed without a budget");
+        }
+    });
+
+    add_test("Allocation::Blocks freed on another thread are not counted there", []() {
+        // Both counters are the first of their thread
+        H2OFastTests::detail::AllocationStats allocating, freeing;
+        std::unique_ptr<int> block;
+        std::thread{ [&allocating, &block]() {
+            H2OFastTests::detail::AllocationCounter counter{ allocating };
+            block = std::make_unique<int>(42);
+        } }.join();
+        std::thread{ [&freeing, &block]() {
+            H2OFastTests::detail::AllocationCounter counter{ freeing };
+            block.reset();
+        } }.join();
+        AssertThat(allocating.leaks() == 1).isTrue("Expect the block leaked by its test");
+        AssertThat(freeing.deallocations == 0).isTrue("Expect no free of a block of another counter");
+        AssertThat(freeing.live_bytes == 0).isTrue("Expect no bytes freed");
+        AssertThat(freeing.leaks() == 0).isTrue("Expect no leak");
+    });
+
+    add_test("Allocation::Budgets fail the tests going over them", []() {
+        TestPtrList tests;
+        tests.push_back(std::make_unique<BudgetedTest>("Hot path", H2OFastTests::AllocationBudget::none(), []() {
+            int values[16] = {};
+            AssertThat(values[3] == 0).isTrue("Expect a zeroed array");
+        }));
+        tests.push_back(std::make_unique<BudgetedTest>("Allocating hot path", H2OFastTests::AllocationBudget::none(), []() {
+            std::vector<int> values(16);
+        }));
+        std::unique_ptr<int> leaked;
+        tests.push_back(std::make_unique<BudgetedTest>("Leaking", H2OFastTests::AllocationBudget::no_leaks(), [&leaked]() {
+            leaked = std::make_unique<int>(42);
+        }));
+        ListRecorder recorder;
+        H2OFastTests::detail::TestScheduler{ H2OFastTests::ExecutionPolicy::parallel(2) }.run(schedule(tests, recorder));
+        AssertThat(tests[0]->getStatus() == H2OFastTests::Test::Status::PASSED).isTrue("Expect no allocation to pass");
+        AssertThat(tests[1]->getStatus() == H2OFastTests::Test::Status::FAILED).isTrue("Expect an allocation to fail");
+        AssertThat(tests[1]->getFailureReason()).isEqualTo(std::string{ "Allocated 1 blocks (64 bytes), over its budget of 0 blocks (0 bytes)" }, false, "Expect the allocation to be explained");
+        AssertThat(tests[2]->getStatus() == H2OFastTests::Test::Status::FAILED).isTrue("Expect a leak to fail");
+        AssertThat(tests[2]->getFailureReason()).isEqualTo(std::string{ "Leaked 1 blocks (4 bytes)" }, false, "Expect the leak to be explained");
+    });
+}
+
+// Measures of the bodies enabled by the build, see H2OFT_PERF_COUNTERS and H2OFT_USE_TSC in CMakeLists.txt
+register_scenario(H2OFastTests_Measure_Tests)
+{
+    add_test("Measure::The test clock agrees with steady_clock", []() {
+#if H2OFT_HAS_TSC_
+        static_assert(std::is_same<H2OFastTests::detail::TestClock, H2OFastTests::detail::TscClock>::value, "Expect the tests timed with the time stamp counter");
+#endif
+        TestPtrList tests;
+        tests.push_back(H2OFastTests::detail::make_test("Sleep", []() {
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+        }));
+        ListRecorder recorder;
+        const auto start = std::chrono::steady_clock::now();
+        H2OFastTests::detail::TestScheduler{ H2OFastTests::ExecutionPolicy::sequential() }.run(schedule(tests, recorder));
+        const H2OFastTests::detail::Duration elapsed = std::chrono::steady_clock::now() - start;
+        const auto measured = tests[0]->getExecTimeMs();
+        AssertThat(measured.count() >= 19).isTrue("Expect the sleep to be measured");
+        AssertThat(measured <= elapsed).isTrue("Expect no more than the whole run");
+    });
+
+    add_test("Measure::Hardware counters measure the body when available", []() {
+        for (auto policy : { H2OFastTests::ExecutionPolicy::sequential(), H2OFastTests::ExecutionPolicy::processes(1) }) {
+            TestPtrList tests;
+            tests.push_back(H2OFastTests::detail::make_test("Counted", []() {
+                volatile uint64_t sum = 0;
+                for (uint64_t i = 0; i < 100000; ++i) {
+                    sum = sum + i;
+                }
+            }));
+            ListRecorder recorder;
+            H2OFastTests::detail::TestScheduler{ policy }.run(schedule(tests, recorder));
+            const auto stats = tests[0]->getPerfStats();
+#if H2OFT_HAS_PERF_EVENTS_
+            // Counters may be unavailable to the process: virtual machines, perf_event_paranoid...
+            if (!H2OFastTests::detail::PerfCounters::of_thread().any()) {
+                AssertThat(stats).isNull("Expect no counts without counters");
+                continue;
+            }
+            AssertThat(stats).isNotNull("Expect the counts of the body");
+            if (stats->has(H2OFastTests::PerfStats::INSTRUCTIONS)) {
+                AssertThat(stats->values[H2OFastTests::PerfStats::INSTRUCTIONS] >= 100000).isTrue("Expect the instructions of the loop");
+            }
+            if (stats->has(H2OFastTests::PerfStats::TASK_CLOCK)) {
+                AssertThat(stats->values[H2OFastTests::PerfStats::TASK_CLOCK] > 0).isTrue("Expect the CPU time of the loop");
+            }
+#else
+            AssertThat(stats).isNull("Expect no counts without H2OFT_PERF_COUNTERS");
+#endif
+        }
+    });
+}
+
+#if H2OFT_HAS_COROUTINES_
+// A coroutine test with a timeout, as RegistryManager::add_test makes them
+class TimedAsyncTest : public H2OFastTests::AsyncTest {
+public:
+    TimedAsyncTest(const std::string& label, H2OFastTests::detail::Duration timeout, Body&& body)
+        : AsyncTest{ label, std::move(body) }
+    {
+        timeout_ = timeout;
+    }
+};
+
+// Coroutine tests waiting on timers and pipes, run on the event loop of the scheduler
+register_scenario(H2OFastTests_Coroutine_Tests)
+{
+    using H2OFastTests::Task;
+    using H2OFastTests::detail::Duration;
+
+    static std::atomic<int> async_setups{ 0 };
+    set_up_async([]() -> Task {
+        co_await H2OFastTests::Async::yield();
+        ++async_setups;
+    });
+
+    add_test("Coroutine::Asynchronous set up runs first", []() -> Task {
+        AssertThat(async_setups.load() >= 1).isTrue("Expect the asynchronous set up before the body");
+        co_return;
+    });
+
+    add_test("Coroutine::Suspended tests interleave", []() {
+        TestPtrList tests;
+        for (int i = 0; i < 100; ++i) {
+            tests.push_back(std::make_unique<H2OFastTests::AsyncTest>("Sleep " + std::to_string(i), []() -> Task {
+                co_await H2OFastTests::Async::sleep_for(Duration{ 20 });
+            }));
+        }
+        tests.push_back(std::make_unique<H2OFastTests::AsyncTest>("Fail", []() -> Task {
+            co_await H2OFastTests::Async::yield();
+            AssertThat(false).isTrue("Expect to fail");
+        }));
+        ListRecorder recorder;
+        const auto start = std::chrono::steady_clock::now();
+        H2OFastTests::detail::TestScheduler{ H2OFastTests::ExecutionPolicy::sequential() }.run(schedule(tests, recorder));
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        AssertThat(elapsed < std::chrono::milliseconds{ 1000 }).isTrue("Expect the sleeps to overlap");
+        AssertThat(recorder.labels.size() == tests.size()).isTrue("Expect every test to be recorded");
+        AssertThat(recorder.labels.front() == "Fail").isTrue("Expect a test to be recorded as soon as it finished");
+        AssertThat(tests[0]->getStatus() == H2OFastTests::Test::Status::PASSED).isTrue("Expect a resumed test to pass");
+        AssertThat(tests.back()->getStatus() == H2OFastTests::Test::Status::FAILED).isTrue("Expect a failed assert to fail the test");
+    });
+
+    add_test("Coroutine::Timeouts destroy the suspended tests", []() {
+        TestPtrList tests;
+        static bool destroyed = false;
+        tests.push_back(std::make_unique<TimedAsyncTest>("Hang", Duration{ 10 }, []() -> Task {
+            struct Guard { ~Guard() { destroyed = true; } } guard;
+            co_await H2OFastTests::Async::sleep_for(Duration{ 10000 });
+        }));
+        tests.push_back(std::make_unique<H2OFastTests::AsyncTest>("Orphan", []() -> Task {
+            co_await std::suspend_always{};
+        }));
+        ListRecorder recorder;
+        H2OFastTests::detail::TestScheduler{ H2OFastTests::ExecutionPolicy::sequential() }.run(schedule(tests, recorder));
+        AssertThat(tests[0]->getStatus() == H2OFastTests::Test::Status::TIMEOUT).isTrue("Expect a test past its timeout to be TIMEOUT");
+        AssertThat(destroyed).isTrue("Expect the suspended frame to be destroyed");
+        AssertThat(tests[1]->getStatus() == H2OFastTests::Test::Status::ERROR).isTrue("Expect a test nothing resumes to be an error");
+    });
+
+#if H2OFT_HAS_POLL_
+    add_test("Coroutine::Tests wait on file descriptors", []() {
+        int fds[2];
+        AssertThat(::pipe(fds) == 0).isTrue("Expect a pipe");
+        TestPtrList tests;
+        tests.push_back(std::make_unique<H2OFastTests::AsyncTest>("Reader", [&fds]() -> Task {
+            co_await H2OFastTests::Async::readable(fds[0]);
+            char byte = 0;
+            AssertThat(::read(fds[0], &byte, 1) == 1 && byte == 'x').isTrue("Expect the written byte");
+        }));
+        tests.push_back(std::make_unique<H2OFastTests::AsyncTest>("Writer", [&fds]() -> Task {
+            co_await H2OFastTests::Async::sleep_for(Duration{ 5 });
+            AssertThat(::write(fds[1], "x", 1) == 1).isTrue("Expect the byte to be written");
+        }));
+        ListRecorder recorder;
+        H2OFastTests::detail::TestScheduler{ H2OFastTests::ExecutionPolicy::parallel(2) }.run(schedule(tests, recorder));
+        ::close(fds[0]);
+        ::close(fds[1]);
+        AssertThat(recorder.labels.size() == 2 && recorder.labels.back() == "Reader").isTrue("Expect the reader resumed once written to");
+        AssertThat(tests[0]->getStatus() == H2OFastTests::Test::Status::PASSED).isTrue("Expect the reader to pass");
+    });
+#endif
+}
+#endif
+
+// Defined in H2OFastTests_Linkage_Tests.cpp, returns whether its tests passed
+bool run_linkage_tests();
+
+// Results other than PASSED and SKIPPED that a scenario expects, some fail on purpose
+struct ExpectedResults {
+    size_t failed = 0;
+    size_t errors = 0;
+    size_t timeouts = 0;
+    size_t slow = 0;
+};
+
+// Reports the scenario on std::cerr unless its results are the expected ones
+template<class ScenarioName>
+bool results_as_expected(const ScenarioName& scenario, const ExpectedResults& expected = {}) {
+    if (scenario.getFailedCount() == expected.failed && scenario.getWithErrorCount() == expected.errors
+        && scenario.getTimedOutCount() == expected.timeouts && scenario.getSlowCount() == expected.slow) {
+        return true;
+    }
+    std::cerr << "Unexpected results in " << H2OFastTests::detail::scenario_name(H2OFastTests::detail::type_helper<ScenarioName>::name()) << std::endl;
+    return false;
+}
+
 int main(int /*argc*/, char** /*argv*/) {
     register_observer(H2OFastTests_Tests, H2OFastTests::ConsoleIO_Observer);
     run_scenario(H2OFastTests_Tests);
+    auto as_expected = results_as_expected(H2OFastTests_Tests_registry_manager);
+
+    register_observer(H2OFastTests_Parallel_Tests, H2OFastTests::ConsoleIO_Observer);
+    run_scenario_parallel(H2OFastTests_Parallel_Tests, 4);
+    print_result(H2OFastTests_Parallel_Tests);
+    as_expected = results_as_expected(H2OFastTests_Parallel_Tests_registry_manager) && as_expected;
+
+    register_observer(H2OFastTests_Isolation_Tests, H2OFastTests::ConsoleIO_Observer);
+    run_scenario_isolated(H2OFastTests_Isolation_Tests, 2);
+    print_result(H2OFastTests_Isolation_Tests);
+    // "Isolation::Crash is reported as an error" and "Isolation::Hang is killed"
+    as_expected = results_as_expected(H2OFastTests_Isolation_Tests_registry_manager, ExpectedResults{ 0, 1, 1, 0 }) && as_expected;
+
+    register_observer(H2OFastTests_Sharding_Tests, H2OFastTests::ConsoleIO_Observer);
+    run_scenario(H2OFastTests_Sharding_Tests);
+    print_result(H2OFastTests_Sharding_Tests);
+    as_expected = results_as_expected(H2OFastTests_Sharding_Tests_registry_manager) && as_expected;
+
+    register_observer(H2OFastTests_Storage_Tests, H2OFastTests::ConsoleIO_Observer);
+    run_scenario(H2OFastTests_Storage_Tests);
+    print_result(H2OFastTests_Storage_Tests);
+    as_expected = results_as_expected(H2OFastTests_Storage_Tests_registry_manager) && as_expected;
+
+    {
+        // "Baseline::Sleep" is expected to be reported SLOW
+        H2OFastTests::detail::TimingStore baseline;
+        baseline.set(H2OFastTests::detail::type_helper<H2OFastTests_Baseline_Tests>::name(), "Baseline::Sleep", H2OFastTests::detail::Duration{ 0.5 });
+        baseline.set(H2OFastTests::detail::type_helper<H2OFastTests_Baseline_Tests>::name(), "Baseline::Within its baseline", H2OFastTests::detail::Duration{ 1000 });
+        baseline.save("H2OFastTests_baseline.tmp");
+        auto policy = H2OFastTests::ExecutionPolicy::sequential();
+        policy.baseline_file = "H2OFastTests_baseline.tmp";
+        register_observer(H2OFastTests_Baseline_Tests, H2OFastTests::ConsoleIO_Observer);
+        H2OFastTests_Baseline_Tests_registry_manager.run_tests(policy);
+        print_result(H2OFastTests_Baseline_Tests);
+        as_expected = results_as_expected(H2OFastTests_Baseline_Tests_registry_manager, ExpectedResults{ 0, 0, 0, 1 }) && as_expected;
+        std::remove("H2OFastTests_baseline.tmp");
+    }
+
+    register_observer(H2OFastTests_Benchmark_Tests, H2OFastTests::ConsoleIO_Observer);
+    run_scenario(H2OFastTests_Benchmark_Tests);
+    print_result(H2OFastTests_Benchmark_Tests);
+    as_expected = results_as_expected(H2OFastTests_Benchmark_Tests_registry_manager) && as_expected;
+
+    register_observer(H2OFastTests_Timeout_Tests, H2OFastTests::ConsoleIO_Observer);
+    register_observer(H2OFastTests_Timeout_Tests, TimeoutCounter_Observer);
+    run_scenario(H2OFastTests_Timeout_Tests);
+    print_result(H2OFastTests_Timeout_Tests);
+    // "Timeout::Sleep past its timeout"
+    as_expected = results_as_expected(H2OFastTests_Timeout_Tests_registry_manager, ExpectedResults{ 0, 0, 1, 0 }) && as_expected;
+
+    register_observer(H2OFastTests_Cancellation_Tests, H2OFastTests::ConsoleIO_Observer);
+    run_scenario(H2OFastTests_Cancellation_Tests);
+    print_result(H2OFastTests_Cancellation_Tests);
+    as_expected = results_as_expected(H2OFastTests_Cancellation_Tests_registry_manager) && as_expected;
+
+    register_observer(H2OFastTests_Filtering_Tests, H2OFastTests::ConsoleIO_Observer);
+    run_scenario(H2OFastTests_Filtering_Tests);
+    print_result(H2OFastTests_Filtering_Tests);
+    as_expected = results_as_expected(H2OFastTests_Filtering_Tests_registry_manager) && as_expected;
+
+    register_observer(H2OFastTests_Rerun_Tests, H2OFastTests::ConsoleIO_Observer);
+    run_scenario(H2OFastTests_Rerun_Tests);
+    print_result(H2OFastTests_Rerun_Tests);
+    as_expected = results_as_expected(H2OFastTests_Rerun_Tests_registry_manager) && as_expected;
+
+    register_observer(H2OFastTests_Fixture_Tests, H2OFastTests::ConsoleIO_Observer);
+    run_scenario_parallel(H2OFastTests_Fixture_Tests, 4);
+    print_result(H2OFastTests_Fixture_Tests);
+    as_expected = results_as_expected(H2OFastTests_Fixture_Tests_registry_manager) && as_expected;
+
+    register_observer(H2OFastTests_Parameterized_Tests, H2OFastTests::ConsoleIO_Observer);
+    run_scenario_parallel(H2OFastTests_Parameterized_Tests, 4);
+    print_result(H2OFastTests_Parameterized_Tests);
+    as_expected = results_as_expected(H2OFastTests_Parameterized_Tests_registry_manager) && as_expected;
+
+    register_observer(H2OFastTests_Expectation_Tests, H2OFastTests::ConsoleIO_Observer);
+    run_scenario(H2OFastTests_Expectation_Tests);
+    print_result(H2OFastTests_Expectation_Tests);
+    as_expected = results_as_expected(H2OFastTests_Expectation_Tests_registry_manager) && as_expected;
+
+    register_observer(H2OFastTests_Allocation_Tests, H2OFastTests::ConsoleIO_Observer);
+    run_scenario(H2OFastTests_Allocation_Tests);
+    print_result(H2OFastTests_Allocation_Tests);
+    as_expected = results_as_expected(H2OFastTests_Allocation_Tests_registry_manager) && as_expected;
+
+    register_observer(H2OFastTests_Measure_Tests, H2OFastTests::ConsoleIO_Observer);
+    run_scenario(H2OFastTests_Measure_Tests);
+    print_result(H2OFastTests_Measure_Tests);
+    as_expected = results_as_expected(H2OFastTests_Measure_Tests_registry_manager) && as_expected;
+
+#if H2OFT_HAS_COROUTINES_
+    register_observer(H2OFastTests_Coroutine_Tests, H2OFastTests::ConsoleIO_Observer);
+    run_scenario(H2OFastTests_Coroutine_Tests);
+    print_result(H2OFastTests_Coroutine_Tests);
+    as_expected = results_as_expected(H2OFastTests_Coroutine_Tests_registry_manager) && as_expected;
+#endif
+
+    register_async_observer(H2OFastTests_Reporting_Tests, H2OFastTests::BufferedConsoleIO_Observer);
+    run_scenario(H2OFastTests_Reporting_Tests);
+    print_result(H2OFastTests_Reporting_Tests);
+    as_expected = results_as_expected(H2OFastTests_Reporting_Tests_registry_manager) && as_expected;
+
+    as_expected = run_linkage_tests() && as_expected;
     //print_result_verbose(H2OFastTests_Tests);
 
-    std::cout << "Press enter to continue...";
-    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    // Only waits when run from a console, so that scripts can run and time it
+    if (posix::IsATTY(posix::FileNo(stdin)) != 0) {
+        std::cout << "Press enter to continue...";
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    return as_expected ? 0 : 1;
 }
\ No newline at end of file